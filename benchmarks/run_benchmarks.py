@@ -0,0 +1,245 @@
+"""
+Tracer overhead benchmarks.
+
+Runs the workloads in benchmarks/workloads.py without coverage and under every
+available tracing backend, and prints a JSON report with overhead ratios, events per
+second and memory figures, so tracer changes can be compared between releases.
+
+Usage:
+    python benchmarks/run_benchmarks.py [--workloads tight_loop ...] [--backends settrace-c ...]
+                                        [--repeat N] [--scale F] [--output report.json]
+"""
+import argparse
+import json
+import multiprocessing
+import os
+import platform
+import shutil
+import sys
+import tempfile
+import threading
+import time
+import tracemalloc
+from typing import Any, Callable, Dict, List, Optional, Tuple
+
+# ensure the project root is in sys.path so 'src' and 'benchmarks' can be imported
+project_root = os.path.dirname(os.path.dirname(os.path.abspath(__file__)))
+if project_root not in sys.path:
+    sys.path.insert(0, project_root)
+
+from src.engine import MiniCoverage  # noqa: E402
+from src.engine import core  # noqa: E402
+from src.tracing.sys_monitoring import SysMonitoringTracer  # noqa: E402
+from src.tracing.sys_settrace import SysSetTraceTracer  # noqa: E402
+from benchmarks.workloads import WORKLOADS  # noqa: E402
+
+BENCH_DIR = os.path.dirname(os.path.abspath(__file__))
+
+BACKENDS = [
+    'settrace-python',       # SysSetTraceTracer.trace_function
+    'settrace-c',            # C Tracer via its native trace hook
+    'monitoring-python',     # SysMonitoringTracer with the pure-Python callbacks
+    'monitoring-c',          # SysMonitoringTracer with the C callbacks
+    'monitoring-first-hit',  # as above, collection_mode = first-hit
+    'monitoring-sampled',    # as above, collection_mode = sampled at a 10% sample rate
+    'monitoring-count',      # as monitoring-c, counting executions (collection_mode = count)
+]
+
+Hooks = Tuple[Callable[[], Any], Callable[[], None]]
+
+
+def backend_available(backend: str) -> Optional[str]:
+    """
+    Returns None if the backend can run here, otherwise the reason it cannot.
+    """
+    if backend.startswith('monitoring') and sys.version_info < (3, 12):
+        return "sys.monitoring requires Python 3.12+"
+    if backend.endswith('-c') or backend in ('monitoring-first-hit', 'monitoring-sampled', 'monitoring-count'):
+        if core.minicov_tracer is None:
+            return "C extension not built"
+    return None
+
+
+def make_engine(backend: str) -> Tuple[MiniCoverage, Hooks]:
+    """
+    Create a fresh engine and the start/stop hooks of the requested backend.
+    """
+    cov = MiniCoverage(project_root=BENCH_DIR)
+
+    if backend == 'settrace-python':
+        cov.c_tracer = None
+        tracer = SysSetTraceTracer(cov, None)
+        return cov, (tracer.start, tracer.stop)
+
+    if backend == 'settrace-c':
+        return cov, (cov.sys_settrace_tracer.start, cov.sys_settrace_tracer.stop)
+
+    if backend == 'monitoring-python':
+        cov.c_tracer = None
+    elif backend == 'monitoring-first-hit':
+        cov.config.collection_mode = 'first-hit'
+    elif backend == 'monitoring-sampled':
+        cov.config.collection_mode = 'sampled'
+        cov.config.sample_rate = 0.1
+    elif backend == 'monitoring-count':
+        # set by MiniCoverage.start(), which the benchmark bypasses
+        cov.count_hits = cov.c_tracer.count_hits = True
+
+    monitoring = SysMonitoringTracer(cov)
+    return cov, (monitoring.start, monitoring.stop)
+
+
+def count_line_events(workload: Callable[[float], int], scale: float) -> int:
+    """
+    Count the LINE events a workload produces in its own code (this process only).
+    """
+    target = os.path.join(BENCH_DIR, 'workloads.py')
+    count = 0
+    lock = threading.Lock()
+
+    def counter(frame, event, arg):
+        nonlocal count
+        if event == 'line':
+            with lock:
+                count += 1
+        return counter
+
+    def global_trace(frame, event, arg):
+        return counter if frame.f_code.co_filename == target else None
+
+    sys.settrace(global_trace)
+    threading.settrace(global_trace)
+    try:
+        workload(scale)
+    finally:
+        sys.settrace(None)
+        threading.settrace(None)
+    return count
+
+
+def run_baseline(workload: Callable[[float], int], scale: float) -> float:
+    start = time.perf_counter()
+    workload(scale)
+    return time.perf_counter() - start
+
+
+def run_traced(workload: Callable[[float], int], scale: float, backend: str) -> Tuple[float, MiniCoverage]:
+    """
+    Run a workload under a backend. The measured time includes draining the C buffers,
+    since that work is part of every real coverage run.
+    """
+    cov, (start_hook, stop_hook) = make_engine(backend)
+    # child processes start their own engine (with the default backend)
+    cov._patch_multiprocessing()
+    try:
+        start = time.perf_counter()
+        start_hook()
+        try:
+            workload(scale)
+        finally:
+            stop_hook()
+            if cov.c_tracer:
+                cov.c_tracer.drain()
+        elapsed = time.perf_counter() - start
+    finally:
+        # restore multiprocessing so baseline runs spawn untraced children
+        multiprocessing.Process = core._OriginalProcess
+        if hasattr(multiprocessing, '_mini_coverage_patched'):
+            del multiprocessing._mini_coverage_patched
+    return elapsed, cov
+
+
+def peak_allocation(run: Callable[[], Any]) -> int:
+    tracemalloc.start()
+    try:
+        run()
+        return tracemalloc.get_traced_memory()[1]
+    finally:
+        tracemalloc.stop()
+
+
+def benchmark(workloads: List[str], backends: List[str], repeat: int, scale: float) -> Dict[str, Any]:
+    results: List[Dict[str, Any]] = []
+    skipped: Dict[str, str] = {}
+
+    for backend in backends:
+        reason = backend_available(backend)
+        if reason:
+            skipped[backend] = reason
+    active = [b for b in backends if b not in skipped]
+
+    for name in workloads:
+        workload = WORKLOADS[name]
+        workload(scale * 0.1)  # warm up imports and caches
+
+        baseline = min(run_baseline(workload, scale) for _ in range(repeat))
+        baseline_peak = peak_allocation(lambda: workload(scale))
+        events = count_line_events(workload, scale)
+
+        for backend in active:
+            timings = []
+            cov = None
+            for _ in range(repeat):
+                elapsed, cov = run_traced(workload, scale, backend)
+                timings.append(elapsed)
+            traced = min(timings)
+            traced_peak = peak_allocation(lambda: run_traced(workload, scale, backend))
+
+            results.append({
+                'workload': name,
+                'backend': backend,
+                'baseline_s': baseline,
+                'traced_s': traced,
+                'overhead_ratio': traced / baseline if baseline else None,
+                'line_events': events,
+                'events_per_sec': events / traced if traced else None,
+                'ns_per_event': (traced - baseline) / events * 1e9 if events else None,
+                'trace_data_bytes': cov.trace_data.memory_usage() if cov else 0,
+                'baseline_peak_alloc_bytes': baseline_peak,
+                'traced_peak_alloc_bytes': traced_peak,
+            })
+
+    return {
+        'python': platform.python_version(),
+        'implementation': platform.python_implementation(),
+        'platform': platform.platform(),
+        'c_extension': core.minicov_tracer is not None,
+        'repeat': repeat,
+        'scale': scale,
+        'skipped_backends': skipped,
+        'results': results,
+    }
+
+
+def main(argv: Optional[List[str]] = None) -> None:
+    parser = argparse.ArgumentParser(description="Measure tracer overhead across backends.")
+    parser.add_argument('--workloads', nargs='+', choices=list(WORKLOADS), default=list(WORKLOADS))
+    parser.add_argument('--backends', nargs='+', choices=BACKENDS, default=BACKENDS)
+    parser.add_argument('--repeat', type=int, default=3, help="Runs per measurement, the fastest is kept.")
+    parser.add_argument('--scale', type=float, default=1.0, help="Workload size factor.")
+    parser.add_argument('--output', help="Write the JSON report to this file instead of stdout.")
+    args = parser.parse_args(argv)
+
+    # keep the partial data files written by traced child processes out of the way
+    data_dir = tempfile.mkdtemp(prefix='minicov-bench-')
+    old_data_file = os.environ.get('COVERAGE_FILE')
+    os.environ['COVERAGE_FILE'] = os.path.join(data_dir, '.coverage.db')
+    try:
+        report = benchmark(args.workloads, args.backends, max(1, args.repeat), args.scale)
+    finally:
+        if old_data_file is None:
+            os.environ.pop('COVERAGE_FILE', None)
+        else:
+            os.environ['COVERAGE_FILE'] = old_data_file
+        shutil.rmtree(data_dir, ignore_errors=True)
+
+    text = json.dumps(report, indent=2)
+    if args.output:
+        with open(args.output, 'w') as f:
+            f.write(text + '\n')
+    else:
+        print(text)
+
+
+if __name__ == '__main__':
+    main()
@@ -0,0 +1,117 @@
+"""
+Standard workloads for the tracer benchmarks.
+
+Every workload takes a single ``scale`` factor (1.0 is the default size) and lives in
+this file so that it is inside the project root the benchmark engine traces.
+"""
+import asyncio
+import multiprocessing
+import threading
+from typing import Callable, Dict
+
+
+def tight_loop(scale: float) -> int:
+    total = 0
+    for i in range(int(200_000 * scale)):
+        if i % 3:
+            total += i
+        else:
+            total -= 1
+    return total
+
+
+def _fib(n: int) -> int:
+    if n < 2:
+        return n
+    return _fib(n - 1) + _fib(n - 2)
+
+
+def deep_recursion(scale: float) -> int:
+    result = 0
+    for _ in range(max(1, int(10 * scale))):
+        result += _fib(18)
+    return result
+
+
+def _add(a: int, b: int) -> int:
+    return a + b
+
+
+def _is_even(n: int) -> bool:
+    return n % 2 == 0
+
+
+def _clamp(n: int, low: int, high: int) -> int:
+    return max(low, min(n, high))
+
+
+def small_functions(scale: float) -> int:
+    total = 0
+    for i in range(int(50_000 * scale)):
+        if _is_even(i):
+            total = _add(total, _clamp(i, 10, 1000))
+    return total
+
+
+def _numbers(limit: int):
+    for i in range(limit):
+        if i % 5 == 0:
+            continue
+        yield i
+
+
+async def _tick(n: int) -> int:
+    await asyncio.sleep(0)
+    return n * 2
+
+
+async def _gather(count: int) -> int:
+    total = 0
+    for start in range(0, count, 100):
+        values = await asyncio.gather(*(_tick(n) for n in range(start, min(start + 100, count))))
+        total += sum(values)
+    return total
+
+
+def generators_async(scale: float) -> int:
+    total = sum(x * x for x in _numbers(int(100_000 * scale)))
+    total += asyncio.run(_gather(int(5_000 * scale)))
+    return total
+
+
+def threads(scale: float) -> int:
+    results = [0] * 4
+
+    def worker(idx: int) -> None:
+        results[idx] = tight_loop(scale / 4)
+
+    pool = [threading.Thread(target=worker, args=(i,)) for i in range(len(results))]
+    for t in pool:
+        t.start()
+    for t in pool:
+        t.join()
+    return sum(results)
+
+
+def _child(scale: float) -> None:
+    tight_loop(scale)
+
+
+def process_fanout(scale: float) -> int:
+    # children run their own engine through the patched multiprocessing.Process
+    procs = [multiprocessing.Process(target=_child, args=(scale / 4,)) for _ in range(4)]
+    for p in procs:
+        p.start()
+    for p in procs:
+        p.join()
+    return sum(p.exitcode or 0 for p in procs)
+
+
+WORKLOADS: Dict[str, Callable[[float], int]] = {
+    'tight_loop': tight_loop,
+    'deep_recursion': deep_recursion,
+    'small_functions': small_functions,
+    'generators_async': generators_async,
+    'threads': threads,
+    'process_fanout': process_fanout,
+}
@@ -42,11 +42,18 @@ def bootstrap():
         # use CWD as root or infer from config?
         # usually project root is implicitly CWD for coverage runs
         cov = MiniCoverage(config_file=config_file)
+
+        # low-overhead sampling for production processes, e.g. MINICOV_SAMPLE_RATE=0.05
+        sample_rate = os.environ.get("MINICOV_SAMPLE_RATE")
+        if sample_rate:
+            cov.config.collection_mode = 'sampled'
+            cov.config.sample_rate = float(sample_rate)
         cov.start()
 
-        # register an exit handler to save data cleanly
+        # register an exit handler to save data cleanly; a forked child registers its
+        # own, and whichever runs first saves
         import atexit
-        atexit.register(cov.stop)
+        atexit.register(cov._stop_if_active)
 
     except ImportError as e:
         # MiniCoverage not found, skip
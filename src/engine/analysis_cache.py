@@ -0,0 +1,189 @@
+"""
+On-disk cache of static analysis results and report fragments.
+
+Entries are keyed by a hash of the file contents, the Python version (bytecode and
+therefore condition arcs differ between versions), the exclusion patterns and the
+metric names, so a file is only parsed and compiled again when one of them changes.
+Reporters additionally keep each file's rendered output next to a fingerprint of
+everything it was rendered from, and reuse it while the fingerprint is unchanged.
+"""
+import hashlib
+import json
+import logging
+import sqlite3
+import sys
+import time
+from typing import Any, Callable, Dict, Iterable, List, Optional, Set, Tuple
+
+from . import queries
+
+# bump when the way possible elements are computed changes
+ANALYSIS_VERSION = 1
+
+# bump when the output of a reporter changes for the same results
+FRAGMENT_VERSION = 1
+
+# entries of file versions not analyzed for this long are dropped
+_MAX_AGE = 30 * 24 * 3600
+
+
+class AnalysisCache:
+    """
+    Maps cache keys to {metric name: possible elements}. Reads hit the database
+    directly, writes are batched until flush().
+    """
+
+    def __init__(self, path: str) -> None:
+        self.logger = logging.getLogger(__name__)
+        self.path = path
+        self._conn: Optional[sqlite3.Connection] = None
+        self._pending: List[Tuple[str, str, float]] = []
+        self._touched: List[Tuple[float, str]] = []
+        self._fragments: List[Tuple[str, str, str, str]] = []
+        self._disabled = False
+
+    @staticmethod
+    def key_for(source: bytes, exclude_patterns: Iterable[str], metric_names: Iterable[str]) -> str:
+        digest = hashlib.sha256()
+        header = [str(ANALYSIS_VERSION), sys.implementation.cache_tag or '', sys.version,
+                  '\0'.join(sorted(exclude_patterns)), '\0'.join(sorted(metric_names))]
+        digest.update('\n'.join(header).encode('utf-8'))
+        digest.update(b'\n')
+        digest.update(source)
+        return digest.hexdigest()
+
+    def _connect(self) -> Optional[sqlite3.Connection]:
+        if self._conn is None and not self._disabled:
+            try:
+                self._conn = sqlite3.connect(self.path)
+                self._conn.execute(queries.INIT_ANALYSIS)
+                self._conn.execute(queries.INIT_REPORT_FRAGMENTS)
+                self._conn.commit()
+            except sqlite3.Error as e:
+                # a broken or read-only cache only costs speed
+                self.logger.debug(f"Analysis cache {self.path} disabled: {e}")
+                self._disabled = True
+                self._conn = None
+        return self._conn
+
+    def get(self, key: str) -> Optional[Dict[str, Set[Any]]]:
+        conn = self._connect()
+        if conn is None:
+            return None
+        try:
+            row = conn.execute(queries.SELECT_ANALYSIS, (key,)).fetchone()
+        except sqlite3.Error as e:
+            self.logger.debug(f"Analysis cache lookup failed: {e}")
+            return None
+        if row is None:
+            return None
+
+        self._touched.append((time.time(), key))
+        # JSON has no tuples; arcs come back as lists
+        return {name: {tuple(e) if isinstance(e, list) else e for e in elements}
+                for name, elements in json.loads(row[0]).items()}
+
+    def put(self, key: str, possible: Dict[str, Set[Any]]) -> None:
+        elements = json.dumps({name: sorted(values) for name, values in possible.items()})
+        self._pending.append((key, elements, time.time()))
+
+    def get_fragment(self, reporter: str, filename: str, fingerprint: str) -> Optional[str]:
+        conn = self._connect()
+        if conn is None:
+            return None
+        try:
+            row = conn.execute(queries.SELECT_REPORT_FRAGMENT, (reporter, filename, fingerprint)).fetchone()
+        except sqlite3.Error as e:
+            self.logger.debug(f"Report fragment lookup failed: {e}")
+            return None
+        return row[0] if row else None
+
+    def put_fragment(self, reporter: str, filename: str, fingerprint: str, fragment: str) -> None:
+        self._fragments.append((reporter, filename, fingerprint, fragment))
+
+    def flush(self) -> None:
+        """
+        Write pending entries in one transaction and drop stale ones.
+        """
+        conn = self._connect()
+        if conn is None or not (self._pending or self._touched or self._fragments):
+            return
+        try:
+            conn.executemany(queries.INSERT_ANALYSIS, self._pending)
+            conn.executemany(queries.TOUCH_ANALYSIS, self._touched)
+            conn.executemany(queries.INSERT_REPORT_FRAGMENT, self._fragments)
+            conn.execute(queries.PRUNE_ANALYSIS, (time.time() - _MAX_AGE,))
+            conn.commit()
+        except sqlite3.Error as e:
+            self.logger.debug(f"Failed to write analysis cache {self.path}: {e}")
+        self._pending.clear()
+        self._touched.clear()
+        self._fragments.clear()
+
+    def close(self) -> None:
+        self.flush()
+        if self._conn is not None:
+            self._conn.close()
+            self._conn = None
+
+
+class ReportCache:
+    """
+    Lets reporters skip re-rendering files whose fingerprint matches the previous report.
+
+    A file's fingerprint covers its analysis key (contents, Python version, exclusions,
+    metrics), the executed elements of every metric and the project root.
+    """
+
+    def __init__(self, cache: AnalysisCache, fingerprints: Dict[str, str], project_root: str) -> None:
+        self.cache = cache
+        self.fingerprints = fingerprints
+        self.project_root = project_root
+        self.reused = 0
+        self.rendered = 0
+
+    def _fingerprint(self, filename: str) -> Optional[str]:
+        fingerprint = self.fingerprints.get(filename)
+        if fingerprint is None:
+            return None
+        return hashlib.sha256(f"{FRAGMENT_VERSION}\0{self.project_root}\0{fingerprint}".encode('utf-8')).hexdigest()
+
+    def fragment(self, reporter: str, filename: str, render: Callable[[], str]) -> str:
+        """
+        Return the output of `render` for a file, reusing the previous report's output
+        when nothing it depends on changed.
+        """
+        fingerprint = self._fingerprint(filename)
+        if fingerprint is not None:
+            cached = self.cache.get_fragment(reporter, filename, fingerprint)
+            if cached is not None:
+                self.reused += 1
+                return cached
+
+        output = render()
+        self.rendered += 1
+        if fingerprint is not None:
+            self.cache.put_fragment(reporter, filename, fingerprint, output)
+        return output
+
+    def is_current(self, reporter: str, filename: str) -> bool:
+        """
+        True if the output the reporter keeps on disk for this file is up to date.
+        """
+        fingerprint = self._fingerprint(filename)
+        current = fingerprint is not None and self.cache.get_fragment(reporter, filename, fingerprint) is not None
+        if current:
+            self.reused += 1
+        return current
+
+    def remember(self, reporter: str, filename: str) -> None:
+        """
+        Record that the reporter wrote this file's output to disk.
+        """
+        self.rendered += 1
+        fingerprint = self._fingerprint(filename)
+        if fingerprint is not None:
+            self.cache.put_fragment(reporter, filename, fingerprint, '')
+
+    def flush(self) -> None:
+        self.cache.flush()
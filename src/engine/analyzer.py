@@ -1,7 +1,55 @@
 import os
-from collections import defaultdict
-from typing import Dict, Any, Set
+import hashlib
+import logging
+from collections import Counter, defaultdict
+from concurrent.futures import ProcessPoolExecutor
+from typing import Dict, Any, Iterator, List, Optional, Set, Tuple
 from .config import CoverageConfig
+from .analysis_cache import AnalysisCache, ReportCache
+from ..reporters.base import HIT_COUNTS
+
+# below this many files to analyze, starting a worker pool costs more than it saves
+PARALLEL_MIN_FILES = 16
+
+PossibleElements = Dict[str, Set[Any]]
+
+
+def static_analysis(parser, metrics, filename: str, source: bytes,
+                    exclude_patterns: Set[str]) -> Optional[PossibleElements]:
+    """
+    Return {metric name: possible elements} for one file, or None if it cannot be parsed.
+    The AST and the code object both come from the given source text.
+    """
+    parsed = parser.parse(filename, source, exclude_patterns)
+    if not parsed:
+        return None
+
+    possible: PossibleElements = {}
+    for metric in metrics:
+        name = metric.get_name()
+        if name in ("Statement", "Branch"):
+            possible[name] = metric.get_possible_elements(parsed.tree, parsed.ignored_lines)
+        elif name == "Condition":
+            # condition coverage needs the Code Object
+            possible[name] = metric.get_possible_elements(parsed.code, parsed.ignored_lines)  # type: ignore
+        else:
+            possible[name] = set()
+    return possible
+
+
+# parser and metrics of a pool worker, sent once by the pool initializer
+_worker_tools: Tuple[Any, Any] = (None, None)
+
+
+def _init_worker(parser, metrics) -> None:
+    global _worker_tools
+    _worker_tools = (parser, metrics)
+
+
+def _analyze_in_worker(job: Tuple[str, bytes, Set[str]]) -> Optional[PossibleElements]:
+    parser, metrics = _worker_tools
+    filename, source, exclude_patterns = job
+    return static_analysis(parser, metrics, filename, source, exclude_patterns)
 
 
 class Analyzer:
@@ -10,12 +58,19 @@ class Analyzer:
     to calculate coverage metrics.
     """
 
-    def __init__(self, parser, metrics, config: CoverageConfig, path_manager, excluded_files: Set[str]):
+    def __init__(self, parser, metrics, config: CoverageConfig, path_manager, excluded_files: Set[str],
+                 cache: Optional[AnalysisCache] = None):
+        self.logger = logging.getLogger(__name__)
         self.parser = parser
         self.metrics = metrics
         self.config = config
         self.path_manager = path_manager
         self.excluded_files = excluded_files
+        # static analysis results of unchanged files are reused across runs
+        self.cache = cache
+        # analysis cache key and report fingerprint per file of the last analyze()
+        self._source_keys: Dict[str, str] = {}
+        self.fingerprints: Dict[str, str] = {}
 
     def analyze(self, trace_data: Dict[str, Dict[Any, Any]]) -> Dict[str, Dict[str, Any]]:
         """
@@ -27,8 +82,53 @@ class Analyzer:
         Returns:
             dict: A mapping of filenames to metric statistics.
         """
-        full_results = {}
+        return dict(self.iter_analyze(trace_data))
+
+    def iter_analyze(self, trace_data: Dict[str, Dict[Any, Any]]) -> Iterator[Tuple[str, Dict[str, Any]]]:
+        """
+        Like analyze(), but yield (filename, metric statistics) one file at a time, in
+        filename order, so results can be reported before the remaining files are analyzed.
+        """
+        # cleared in place: a ReportCache handed out for this run sees fingerprints as they come
+        self._source_keys.clear()
+        self.fingerprints.clear()
+
+        executed_by_file = self._executed_by_file(trace_data)
+        exclude_patterns = self.config.exclude_lines
+
+        # 3. static analysis (cached by content hash, optionally in worker processes)
+        possible_elements = self._possible_elements(sorted(executed_by_file), exclude_patterns)
+
+        # 4. calculate metrics
+        for filename, possible_by_metric in possible_elements:
+            executed_by_metric = executed_by_file.pop(filename)
+            if possible_by_metric is None:
+                continue
+
+            file_results = {}
+            for metric in self.metrics:
+                name = metric.get_name()
+                stats = metric.calculate_stats(possible_by_metric.get(name, set()), executed_by_metric.get(name, set()))
+                file_results[name] = stats
+
+            counts = executed_by_metric.get(HIT_COUNTS)
+            if counts:
+                file_results[HIT_COUNTS] = counts
+
+            key = self._source_keys.get(filename)
+            if key is not None:
+                self.fingerprints[filename] = self._fingerprint(key, file_results)
+
+            yield filename, file_results
 
+        if self.cache:
+            self.cache.flush()
+
+    def _executed_by_file(self, trace_data: Dict[str, Dict[Any, Any]]) -> Dict[str, Dict[str, Set[Any]]]:
+        """
+        Return {filename: {metric name: executed elements}} for every traced file, with the
+        data of all raw aliases of a file merged.
+        """
         # 1. identify all unique files by normalized path to handle duplicates (raw vs normalized)
         file_map = defaultdict(list)
         all_raw_files = (
@@ -41,8 +141,7 @@ class Analyzer:
             norm = self.path_manager.canonicalize(f)
             file_map[norm].append(f)
 
-        exclude_patterns = self.config.exclude_lines
-
+        executed_by_file: Dict[str, Dict[str, Set[Any]]] = {}
         for norm_file, raw_files in file_map.items():
             # 2. aggregate data from all raw aliases
             # use the first raw file as canonical, preferring existing ones
@@ -73,32 +172,122 @@ class Analyzer:
                 for ctx_instr in trace_data['instruction_arcs'][rf].values():
                     aggregated_instr.update(ctx_instr)
 
-            # 3. parse and calculate metrics
-            ast_tree, ignored_lines = self.parser.parse_source(canonical_filename, exclude_patterns)
-            if not ast_tree:
+            executed_by_file[canonical_filename] = {
+                "Statement": aggregated_lines,
+                "Branch": aggregated_arcs,
+                "Condition": aggregated_instr,
+            }
+
+            # execution counts of count mode data, summed over aliases and contexts
+            line_counts: Counter = Counter()
+            arc_counts: Counter = Counter()
+            for rf in raw_files:
+                for counts in trace_data['line_counts'].get(rf, {}).values():
+                    line_counts.update(counts)
+                for counts in trace_data['arc_counts'].get(rf, {}).values():
+                    arc_counts.update(counts)
+            if line_counts or arc_counts:
+                executed_by_file[canonical_filename][HIT_COUNTS] = {
+                    'lines': dict(line_counts), 'arcs': dict(arc_counts)}
+        return executed_by_file
+
+    @staticmethod
+    def _fingerprint(source_key: str, file_results: Dict[str, Any]) -> str:
+        """
+        Hash of everything a file's report depends on: the analysis inputs (through the
+        cache key) and the executed elements of every metric.
+        """
+        digest = hashlib.sha256(source_key.encode('utf-8'))
+        for name in sorted(file_results):
+            if name == HIT_COUNTS:
+                counts = file_results[name]
+                digest.update(f"\0{name}:{sorted(counts['lines'].items())!r}:{sorted(counts['arcs'].items())!r}"
+                              .encode('utf-8'))
                 continue
+            digest.update(f"\0{name}:{sorted(file_results[name]['executed'])!r}".encode('utf-8'))
+        return digest.hexdigest()
 
-            code_obj = self.parser.compile_source(canonical_filename)
+    def report_cache(self, project_root: str) -> Optional[ReportCache]:
+        """
+        Fragment cache for reporting the last analyze() results, None without a cache.
+        """
+        if not self.cache:
+            return None
+        return ReportCache(self.cache, self.fingerprints, project_root)
 
-            file_results = {}
-            for metric in self.metrics:
-                possible = set()
-                executed = set()
-
-                if metric.get_name() == "Statement":
-                    possible = metric.get_possible_elements(ast_tree, ignored_lines)
-                    executed = aggregated_lines
-                elif metric.get_name() == "Branch":
-                    possible = metric.get_possible_elements(ast_tree, ignored_lines)
-                    executed = aggregated_arcs
-                elif metric.get_name() == "Condition":
-                    # condition coverage needs Code Object + Instruction Arcs
-                    possible = metric.get_possible_elements(code_obj, ignored_lines)  # type: ignore
-                    executed = aggregated_instr
-
-                stats = metric.calculate_stats(possible, executed)
-                file_results[metric.get_name()] = stats
-
-            full_results[canonical_filename] = file_results
-
-        return full_results
+    def _possible_elements(self, filenames: List[str],
+                           exclude_patterns: Set[str]) -> Iterator[Tuple[str, Optional[PossibleElements]]]:
+        """
+        Yield (filename, {metric name: possible elements}) in the given order, None for
+        files that cannot be read or parsed. Each file is read once. In-process, files are
+        read and analyzed one at a time; with analysis_jobs other than 1 all files are
+        looked up in the cache first and the misses are spread over a process pool.
+        """
+        names = [m.get_name() for m in self.metrics]
+        jobs = self.config.analysis_jobs
+        workers = jobs if jobs > 0 else (os.cpu_count() or 1)
+
+        if workers <= 1 or len(filenames) < PARALLEL_MIN_FILES:
+            for filename in filenames:
+                found, source, key = self._lookup(filename, exclude_patterns, names)
+                if source is not None:
+                    found = static_analysis(self.parser, self.metrics, filename, source, exclude_patterns)
+                    self._store(key, found)
+                yield filename, found
+            return
+
+        looked_up = [(filename,) + self._lookup(filename, exclude_patterns, names) for filename in filenames]
+        misses = [(filename, source) for filename, _, source, _ in looked_up if source is not None]
+        computed = self._analyze_misses(misses, exclude_patterns, workers)
+        for filename, found, source, key in looked_up:
+            if source is not None:
+                found = next(computed)
+                self._store(key, found)
+            yield filename, found
+
+    def _lookup(self, filename: str, exclude_patterns: Set[str],
+                names: List[str]) -> Tuple[Optional[PossibleElements], Optional[bytes], Optional[str]]:
+        """
+        Return (cached possible elements, None, key) for a cache hit, (None, source, key)
+        for a file that needs analysis and (None, None, None) for an unreadable file.
+        """
+        source = self.parser.read_source(filename)
+        if source is None:
+            return None, None, None
+
+        key = None
+        if self.cache:
+            key = self.cache.key_for(source, exclude_patterns, names)
+            self._source_keys[filename] = key
+            cached = self.cache.get(key)
+            if cached is not None:
+                return cached, None, key
+        return None, source, key
+
+    def _store(self, key: Optional[str], possible: Optional[PossibleElements]) -> None:
+        if self.cache and key is not None and possible is not None:
+            self.cache.put(key, possible)
+
+    def _analyze_misses(self, misses: List[Tuple[str, bytes]], exclude_patterns: Set[str],
+                        workers: int) -> Iterator[Optional[PossibleElements]]:
+        """
+        Yield the possible elements of each miss in order, computed by a process pool
+        once at least PARALLEL_MIN_FILES files need analysis.
+        """
+        done = 0
+        if workers > 1 and len(misses) >= PARALLEL_MIN_FILES:
+            work = [(filename, source, exclude_patterns) for filename, source in misses]
+            try:
+                with ProcessPoolExecutor(max_workers=workers, initializer=_init_worker,
+                                         initargs=(self.parser, self.metrics)) as pool:
+                    # workers only send back the per-metric element sets
+                    chunksize = max(1, len(work) // (workers * 4))
+                    for possible in pool.map(_analyze_in_worker, work, chunksize=chunksize):
+                        done += 1
+                        yield possible
+                return
+            except Exception as e:
+                self.logger.warning(f"Parallel analysis failed, analyzing sequentially: {e}")
+
+        for filename, source in misses[done:]:
+            yield static_analysis(self.parser, self.metrics, filename, source, exclude_patterns)
@@ -0,0 +1,195 @@
+"""
+Shared coverage arena for multi-process collection (shared_arena = true).
+
+Without it every process keeps private hit sets and writes its own partial file, so a
+prefork server with 32 workers leaves 32 mostly identical copies to combine. With it the
+first process creates one file-backed mmap with a region per project file, every process
+tracing with the C extension (forked, spawned or started through the bootstrapper) sets
+its hits in it with atomic operations, and only the creator saves them.
+
+Layout (header and entries little-endian, region words in native byte order):
+
+    header   magic, version, file count, stopped flag, total size
+    entries  per file: path offset and length, line count, line bitmap offset,
+             pair table offset and capacity
+    paths    UTF-8 path strings
+    regions  64-byte aligned; a bitmap of uint64 words (bit N set meaning line N ran)
+             followed by an open-addressing table of uint64 pair keys
+
+A pair key is ((kind << 62) | (a << 31) | b) + 1, 0 marking an empty slot; kind 0 is an
+arc (from line, to line) and kind 1 an instruction arc (from offset, to offset). Hits
+the arena cannot hold (other contexts, a full table, files created after the arena)
+stay in the recording process's own buffers and go to its partial file as before.
+"""
+import mmap
+import os
+import struct
+import sys
+from typing import Dict, Optional, Set, Tuple
+
+ARENA_MAGIC = b'MINICOVA'
+ARENA_VERSION = 1
+# set by the creator to the arena's path, so processes it execs attach instead of creating one
+ARENA_ENV = 'MINICOV_ARENA'
+
+_HEADER = struct.Struct('<8sIIIxxxxQ')
+_ENTRY = struct.Struct('<QIIQQQ')
+_STOPPED_OFFSET = 16
+_ALIGN = 64
+_MIN_PAIRS = 16
+_KIND_INSTRUCTION_ARC = 1
+_PAIR_MASK = (1 << 31) - 1
+
+# (line bitmap offset, line count, pair table offset, pair table capacity)
+Region = Tuple[int, int, int, int]
+
+
+def _aligned(offset: int) -> int:
+    return (offset + _ALIGN - 1) & ~(_ALIGN - 1)
+
+
+def _pair_capacity(nlines: int) -> int:
+    # about two arcs per line, kept at most half full
+    capacity = _MIN_PAIRS
+    while capacity < 4 * nlines:
+        capacity *= 2
+    return capacity
+
+
+class SharedArena:
+    """
+    A mapped arena file. create() lays it out, open() attaches to an existing one;
+    `buffer` is the writable mapping handed to the C tracer's attach_arena().
+    """
+
+    def __init__(self, path: str, buffer: mmap.mmap, regions: Dict[str, Region]) -> None:
+        self.path = path
+        self.buffer = buffer
+        self.regions = regions
+        # hits already returned by take_new(): {path: (line bits, pair keys)}
+        self._taken: Dict[str, Tuple[int, Set[int]]] = {}
+
+    @classmethod
+    def create(cls, path: str, files: Dict[str, int]) -> 'SharedArena':
+        """
+        Create the arena file at path with a region per file, sized from its line count.
+        """
+        names = sorted(files)
+        encoded = [name.encode('utf-8') for name in names]
+        offset = _HEADER.size + _ENTRY.size * len(names)
+        path_offsets = []
+        for raw in encoded:
+            path_offsets.append(offset)
+            offset += len(raw)
+
+        entries = []
+        regions: Dict[str, Region] = {}
+        for name, raw, path_offset in zip(names, encoded, path_offsets):
+            nlines = files[name]
+            lines_offset = _aligned(offset)
+            pairs_offset = _aligned(lines_offset + 8 * (nlines // 64 + 1))
+            capacity = _pair_capacity(nlines)
+            offset = pairs_offset + 8 * capacity
+            regions[name] = (lines_offset, nlines, pairs_offset, capacity)
+            entries.append(_ENTRY.pack(path_offset, len(raw), nlines, lines_offset, pairs_offset, capacity))
+        size = _aligned(offset)
+
+        # written under a temporary name, so nobody attaches to a half-written arena
+        tmp = f"{path}.tmp"
+        with open(tmp, 'wb') as f:
+            f.write(_HEADER.pack(ARENA_MAGIC, ARENA_VERSION, len(names), 0, size))
+            f.write(b''.join(entries))
+            f.write(b''.join(encoded))
+            # the regions stay a sparse hole until they are written to
+            f.truncate(size)
+        os.replace(tmp, path)
+        return cls(path, cls._map(path, size), regions)
+
+    @classmethod
+    def open(cls, path: str) -> Optional['SharedArena']:
+        """
+        Attach to the arena file at path; None if it is missing or not an arena.
+        """
+        try:
+            with open(path, 'rb') as f:
+                header = f.read(_HEADER.size)
+            if len(header) < _HEADER.size:
+                return None
+            magic, version, count, _, size = _HEADER.unpack(header)
+            if magic != ARENA_MAGIC or version != ARENA_VERSION:
+                return None
+            buffer = cls._map(path, size)
+        except (OSError, ValueError):
+            return None
+
+        regions: Dict[str, Region] = {}
+        for i in range(count):
+            path_offset, length, nlines, lines_offset, pairs_offset, capacity = \
+                _ENTRY.unpack_from(buffer, _HEADER.size + i * _ENTRY.size)
+            name = buffer[path_offset:path_offset + length].decode('utf-8')
+            regions[name] = (lines_offset, nlines, pairs_offset, capacity)
+        return cls(path, buffer, regions)
+
+    @staticmethod
+    def _map(path: str, size: int) -> mmap.mmap:
+        fd = os.open(path, os.O_RDWR)
+        try:
+            return mmap.mmap(fd, size)
+        finally:
+            os.close(fd)
+
+    @property
+    def stopped(self) -> bool:
+        """True once the creator has taken its final snapshot (see mark_stopped())."""
+        return _HEADER.unpack_from(self.buffer)[3] != 0
+
+    def mark_stopped(self) -> None:
+        """
+        Tell the processes still attached that the creator saves nothing more, so each
+        saves the arena itself when it stops.
+        """
+        struct.pack_into('<I', self.buffer, _STOPPED_OFFSET, 1)
+
+    def take_new(self) -> Dict[str, Tuple[Set[int], Set[Tuple[int, int]], Set[Tuple[int, int]]]]:
+        """
+        Lines, arcs and instruction arcs per file that were set since the previous call.
+        """
+        result = {}
+        with memoryview(self.buffer) as view:
+            for name, (lines_offset, nlines, pairs_offset, capacity) in self.regions.items():
+                bits = int.from_bytes(view[lines_offset:lines_offset + 8 * (nlines // 64 + 1)], sys.byteorder)
+                with view[pairs_offset:pairs_offset + 8 * capacity].cast('Q') as table:
+                    keys = {key for key in table if key} if any(table) else set()
+
+                taken_bits, taken_keys = self._taken.get(name, (0, set()))
+                new_bits = bits & ~taken_bits
+                new_keys = keys - taken_keys
+                if not new_bits and not new_keys:
+                    continue
+                self._taken[name] = (taken_bits | new_bits, taken_keys | new_keys)
+
+                lines = set()
+                while new_bits:
+                    low = new_bits & -new_bits
+                    lines.add(low.bit_length() - 1)
+                    new_bits ^= low
+                arcs = set()
+                instruction_arcs = set()
+                for key in new_keys:
+                    key -= 1
+                    pair = ((key >> 31) & _PAIR_MASK, key & _PAIR_MASK)
+                    (instruction_arcs if key >> 62 == _KIND_INSTRUCTION_ARC else arcs).add(pair)
+                result[name] = (lines, arcs, instruction_arcs)
+        return result
+
+    def close(self, unlink: bool = False) -> None:
+        """
+        Unmap the arena; unlink also removes the file (the creator, once it saved).
+        The C tracer must have detached first.
+        """
+        self.buffer.close()
+        if unlink:
+            try:
+                os.remove(self.path)
+            except FileNotFoundError:
+                pass
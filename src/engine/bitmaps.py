@@ -0,0 +1,161 @@
+"""
+Compact encodings for the bitmap storage format.
+
+Lines are stored as one zlib-compressed bitmap per (file, context), bit N set meaning
+line N ran. Arcs and instruction arcs are stored as zlib-compressed arrays of
+little-endian int32 pairs, sorted so equal sets always encode to equal blobs. Hit
+counts (count mode) travel in deltas as zlib-compressed int64 arrays of the counted
+value followed by its count.
+
+The same blobs make up the deltas one engine sends to another (e.g. pytest-xdist
+workers to the controller); a delta only holds builtin types, so it can go over any
+channel that serializes them.
+"""
+import sys
+import zlib
+from array import array
+from typing import Any, Dict, Iterable, Iterator, Mapping, Set, Tuple, Union
+
+DELTA_VERSION = 2
+
+# trace data kinds and how their values are encoded
+_DELTA_KINDS = ('lines', 'arcs', 'instruction_arcs')
+# count kinds and the number of integers of their counted values
+_DELTA_COUNT_KINDS = {'line_counts': 1, 'arc_counts': 2}
+
+_COMPRESSION_LEVEL = 6
+
+
+def encode_lines(lines: Iterable[int]) -> bytes:
+    lines = list(lines)
+    bits = bytearray(max(lines) // 8 + 1 if lines else 0)
+    for line in lines:
+        bits[line >> 3] |= 1 << (line & 7)
+    return zlib.compress(bytes(bits), _COMPRESSION_LEVEL)
+
+
+def decode_lines(blob: bytes) -> Set[int]:
+    lines = set()
+    for index, byte in enumerate(zlib.decompress(blob)):
+        if not byte:
+            continue
+        base = index << 3
+        for bit in range(8):
+            if byte >> bit & 1:
+                lines.add(base + bit)
+    return lines
+
+
+def any_line_in_range(blob: bytes, start: int, end: int) -> bool:
+    """True if the encoded bitmap has a line from start to end (inclusive) set."""
+    if end < start:
+        return False
+    bits = int.from_bytes(zlib.decompress(blob), 'little')
+    return bits >> start & ((1 << (end - start + 1)) - 1) != 0
+
+
+def merge_lines(a: bytes, b: bytes) -> bytes:
+    """OR two encoded line bitmaps without expanding them into sets."""
+    raw_a, raw_b = zlib.decompress(a), zlib.decompress(b)
+    size = max(len(raw_a), len(raw_b))
+    merged = int.from_bytes(raw_a, 'little') | int.from_bytes(raw_b, 'little')
+    return zlib.compress(merged.to_bytes(size, 'little'), _COMPRESSION_LEVEL)
+
+
+def encode_pairs(pairs: Iterable[Tuple[int, int]]) -> bytes:
+    flat = array('i')
+    for start, end in sorted(pairs):
+        flat.append(start)
+        flat.append(end)
+    if sys.byteorder == 'big':
+        flat.byteswap()
+    return zlib.compress(flat.tobytes(), _COMPRESSION_LEVEL)
+
+
+def decode_pairs(blob: bytes) -> Set[Tuple[int, int]]:
+    flat = array('i')
+    flat.frombytes(zlib.decompress(blob))
+    if sys.byteorder == 'big':
+        flat.byteswap()
+    return set(zip(flat[::2], flat[1::2]))
+
+
+def merge_pairs(a: bytes, b: bytes) -> bytes:
+    return encode_pairs(decode_pairs(a) | decode_pairs(b))
+
+
+def encode_counts(counts: Mapping[Any, int], width: int) -> bytes:
+    """
+    Encode {value: hits} where values are ints (width 1) or pairs of ints (width 2).
+    """
+    flat = array('q')
+    for value, hits in sorted(counts.items()):
+        if width == 1:
+            flat.append(value)
+        else:
+            flat.extend(value)
+        flat.append(hits)
+    if sys.byteorder == 'big':
+        flat.byteswap()
+    return zlib.compress(flat.tobytes(), _COMPRESSION_LEVEL)
+
+
+def decode_counts(blob: bytes, width: int) -> Dict[Any, int]:
+    flat = array('q')
+    flat.frombytes(zlib.decompress(blob))
+    if sys.byteorder == 'big':
+        flat.byteswap()
+    step = width + 1
+    if width == 1:
+        return dict(zip(flat[::step], flat[1::step]))
+    return {tuple(flat[i:i + width]): flat[i + width] for i in range(0, len(flat), step)}
+
+
+def encode_delta(trace_data: Any, contexts: Dict[int, str]) -> Dict[str, Any]:
+    """
+    Encode trace data as {'version', 'contexts': [[cid, label]], kind: [[path, cid, blob]]}.
+    Contexts are sent by label, since the receiver numbers its contexts differently.
+    """
+    delta: Dict[str, Any] = {'version': DELTA_VERSION}
+    used = set()
+    for kind in _DELTA_KINDS:
+        encode = encode_lines if kind == 'lines' else encode_pairs
+        entries = []
+        for path, per_ctx in trace_data[kind].items():
+            for cid, values in per_ctx.items():
+                if values:
+                    entries.append([path, cid, encode(values)])
+                    used.add(cid)
+        delta[kind] = entries
+    for kind, width in _DELTA_COUNT_KINDS.items():
+        entries = []
+        try:
+            per_file = trace_data[kind]
+        except KeyError:
+            # plain trace dicts may come without counts
+            per_file = {}
+        for path, per_ctx in per_file.items():
+            for cid, counts in per_ctx.items():
+                if counts:
+                    entries.append([path, cid, encode_counts(counts, width)])
+                    used.add(cid)
+        delta[kind] = entries
+    delta['contexts'] = [[cid, contexts.get(cid, 'default')] for cid in sorted(used)]
+    return delta
+
+
+def decode_delta(delta: Dict[str, Any]) -> Iterator[Tuple[str, str, str, Union[Set[Any], Dict[Any, int]]]]:
+    """
+    Yield (kind, path, context label, values) for every entry of an encode_delta() result;
+    values are a set, or {value: hits} for the count kinds.
+    """
+    if delta.get('version') != DELTA_VERSION:
+        raise ValueError(f"Unsupported coverage delta version: {delta.get('version')}")
+    labels = {cid: label for cid, label in delta['contexts']}
+    for kind in _DELTA_KINDS:
+        decode = decode_lines if kind == 'lines' else decode_pairs
+        for path, cid, blob in delta[kind]:
+            yield kind, path, labels[cid], decode(blob)
+    for kind, width in _DELTA_COUNT_KINDS.items():
+        for path, cid, blob in delta[kind]:
+            yield kind, path, labels[cid], decode_counts(blob, width)
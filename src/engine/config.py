@@ -9,7 +9,31 @@ class CoverageConfig:
     source: Set[str] = field(default_factory=set)
     branch: bool = False
     concurrency: str = 'thread'
+    # 'full', 'first-hit' (sys.monitoring only: each location is recorded once, then disabled)
+    # 'sampled' (first-hit on a random sample_rate fraction of code objects) or 'count'
+    # (full tracing that also counts executions of every line and arc)
+    collection_mode: str = 'full'
+    sample_rate: float = 0.1
     exclude_lines: Set[str] = field(default_factory=set)
     data_file: str = '.coverage.db'
+    # static analysis cache keyed by file content; empty disables it
+    analysis_cache: str = '.coverage.analysis'
+    # processes used for static analysis: 1 analyzes in-process, 0 uses every CPU
+    analysis_jobs: int = 1
+    # processes rendering HTML pages: 1 renders in-process, 0 uses every CPU
+    report_jobs: int = 1
+    # report each file as soon as it is analyzed instead of analyzing everything first
+    stream_reports: bool = False
+    # 'rows' (one SQLite row per hit) or 'bitmap' (one compressed blob per file and context)
+    storage_format: str = 'rows'
+    # processes used to combine partial files: 1 merges sequentially, 0 uses every CPU
+    combine_jobs: int = 1
+    # background flush of recorded hits into the partial file: every N seconds and/or
+    # once N hits are buffered (0 disables a trigger)
+    flush_interval: float = 0.0
+    flush_max_hits: int = 0
+    # one mmap'd arena of line bitmaps and arc tables shared by every process of the run,
+    # saved by the process that created it instead of a partial file per process
+    shared_arena: bool = False
     paths: Dict[str, List[str]] = field(default_factory=dict)
     reporters: List[str] = field(default_factory=lambda: ['console', 'html'])
@@ -111,6 +111,39 @@ class ConfigLoader:
             if parser.has_option(run_section, 'data_file'):
                 config.data_file = parser.get(run_section, 'data_file').strip()
 
+            if parser.has_option(run_section, 'analysis_cache'):
+                config.analysis_cache = parser.get(run_section, 'analysis_cache').strip()
+
+            if parser.has_option(run_section, 'analysis_jobs'):
+                config.analysis_jobs = parser.getint(run_section, 'analysis_jobs')
+
+            if parser.has_option(run_section, 'report_jobs'):
+                config.report_jobs = parser.getint(run_section, 'report_jobs')
+
+            if parser.has_option(run_section, 'stream_reports'):
+                config.stream_reports = parser.getboolean(run_section, 'stream_reports')
+
+            if parser.has_option(run_section, 'collection_mode'):
+                config.collection_mode = parser.get(run_section, 'collection_mode').strip()
+
+            if parser.has_option(run_section, 'sample_rate'):
+                config.sample_rate = parser.getfloat(run_section, 'sample_rate')
+
+            if parser.has_option(run_section, 'storage_format'):
+                config.storage_format = parser.get(run_section, 'storage_format').strip()
+
+            if parser.has_option(run_section, 'combine_jobs'):
+                config.combine_jobs = parser.getint(run_section, 'combine_jobs')
+
+            if parser.has_option(run_section, 'flush_interval'):
+                config.flush_interval = parser.getfloat(run_section, 'flush_interval')
+
+            if parser.has_option(run_section, 'flush_max_hits'):
+                config.flush_max_hits = parser.getint(run_section, 'flush_max_hits')
+
+            if parser.has_option(run_section, 'shared_arena'):
+                config.shared_arena = parser.getboolean(run_section, 'shared_arena')
+
         # parse report section
         if report_section and parser.has_option(report_section, 'exclude_lines'):
             val = parser.get(report_section, 'exclude_lines')
@@ -148,9 +181,32 @@ class ConfigLoader:
         if 'branch' in run:
             config.branch = bool(run['branch'])
         if 'concurrency' in run:
-            config.concurrency = str(run['concurrency'])
+            concurrency = run['concurrency']
+            config.concurrency = ','.join(concurrency) if isinstance(concurrency, list) else str(concurrency)
         if 'data_file' in run:
             config.data_file = str(run['data_file'])
+        if 'analysis_cache' in run:
+            config.analysis_cache = str(run['analysis_cache'])
+        if 'analysis_jobs' in run:
+            config.analysis_jobs = int(run['analysis_jobs'])
+        if 'report_jobs' in run:
+            config.report_jobs = int(run['report_jobs'])
+        if 'stream_reports' in run:
+            config.stream_reports = bool(run['stream_reports'])
+        if 'collection_mode' in run:
+            config.collection_mode = str(run['collection_mode'])
+        if 'sample_rate' in run:
+            config.sample_rate = float(run['sample_rate'])
+        if 'storage_format' in run:
+            config.storage_format = str(run['storage_format'])
+        if 'combine_jobs' in run:
+            config.combine_jobs = int(run['combine_jobs'])
+        if 'flush_interval' in run:
+            config.flush_interval = float(run['flush_interval'])
+        if 'flush_max_hits' in run:
+            config.flush_max_hits = int(run['flush_max_hits'])
+        if 'shared_arena' in run:
+            config.shared_arena = bool(run['shared_arena'])
 
         # report section
         if 'exclude_lines' in report:
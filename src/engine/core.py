@@ -1,11 +1,17 @@
 import sys
 import os
+import atexit
+import re
 import logging
 import threading
 import multiprocessing
+import multiprocessing.util
+import time
 import types
+import contextlib
+from collections import defaultdict
 
-from typing import Optional, List, Dict, Any, Set
+from typing import Callable, Optional, List, Dict, Any, Iterator, Set, Tuple
 
 # try to import the C extension
 try:
@@ -16,17 +22,47 @@ except ImportError:
 from .config import CoverageConfig
 from .report_manager import ReportManager
 from .analyzer import Analyzer
+from .analysis_cache import AnalysisCache
+from ..tracing.base import BaseTracer
 from ..tracing.sys_monitoring import SysMonitoringTracer
 from ..tracing.sys_settrace import SysSetTraceTracer
-from .trace_data import TraceContainer
+from .trace_data import TraceContainer, HIT_KINDS, COUNT_KINDS
+from .file_table import FileTable
+from .flusher import BackgroundFlusher
 from .path_manager import PathManager
 from .source_parser import SourceParser
 from .config_loader import ConfigLoader
 from ..metrics import StatementCoverage, BranchCoverage, ConditionCoverage
 from .storage import CoverageStorage
+from .arena import SharedArena, ARENA_ENV
+from . import bitmaps
 
 _OriginalProcess = multiprocessing.Process
 
+# concurrency libraries whose switches swap the whole stack of frames, so arc history
+# is kept per greenlet; asyncio tasks nest on their thread and need nothing extra
+GREENLET_CONCURRENCY = {'greenlet', 'gevent', 'eventlet'}
+CONCURRENCY_MODES = {'thread', 'asyncio'} | GREENLET_CONCURRENCY
+
+# the engine currently tracing in this process; a forked child keeps using it
+_active_engine: Optional['MiniCoverage'] = None
+
+
+def _after_fork_in_child() -> None:
+    # runs for every fork, before any other code in the child
+    if _active_engine is not None:
+        _active_engine._reset_after_fork()
+
+
+if hasattr(os, 'register_at_fork'):
+    os.register_at_fork(after_in_child=_after_fork_in_child)
+
+
+def _start_method() -> str:
+    # the method Process.start() uses; unset means the platform default, listed first.
+    # get_start_method() without allow_none would fix the default for the whole process
+    return multiprocessing.get_start_method(allow_none=True) or multiprocessing.get_all_start_methods()[0]
+
 
 class CoverageProcess(_OriginalProcess):
     # class-level config to support pickling (set by _patch_multiprocessing)
@@ -36,9 +72,28 @@ class CoverageProcess(_OriginalProcess):
         super().__init__(*args, **kwargs)
         self._cov_project_root = self._subprocess_setup["project_root"]
         self._cov_config_file = self._subprocess_setup["config_file"]
+        self._cov_snapshot: Optional[Dict[str, Any]] = None
+
+    def start(self) -> None:
+        # spawn and forkserver children unpickle this object: send them the parent's
+        # config and caches so they do not have to rebuild them
+        if _active_engine is not None and _start_method() in ('spawn', 'forkserver'):
+            self._cov_snapshot = _active_engine.snapshot()
+        super().start()
 
     def run(self) -> None:
-        if self._cov_project_root:
+        if _active_engine is not None and _active_engine._forked:
+            # forked: the parent's engine keeps tracing here with emptied buffers and
+            # saves the child's partial when the process exits
+            super().run()
+        elif self._cov_snapshot is not None:
+            cov = MiniCoverage.from_snapshot(self._cov_snapshot)
+            cov.start()
+            try:
+                super().run()
+            finally:
+                cov.stop()
+        elif self._cov_project_root:
             cov = MiniCoverage(project_root=self._cov_project_root, config_file=self._cov_config_file)
             cov.start()
             try:
@@ -50,13 +105,15 @@ class CoverageProcess(_OriginalProcess):
 
 
 class MiniCoverage:
-    def __init__(self, project_root: Optional[str] = None, config_file: Optional[str] = None) -> None:
+    def __init__(self, project_root: Optional[str] = None, config_file: Optional[str] = None,
+                 config: Optional[CoverageConfig] = None) -> None:
         """
         Initialize the coverage engine.
 
         Args:
             project_root (str): The root directory to restrict tracing to.
             config_file (str): Optional path to a configuration file.
+            config (CoverageConfig): Already loaded configuration; skips loading config_file.
         """
         self.logger = logging.getLogger(__name__)
 
@@ -70,14 +127,22 @@ class MiniCoverage:
         # note: config is loaded with the raw root first, then PathManager canonicalizes it
         self.path_manager = PathManager(root, {})
         self.project_root = self.path_manager.project_root
-        self.config: CoverageConfig = self.config_loader.load_config(self.project_root, config_file)
+        if config is None:
+            config = self.config_loader.load_config(self.project_root, config_file)
+        self.config: CoverageConfig = config
         self.path_manager.config = self.config
 
         # structure: {filename: {context_id: {data}}}
         # 'lines': set(lineno)
         # 'arcs': set((start, end))
         # 'instruction_arcs': set((from_offset, to_offset)) -> new for MC/DC
+        # 'line_counts', 'arc_counts': Counter of executions, in count mode only
         self.trace_data = TraceContainer()
+        # summed hit counts of the data file, loaded by combine_data(); the counts in
+        # trace_data are only those not saved yet
+        self.combined_counts = TraceContainer()
+        # collection_mode = count, set by start()
+        self.count_hits = False
 
         self.current_context: str = "default"
         self.context_cache: Dict[str, int] = {"default": 0}
@@ -86,17 +151,23 @@ class MiniCoverage:
         self._context_lock = threading.Lock()
 
         # initialize storage manager
-        self.storage = CoverageStorage(self.config.data_file)
+        self.storage = CoverageStorage(self.config.data_file, self.config.storage_format)
 
         self.parser = SourceParser()
         self.metrics = [StatementCoverage(), BranchCoverage(), ConditionCoverage()]
         # ensure excluded files are also normalized
         self.excluded_files: Set[str] = set()
-        self.analyzer = Analyzer(self.parser, self.metrics, self.config, self.path_manager, self.excluded_files)
+        analysis_cache = AnalysisCache(self.config.analysis_cache) if self.config.analysis_cache else None
+        self.analyzer = Analyzer(self.parser, self.metrics, self.config, self.path_manager, self.excluded_files,
+                                 analysis_cache)
 
-        self.report_manager = ReportManager(self.config.reporters)
+        self.report_manager = ReportManager(self.config.reporters, self.parser.read_source, self.config.report_jobs)
+        # seconds spent per phase (save, flush, combine, load, analyze, report.<Reporter>), see stats()
+        self.timings: Dict[str, float] = defaultdict(float)
 
         self._cache_traceable: Dict[str, bool] = {}
+        # file path <-> integer ID table shared by the C tracer and storage
+        self.file_table = FileTable()
         self.thread_local = threading.local()
 
         # initialize C Tracer if available
@@ -109,9 +180,87 @@ class MiniCoverage:
             except Exception as e:
                 self.logger.warning(f"Failed to initialize C Tracer: {e}")
 
+        # (greenlet module, previous greenlet.settrace() callback) while greenlets are tracked
+        self._greenlet_trace: Optional[Tuple[Any, Any]] = None
+        # arc histories of suspended greenlets for the Python tracers, by id()
+        self._greenlet_histories: Dict[int, Tuple[Any, ...]] = {}
+
         # initialize tracers
         self.sys_monitoring_tracer = SysMonitoringTracer(self)
         self.sys_settrace_tracer = SysSetTraceTracer(self, self.c_tracer)
+        # the Python tracer start() installed, whose counters stats() reports
+        self._python_tracer: BaseTracer = self.sys_settrace_tracer
+
+        self.flusher: Optional[BackgroundFlusher] = None
+        if self.config.flush_interval > 0 or self.config.flush_max_hits > 0:
+            self.flusher = BackgroundFlusher(self, self.config.flush_interval, self.config.flush_max_hits)
+
+        # True in a forked child still tracing with its parent's engine
+        self._forked = False
+
+        # shared_arena: the mapped arena the C tracer records into, and whether this
+        # process created it (and so saves it)
+        self.arena: Optional[SharedArena] = None
+        self._arena_owner = False
+
+    @classmethod
+    def from_snapshot(cls, snapshot: Dict[str, Any]) -> 'MiniCoverage':
+        """
+        Create the engine of a spawned child from its parent's snapshot().
+        """
+        cov = cls(project_root=snapshot["project_root"], config_file=snapshot["config_file"],
+                  config=snapshot["config"])
+        cov.path_manager.seed(snapshot["canonical_paths"])
+        cov._cache_traceable.update(snapshot["traceable"])
+        return cov
+
+    def snapshot(self) -> Dict[str, Any]:
+        """
+        Picklable state a spawned child needs to trace like this engine: the loaded
+        config and the per-file canonicalization and traceability decisions.
+        """
+        return {
+            "project_root": self.project_root,
+            "config_file": self.config_file,
+            "config": self.config,
+            "canonical_paths": self.path_manager.canonical_paths(),
+            "traceable": dict(self._cache_traceable),
+        }
+
+    def _reset_after_fork(self) -> None:
+        """
+        Turn the copy of a tracing engine inherited by a forked child into the child's
+        own: drop the parent's buffered hits and write to a new partial file. Config,
+        compiled filters and the traceability cache are kept.
+        """
+        self._forked = True
+        self._context_lock = threading.Lock()
+        # the arena mapping is inherited and shared; the parent saves it
+        self._arena_owner = False
+        # the parent saves what it recorded before the fork
+        if self.c_tracer:
+            self.c_tracer.drain()
+        self.trace_data.take()
+        self.storage.reset_partial()
+
+        # threads do not survive a fork
+        if self.flusher:
+            self.flusher = BackgroundFlusher(self, self.config.flush_interval, self.config.flush_max_hits)
+            self.flusher.start()
+
+        # a plain os.fork() child (prefork servers) saves its data at interpreter exit;
+        # multiprocessing children exit through os._exit(), without atexit handlers, but
+        # its finalizers still run, so register one of those too
+        atexit.register(self._stop_if_active)
+        multiprocessing.util.register_after_fork(self, MiniCoverage._save_at_child_exit)
+
+    def _save_at_child_exit(self) -> None:
+        multiprocessing.util.Finalize(None, self._stop_if_active, exitpriority=100)
+
+    def _stop_if_active(self) -> None:
+        # stop() clears _active_engine, so of several exit hooks only the first saves
+        if _active_engine is self:
+            self.stop()
 
     def switch_context(self, context_label: str) -> None:
         """
@@ -124,39 +273,199 @@ class MiniCoverage:
             return
 
         with self._context_lock:
-            if context_label not in self.context_cache:
-                cid = self._next_context_id
-                self.context_cache[context_label] = cid
-                self.reverse_context_cache[cid] = context_label
-                self._next_context_id += 1
-
+            cid = self._assign_context_id(context_label)
             self.current_context = context_label
+            # the C tracer reads the active ID natively instead of calling back per event
+            if self.c_tracer:
+                self.c_tracer.set_context(cid)
+
+        self.sys_monitoring_tracer.restart_events()
+
+    def switch_thread_context(self, context_label: Optional[str]) -> None:
+        """
+        Switch the recording context of the calling thread only.
+
+        Lets concurrent test runners attribute hits per worker thread. Passing None
+        makes the thread follow the context set by switch_context() again.
+        """
+        if context_label is None:
+            self.thread_local.context_id = None
+        else:
+            with self._context_lock:
+                self.thread_local.context_id = self._assign_context_id(context_label)
+
+        if self.c_tracer:
+            self.c_tracer.set_thread_context(self.thread_local.context_id)
+
+        self.sys_monitoring_tracer.restart_events()
+
+    def _assign_context_id(self, context_label: str) -> int:
+        """
+        Return the ID of context_label, assigning a new one on first use.
+        Must be called with _context_lock held.
+        """
+        cid = self.context_cache.get(context_label)
+        if cid is None:
+            cid = self._next_context_id
+            self.context_cache[context_label] = cid
+            self.reverse_context_cache[cid] = context_label
+            self._next_context_id += 1
+        return cid
 
     def _get_current_context_id(self) -> int:
         """
         Retrieve the integer ID for the active context.
         """
+        cid = getattr(self.thread_local, 'context_id', None)
+        if cid is not None:
+            return cid
         # optimization: fast lookup without lock if possible (GIL makes dict read atomic-ish)
         return self.context_cache.get(self.current_context, 0)
 
+    def sample_rate(self) -> float:
+        """
+        Fraction of traceable code objects recorded: config.sample_rate in sampled mode, else 1.
+        """
+        if self.config.collection_mode != 'sampled':
+            return 1.0
+        return min(max(self.config.sample_rate, 0.0), 1.0)
+
     def save_data(self) -> None:
         """
         Dump the in-memory coverage data to a unique SQLite file via Storage Manager.
         """
-        self.storage.save(self.trace_data, self.context_cache)
+        # the C tracer buffers hits natively; move them into trace_data first
+        with self._timed('save'):
+            if self.c_tracer:
+                self.c_tracer.drain()
+            self._take_arena()
+
+            # counts are summed when partials are combined, so each is saved only once
+            self.storage.save(self.trace_data.take_counts(), self.context_cache, self.file_table)
+
+    def flush_data(self) -> None:
+        """
+        Append the hits recorded since the last flush to the partial data file and drop
+        them from memory. Safe to call from another thread while tracing runs.
+        """
+        with self._timed('flush'):
+            if self.c_tracer:
+                self.c_tracer.drain()
+            self._take_arena()
+
+            # give threads preempted between fetching a set and adding to it time to finish
+            delta = self.trace_data.take(grace=sys.getswitchinterval())
+            self.storage.save(delta, dict(self.context_cache), self.file_table)
+
+    def export_delta(self) -> Dict[str, Any]:
+        """
+        Take everything recorded since the last flush or export out of memory, encoded
+        with bitmaps.encode_delta() for merge_delta() in another engine.
+        """
+        if self.c_tracer:
+            self.c_tracer.drain()
+        self._take_arena()
+        delta = self.trace_data.take(grace=sys.getswitchinterval())
+        return bitmaps.encode_delta(delta, dict(self.reverse_context_cache))
+
+    def merge_delta(self, delta: Dict[str, Any]) -> None:
+        """
+        Add hits exported by another engine to this one's memory; they are saved
+        with this engine's own data.
+        """
+        map_path = self.path_manager.map_path if self.config.paths else None
+        target = {kind: self.trace_data[kind] for kind in HIT_KINDS + COUNT_KINDS}
+        cids: Dict[str, int] = {}
+        for kind, path, label, values in bitmaps.decode_delta(delta):
+            cid = cids.get(label)
+            if cid is None:
+                with self._context_lock:
+                    cid = cids[label] = self._assign_context_id(label)
+            if map_path:
+                path = map_path(path)
+            # Counter.update() adds to the counts, set.update() merges hits
+            target[kind][path][cid].update(values)
+
+    def pending_hits(self) -> int:
+        """
+        Number of hits held in memory (including the C tracer's buffers).
+        """
+        pending = self.trace_data.hit_count()
+        if self.c_tracer:
+            pending += self.c_tracer.pending()
+        return pending
+
+    def stats(self) -> Dict[str, Any]:
+        """
+        Self-metrics of this engine: the tracer's event counters, seconds spent per
+        phase and the hits held in memory.
+        """
+        if self.c_tracer:
+            tracer = self.c_tracer.stats()
+        else:
+            tracer = self._python_tracer.stats()
+        return {
+            'tracer': tracer,
+            'timings': dict(self.timings),
+            'pending_hits': self.pending_hits(),
+        }
+
+    @contextlib.contextmanager
+    def _timed(self, phase: str) -> Iterator[None]:
+        start = time.perf_counter()
+        try:
+            yield
+        finally:
+            self.timings[phase] += time.perf_counter() - start
+
+    def _timed_iter(self, phase: str, items: Iterator[Any]) -> Iterator[Any]:
+        # times producing each item, not the consumer's work between items
+        while True:
+            start = time.perf_counter()
+            try:
+                item = next(items)
+            except StopIteration:
+                return
+            finally:
+                self.timings[phase] += time.perf_counter() - start
+            yield item
 
-    def combine_data(self) -> None:
+    def combine_data(self, jobs: Optional[int] = None, files: Optional[Callable[[str], bool]] = None,
+                     keep_contexts: bool = False) -> None:
         """
         Merge all partial coverage database files into the main database.
+
+        Args:
+            jobs (int): Processes for the tree combine; defaults to config.combine_jobs.
+            files (callable): Loads only the merged data of the canonical paths it accepts.
+            keep_contexts (bool): Load the merged data per context instead of into the default one.
         """
         # ensure current data is saved so it's included in the merge
         self.save_data()
 
         # delegate merge logic to storage, passing the path mapping function
-        self.storage.combine(self.path_manager.map_path)
+        # (not needed without [paths], load_into canonicalizes anyway)
+        map_path = self.path_manager.map_path if self.config.paths else None
+        with self._timed('combine'):
+            self.storage.combine(map_path, self.config.combine_jobs if jobs is None else jobs)
 
         # load merged data back into memory for analysis/reporting
-        self.storage.load_into(self.trace_data, self.path_manager)
+        self.combined_counts = TraceContainer()
+        with self._timed('load'):
+            self.storage.load_into(self.trace_data, self.path_manager, files,
+                                   self._context_id_for if keep_contexts else None, self.combined_counts)
+
+    def _context_id_for(self, context_label: str) -> int:
+        with self._context_lock:
+            return self._assign_context_id(context_label)
+
+    def contexts_for(self, filename: str, ranges: Optional[List[Tuple[int, int]]] = None) -> Set[str]:
+        """
+        Contexts (e.g. pytest node IDs) of the combined data that executed any line of
+        filename within ranges (inclusive (start, end) pairs, None for the whole file).
+        Answered from the data file's indexes; nothing is loaded into memory.
+        """
+        return self.storage.contexts_for_lines(self.path_manager.map_path(filename), ranges)
 
     def _patch_multiprocessing(self) -> None:
         """
@@ -180,7 +489,15 @@ class MiniCoverage:
         Start coverage tracing.
         Uses sys.monitoring for Python 3.12+, otherwise falls back to sys.settrace.
         """
+        global _active_engine
         self._patch_multiprocessing()
+        _active_engine = self
+
+        self.count_hits = self.config.collection_mode == 'count'
+        if self.c_tracer:
+            self.c_tracer.sample_rate = self.sample_rate()
+            self.c_tracer.count_hits = self.count_hits
+        self._start_arena()
 
         success = False
         if sys.version_info >= (3, 12):
@@ -189,19 +506,221 @@ class MiniCoverage:
         # fallback to sys.settrace if monitoring failed or is unavailable
         if not success:
             self.sys_settrace_tracer.start()
+        self._python_tracer = self.sys_monitoring_tracer if success else self.sys_settrace_tracer
+
+        if self.config.collection_mode == 'sampled':
+            if success or self.c_tracer:
+                # lets reporters mark the data as sampled
+                self.storage.sample_rate = self.sample_rate()
+            else:
+                self.logger.warning("Sampling needs sys.monitoring or the C extension, tracing everything")
+
+        self._start_greenlet_tracking()
+
+        if self.flusher:
+            self.flusher.start()
 
-    def stop(self) -> None:
+    def concurrency(self) -> Set[str]:
+        """
+        The concurrency libraries named by the config, e.g. 'thread,gevent'.
+        """
+        modes = {mode for mode in re.split(r'[,\s]+', self.config.concurrency) if mode}
+        unknown = modes - CONCURRENCY_MODES
+        if unknown:
+            self.logger.warning(f"Unknown concurrency {', '.join(sorted(unknown))}, "
+                                f"expected any of {', '.join(sorted(CONCURRENCY_MODES))}")
+        return modes & CONCURRENCY_MODES
+
+    def _start_greenlet_tracking(self) -> None:
+        """
+        Keep a separate arc history per greenlet, switched by a greenlet.settrace()
+        callback chained in front of any callback already installed on this thread.
+        """
+        if self._greenlet_trace is not None or not self.concurrency() & GREENLET_CONCURRENCY:
+            return
+        try:
+            import greenlet
+        except ImportError:
+            self.logger.warning("concurrency needs the greenlet package, arcs may be wrong across switches")
+            return
+
+        switch = self.c_tracer._greenlet_switch if self.c_tracer else self._switch_greenlet
+        previous = greenlet.gettrace()
+        if previous is None:
+            callback = switch
+        else:
+            def callback(event: str, args: Any) -> Any:
+                switch(event, args)
+                return previous(event, args)
+        greenlet.settrace(callback)
+        self._greenlet_trace = (greenlet, previous)
+
+    def _stop_greenlet_tracking(self) -> None:
+        if self._greenlet_trace is not None:
+            greenlet, previous = self._greenlet_trace
+            greenlet.settrace(previous)
+            self._greenlet_trace = None
+
+    def stop(self, save: bool = True) -> None:
         """
         Stop coverage tracing and save data to disk.
+
+        Args:
+            save (bool): False leaves the data in memory, e.g. for export_delta().
         """
+        global _active_engine
+        if _active_engine is self:
+            _active_engine = None
+
         if sys.version_info >= (3, 12):
             self.sys_monitoring_tracer.stop()
 
         self.sys_settrace_tracer.stop()
-        self.save_data()
+        self._stop_greenlet_tracking()
+        if self.flusher:
+            self.flusher.stop()
+        self._stop_arena()
+        if save:
+            self.save_data()
+
+    def _start_arena(self) -> None:
+        """
+        Record into the run's shared arena (shared_arena = true): the one named by
+        MINICOV_ARENA, e.g. created by the process that started this one, or else a
+        new one that this process saves and its children attach to.
+        """
+        if not self.config.shared_arena or self.arena is not None:
+            return
+        if not self.c_tracer:
+            self.logger.warning("shared_arena needs the C extension, saving a partial file per process")
+            return
+        if self.count_hits:
+            self.logger.warning("shared_arena keeps no hit counts, saving a partial file per process")
+            return
+
+        path = os.environ.get(ARENA_ENV)
+        arena = SharedArena.open(path) if path else None
+        owner = arena is None
+        if owner:
+            path = os.path.abspath(f"{self.config.data_file}-arena.{os.getpid()}")
+            arena = SharedArena.create(path, self._arena_files())
+        try:
+            self.c_tracer.attach_arena(arena.buffer)
+        except NotImplementedError as e:
+            self.logger.warning(f"shared_arena unavailable ({e}), saving a partial file per process")
+            arena.close(unlink=owner)
+            return
+
+        if owner:
+            os.environ[ARENA_ENV] = path
+        self.arena = arena
+        self._arena_owner = owner
+
+    def _arena_files(self) -> Dict[str, int]:
+        """
+        Line count of every traceable .py file under the project root, which sizes its
+        arena region. Files created later are recorded privately.
+        """
+        files: Dict[str, int] = {}
+        for dirpath, dirnames, filenames in os.walk(self.project_root):
+            dirnames[:] = [d for d in dirnames if not d.startswith('.') and d != '__pycache__']
+            for name in filenames:
+                if not name.endswith('.py'):
+                    continue
+                path = os.path.join(dirpath, name)
+                if not self.path_manager.should_trace(path, self.excluded_files):
+                    continue
+                try:
+                    with open(path, 'rb') as f:
+                        files[self.path_manager.canonicalize(path)] = f.read().count(b'\n') + 1
+                except OSError:
+                    continue
+        return files
+
+    def _arena_region(self, filename: str) -> Optional[Tuple[int, int, int, int]]:
+        """
+        Called by the C tracer once per file: where filename's hits go in the arena.
+        """
+        if self.arena is None:
+            return None
+        return self.arena.regions.get(self.path_manager.canonicalize(filename))
+
+    def _take_arena(self) -> None:
+        """
+        Move the arena's hits not taken yet into trace_data, in the process that saves
+        them: the creator, or any process still attached once the creator stopped.
+        """
+        if self.arena is None or not (self._arena_owner or self.arena.stopped):
+            return
+        lines = self.trace_data['lines']
+        arcs = self.trace_data['arcs']
+        instruction_arcs = self.trace_data['instruction_arcs']
+        for path, (new_lines, new_arcs, new_instruction_arcs) in self.arena.take_new().items():
+            if new_lines:
+                lines[path][0].update(new_lines)
+            if new_arcs:
+                arcs[path][0].update(new_arcs)
+            if new_instruction_arcs:
+                instruction_arcs[path][0].update(new_instruction_arcs)
+
+    def _stop_arena(self) -> None:
+        if self.arena is None:
+            return
+        self.c_tracer.detach_arena()
+        if self._arena_owner:
+            self.arena.mark_stopped()
+            if os.environ.get(ARENA_ENV) == self.arena.path:
+                del os.environ[ARENA_ENV]
+        self._take_arena()
+        self.arena.close(unlink=self._arena_owner)
+        self.arena = None
+        self._arena_owner = False
+
+    def _enter_frame(self, filename: Optional[str] = None, resume_line: Optional[int] = None) -> None:
+        """
+        A frame starts: keep the caller's arc history and start an empty one or, for a
+        resumed generator or coroutine, one ending on the line it was suspended on.
+        """
+        local = self.thread_local
+        callers = getattr(local, 'callers', None)
+        if callers is None:
+            callers = local.callers = []
+        callers.append((getattr(local, 'last_file', None), getattr(local, 'last_line', None),
+                        getattr(local, 'last_lasti', None)))
+        local.last_file = filename if resume_line is not None else None
+        local.last_line = resume_line
+        local.last_lasti = None
+
+    def _exit_frame(self) -> None:
+        """
+        The current frame returned, yielded or unwound: continue its caller's arc history.
+        """
+        local = self.thread_local
+        callers = getattr(local, 'callers', None)
+        if callers:
+            local.last_file, local.last_line, local.last_lasti = callers.pop()
+        else:
+            # the frame started before tracing did
+            local.last_file = local.last_line = local.last_lasti = None
+
+    def _switch_greenlet(self, event: str, args: Tuple[Any, Any]) -> None:
+        """
+        greenlet.settrace() callback of the Python tracers: park the arc history of the
+        greenlet switched away from, unless it finished, and bring back the target's.
+        """
+        origin, target = args
+        local = self.thread_local
+        if not origin.dead:
+            self._greenlet_histories[id(origin)] = (
+                getattr(local, 'last_file', None), getattr(local, 'last_line', None),
+                getattr(local, 'last_lasti', None), getattr(local, 'callers', None) or [])
+        local.last_file, local.last_line, local.last_lasti, local.callers = \
+            self._greenlet_histories.pop(id(target), (None, None, None, []))
 
     def _record_line(self, filename: str, lineno: int, cid: int) -> None:
         self.trace_data.add_line(filename, cid, lineno)
+        if self.count_hits:
+            self.trace_data.count_line(filename, cid, lineno)
 
         if not hasattr(self.thread_local, 'last_line'):
             self.thread_local.last_line = None
@@ -212,6 +731,8 @@ class MiniCoverage:
 
         if last_file == filename and last_line is not None:
             self.trace_data.add_arc(filename, cid, last_line, lineno)
+            if self.count_hits:
+                self.trace_data.count_arc(filename, cid, last_line, lineno)
 
         self.thread_local.last_line = lineno
         self.thread_local.last_file = filename
@@ -293,15 +814,48 @@ class MiniCoverage:
             sys.path = original_path
             sys.modules['__main__'] = old_main
 
-    def report(self, reporters: Optional[List[str]] = None) -> None:
+    def report(self, reporters: Optional[List[str]] = None, include: Optional[List[str]] = None) -> None:
         """
         Combine data from parallel runs and generate reports using all registered reporters.
-        """
-        self.combine_data()
-        results = self.analyze()
 
+        Args:
+            reporters (list): Names of the reporters to use instead of the configured ones.
+            include (list): fnmatch patterns (relative to the project root) of the files to
+                report; data of other files is not loaded from the data file.
+        """
+        files = self.path_manager.file_filter(include or ())
+        self.combine_data(files=files)
+        # this process's own hits are in memory for every file, not just the loaded ones;
+        # its counts were saved by combine_data() and are part of the combined ones
+        trace_data = self.trace_data.view(files, counts=self.combined_counts)
         if reporters:
-            manager = ReportManager(reporters)
-            manager.generate(results, self.project_root)
+            manager = ReportManager(reporters, self.parser.read_source, self.config.report_jobs)
         else:
-            self.report_manager.generate(results, self.project_root)
+            manager = self.report_manager
+
+        # combined data of sampled runs is reported as such
+        sample_rate = self.storage.data_sample_rate()
+
+        if self.config.stream_reports:
+            # each file is reported as soon as it is analyzed, results are not kept
+            report_cache = self.analyzer.report_cache(self.project_root)
+            file_results = self._timed_iter('analyze', self.analyzer.iter_analyze(trace_data))
+            try:
+                manager.generate_streaming(file_results, self.project_root, report_cache, sample_rate)
+            finally:
+                self._take_report_timings(manager)
+            return
+
+        with self._timed('analyze'):
+            results = self.analyzer.analyze(trace_data)
+        # files whose source and trace data are unchanged reuse their previous output
+        report_cache = self.analyzer.report_cache(self.project_root)
+        try:
+            manager.generate(results, self.project_root, report_cache, sample_rate)
+        finally:
+            self._take_report_timings(manager)
+
+    def _take_report_timings(self, manager: ReportManager) -> None:
+        for name, seconds in manager.timings.items():
+            self.timings[f"report.{name}"] += seconds
+        manager.timings.clear()
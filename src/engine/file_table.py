@@ -0,0 +1,29 @@
+from typing import Dict, List
+
+
+class FileTable:
+    """
+    Interns file paths as small integer IDs.
+
+    One table is shared by the C tracer, which appends to ``index``/``paths`` natively
+    as it meets new files, and by CoverageStorage, which writes the IDs to disk so that
+    rows never repeat the path strings.
+    """
+    def __init__(self) -> None:
+        self.index: Dict[str, int] = {}
+        self.paths: List[str] = []
+
+    def id_for(self, path: str) -> int:
+        """Return the ID of path, assigning the next free one on first sight."""
+        file_id = self.index.get(path)
+        if file_id is None:
+            file_id = len(self.paths)
+            self.index[path] = file_id
+            self.paths.append(path)
+        return file_id
+
+    def path_of(self, file_id: int) -> str:
+        return self.paths[file_id]
+
+    def __len__(self) -> int:
+        return len(self.paths)
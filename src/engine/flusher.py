@@ -0,0 +1,61 @@
+"""
+Background flushing of trace data for long-running processes.
+
+Without it, everything recorded stays in memory until MiniCoverage.stop(). The
+flusher periodically moves the recorded hits into the process's partial data file,
+so memory stays flat and a killed process loses at most one interval.
+"""
+import logging
+import sys
+import threading
+import time
+
+
+class BackgroundFlusher:
+    """
+    Daemon thread calling engine.flush_data() every `interval` seconds, or as soon as
+    engine.pending_hits() reaches `max_hits`. Either trigger may be 0 (disabled).
+    """
+
+    def __init__(self, engine, interval: float, max_hits: int, poll: float = 1.0) -> None:
+        self.logger = logging.getLogger(__name__)
+        self.engine = engine
+        self.interval = interval
+        self.max_hits = max_hits
+        # the size trigger is checked at this rate; never slower than the interval
+        self.poll = min(poll, interval) if interval > 0 else poll
+        self._stop_event = threading.Event()
+        self._thread = None
+
+    def start(self) -> None:
+        if self._thread is not None:
+            return
+        self._stop_event.clear()
+        self._thread = threading.Thread(target=self._run, name="minicov-flusher", daemon=True)
+        self._thread.start()
+
+    def stop(self) -> None:
+        if self._thread is None:
+            return
+        self._stop_event.set()
+        self._thread.join()
+        self._thread = None
+
+    def _is_due(self, last_flush: float) -> bool:
+        if self.interval > 0 and time.monotonic() - last_flush >= self.interval:
+            return True
+        return self.max_hits > 0 and self.engine.pending_hits() >= self.max_hits
+
+    def _run(self) -> None:
+        # the flusher's own frames are never interesting to trace
+        sys.settrace(None)
+
+        last_flush = time.monotonic()
+        while not self._stop_event.wait(self.poll):
+            if not self._is_due(last_flush):
+                continue
+            try:
+                self.engine.flush_data()
+            except Exception as e:
+                self.logger.warning(f"Background flush failed: {e}")
+            last_flush = time.monotonic()
@@ -1,34 +1,70 @@
 import os
+import re
 import fnmatch
-from typing import Set
+from typing import Callable, Dict, FrozenSet, Iterable, Optional, Pattern, Set
 from .config import CoverageConfig
 
 
+def _canonicalize(path: str) -> str:
+    # Use realpath to resolve symlinks (crucial for deduplication)
+    # Fallback to abspath if file doesn't exist
+    if os.path.exists(path):
+        return os.path.normcase(os.path.realpath(path))
+
+    # If file doesn't exist, try to resolve the directory part
+    # This ensures that if project_root is realpath'ed, files inside it are too.
+    head, tail = os.path.split(os.path.abspath(path))
+    if os.path.exists(head):
+        return os.path.normcase(os.path.join(os.path.realpath(head), tail))
+
+    return os.path.normcase(os.path.abspath(path))
+
+
+def compile_patterns(patterns: FrozenSet[str]) -> Optional[Pattern[str]]:
+    """
+    Combine fnmatch patterns into one regex matching what any of them matches,
+    or None when there are no patterns.
+    """
+    if not patterns:
+        return None
+    # sorted so equal pattern sets always give the same regex
+    return re.compile("|".join(fnmatch.translate(os.path.normcase(p)) for p in sorted(patterns)))
+
+
 class PathManager:
     """
     Centralizes path normalization, canonicalization, and filtering logic.
     """
     def __init__(self, project_root: str, config: CoverageConfig):
+        # path -> canonical path, shared by tracing, combine, loading and analysis
+        self._canonical: Dict[str, str] = {}
+        # omit patterns the current regex was compiled from
+        self._omit_patterns: FrozenSet[str] = frozenset()
+        self._omit_regex: Optional[Pattern[str]] = None
+
         self.project_root = self.canonicalize(project_root)
+        # files below the root start with this
+        self._root_prefix = self.project_root if self.project_root.endswith(os.sep) else self.project_root + os.sep
         self.config = config
 
-    @staticmethod
-    def canonicalize(path: str) -> str:
+    def canonicalize(self, path: str) -> str:
         """
         Convert a path to its canonical form: absolute, symlinks resolved, case-normalized.
+        The filesystem is consulted once per path and engine.
         """
-        # Use realpath to resolve symlinks (crucial for deduplication)
-        # Fallback to abspath if file doesn't exist
-        if os.path.exists(path):
-            return os.path.normcase(os.path.realpath(path))
+        canonical = self._canonical.get(path)
+        if canonical is None:
+            canonical = self._canonical[path] = _canonicalize(path)
+        return canonical
 
-        # If file doesn't exist, try to resolve the directory part
-        # This ensures that if project_root is realpath'ed, files inside it are too.
-        head, tail = os.path.split(os.path.abspath(path))
-        if os.path.exists(head):
-            return os.path.normcase(os.path.join(os.path.realpath(head), tail))
+    def canonical_paths(self) -> Dict[str, str]:
+        return dict(self._canonical)
 
-        return os.path.normcase(os.path.abspath(path))
+    def seed(self, canonical_paths: Dict[str, str]) -> None:
+        """
+        Take over canonicalizations made by another engine, e.g. a parent process.
+        """
+        self._canonical.update(canonical_paths)
 
     def map_path(self, path: str) -> str:
         """
@@ -45,25 +81,53 @@ class PathManager:
                     return path.replace(norm_alias, canonical, 1)
         return path
 
+    def _omit(self) -> Optional[Pattern[str]]:
+        omit_patterns = self.config.get('omit', []) if isinstance(self.config, dict) else self.config.omit
+        # the config may be changed after the engine is created, recompile when it is
+        patterns = frozenset(omit_patterns)
+        if patterns != self._omit_patterns:
+            self._omit_patterns = patterns
+            self._omit_regex = compile_patterns(patterns)
+        return self._omit_regex
+
+    def file_filter(self, patterns: Iterable[str]) -> Optional[Callable[[str], bool]]:
+        """
+        Predicate selecting files whose path relative to the project root matches any
+        of the fnmatch patterns, or None when there are no patterns.
+        """
+        regex = compile_patterns(frozenset(patterns))
+        if regex is None:
+            return None
+
+        def matches(filename: str) -> bool:
+            abs_path = self.canonicalize(filename)
+            if not abs_path.startswith(self._root_prefix):
+                return False
+            return regex.match(self._relative(abs_path)) is not None
+        return matches
+
+    def _relative(self, abs_path: str) -> str:
+        # normalized to forward slashes for consistent pattern matching
+        rel_path = abs_path[len(self._root_prefix):].replace(os.sep, '/')
+        return os.path.normcase(rel_path)
+
     def should_trace(self, filename: str, excluded_files: Set[str]) -> bool:
         """
         Determine if a file should be tracked based on project root and exclusions.
         """
+        # code without a source file (frozen modules, exec() of a string) would otherwise
+        # be resolved against the working directory, often the project root itself
+        if filename.startswith('<'):
+            return False
         abs_path = self.canonicalize(filename)
 
-        if not abs_path.startswith(self.project_root):
+        if not abs_path.startswith(self._root_prefix):
             return False
         if abs_path in excluded_files:
             return False
 
-        rel_path = os.path.relpath(abs_path, self.project_root)
-        # normalize to forward slashes for consistent pattern matching
-        rel_path = rel_path.replace(os.sep, '/')
-
-        omit_patterns = self.config.get('omit', []) if isinstance(self.config, dict) else self.config.omit
-
-        for pattern in omit_patterns:
-            if fnmatch.fnmatch(rel_path, pattern):
-                return False
+        omit = self._omit()
+        if omit is None:
+            return True
 
-        return True
+        return omit.match(self._relative(abs_path)) is None
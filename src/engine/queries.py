@@ -2,6 +2,10 @@
 SQL queries used by the coverage engine.
 """
 
+# schema version stored in PRAGMA user_version; 0 is the original path-per-row layout,
+# 3 added the bitmap tables next to the row tables, 4 the hit count tables
+SCHEMA_VERSION = 4
+
 INIT_CONTEXTS = """
     CREATE TABLE IF NOT EXISTS contexts (
         id INTEGER PRIMARY KEY,
@@ -11,71 +15,308 @@ INIT_CONTEXTS = """
 
 INIT_DEFAULT_CONTEXT = "INSERT OR IGNORE INTO contexts (id, label) VALUES (0, 'default')"
 
+INIT_FILES = """
+    CREATE TABLE IF NOT EXISTS {schema}.files (
+        id INTEGER PRIMARY KEY,
+        path TEXT UNIQUE
+    )
+"""
+
 INIT_LINES = """
-    CREATE TABLE IF NOT EXISTS lines (
-        file_path TEXT,
+    CREATE TABLE IF NOT EXISTS {schema}.lines (
+        file_id INTEGER,
         context_id INTEGER,
         line_no INTEGER,
-        PRIMARY KEY (file_path, context_id, line_no),
+        PRIMARY KEY (file_id, context_id, line_no),
+        FOREIGN KEY(file_id) REFERENCES files(id),
         FOREIGN KEY(context_id) REFERENCES contexts(id)
     )
 """
 
 INIT_ARCS = """
-    CREATE TABLE IF NOT EXISTS arcs (
-        file_path TEXT,
+    CREATE TABLE IF NOT EXISTS {schema}.arcs (
+        file_id INTEGER,
         context_id INTEGER,
         start_line INTEGER,
         end_line INTEGER,
-        PRIMARY KEY (file_path, context_id, start_line, end_line),
+        PRIMARY KEY (file_id, context_id, start_line, end_line),
+        FOREIGN KEY(file_id) REFERENCES files(id),
         FOREIGN KEY(context_id) REFERENCES contexts(id)
     )
 """
 
 INIT_INSTRUCTION_ARCS = """
-    CREATE TABLE IF NOT EXISTS instruction_arcs (
-        file_path TEXT,
+    CREATE TABLE IF NOT EXISTS {schema}.instruction_arcs (
+        file_id INTEGER,
         context_id INTEGER,
         from_offset INTEGER,
         to_offset INTEGER,
-        PRIMARY KEY (file_path, context_id, from_offset, to_offset),
+        PRIMARY KEY (file_id, context_id, from_offset, to_offset),
+        FOREIGN KEY(file_id) REFERENCES files(id),
+        FOREIGN KEY(context_id) REFERENCES contexts(id)
+    )
+"""
+
+# bitmap storage format: one blob per (file, context) instead of one row per hit
+INIT_LINE_BITMAPS = """
+    CREATE TABLE IF NOT EXISTS {schema}.line_bitmaps (
+        file_id INTEGER,
+        context_id INTEGER,
+        bitmap BLOB,
+        PRIMARY KEY (file_id, context_id),
+        FOREIGN KEY(file_id) REFERENCES files(id),
+        FOREIGN KEY(context_id) REFERENCES contexts(id)
+    )
+"""
+
+# kind 0 holds line arcs, kind 1 instruction arcs
+INIT_ARC_BLOBS = """
+    CREATE TABLE IF NOT EXISTS {schema}.arc_blobs (
+        kind INTEGER,
+        file_id INTEGER,
+        context_id INTEGER,
+        pairs BLOB,
+        PRIMARY KEY (kind, file_id, context_id),
+        FOREIGN KEY(file_id) REFERENCES files(id),
+        FOREIGN KEY(context_id) REFERENCES contexts(id)
+    )
+"""
+
+# execution counts of count mode runs, in either storage format; summed when merged.
+# WITHOUT ROWID keeps each table a single b-tree of packed integer rows
+INIT_LINE_COUNTS = """
+    CREATE TABLE IF NOT EXISTS {schema}.line_counts (
+        file_id INTEGER,
+        context_id INTEGER,
+        line_no INTEGER,
+        hits INTEGER,
+        PRIMARY KEY (file_id, context_id, line_no),
+        FOREIGN KEY(file_id) REFERENCES files(id),
+        FOREIGN KEY(context_id) REFERENCES contexts(id)
+    ) WITHOUT ROWID
+"""
+
+INIT_ARC_COUNTS = """
+    CREATE TABLE IF NOT EXISTS {schema}.arc_counts (
+        file_id INTEGER,
+        context_id INTEGER,
+        start_line INTEGER,
+        end_line INTEGER,
+        hits INTEGER,
+        PRIMARY KEY (file_id, context_id, start_line, end_line),
+        FOREIGN KEY(file_id) REFERENCES files(id),
         FOREIGN KEY(context_id) REFERENCES contexts(id)
+    ) WITHOUT ROWID
+"""
+
+# facts about how the data was collected; merged keeping the smallest value per key,
+# e.g. sample_rate (fraction of code objects recorded by a sampled run)
+INIT_META = """
+    CREATE TABLE IF NOT EXISTS {schema}.meta (
+        key TEXT PRIMARY KEY,
+        value REAL
     )
 """
+META_SAMPLE_RATE = 'sample_rate'
+INSERT_META = """
+    INSERT INTO meta (key, value) VALUES (?, ?)
+    ON CONFLICT(key) DO UPDATE SET value = MIN(value, excluded.value)
+"""
+MERGE_META = """
+    INSERT INTO meta (key, value) SELECT key, value FROM {alias}.meta WHERE true
+    ON CONFLICT(key) DO UPDATE SET value = MIN(value, excluded.value)
+"""
+SELECT_META = "SELECT value FROM meta WHERE key = ?"
+
+ARC_KIND_LINES = 0
+ARC_KIND_INSTRUCTIONS = 1
 
 INSERT_CONTEXT = "INSERT OR IGNORE INTO contexts (id, label) VALUES (?, ?)"
-INSERT_LINE = "INSERT OR IGNORE INTO lines (file_path, context_id, line_no) VALUES (?, ?, ?)"
-INSERT_ARC = "INSERT OR IGNORE INTO arcs (file_path, context_id, start_line, end_line) VALUES (?, ?, ?, ?)"
-INSERT_INSTRUCTION_ARC = "INSERT OR IGNORE INTO instruction_arcs (file_path, context_id, from_offset, to_offset) VALUES (?, ?, ?, ?)"
+INSERT_FILE = "INSERT OR IGNORE INTO files (id, path) VALUES (?, ?)"
+INSERT_LINE = "INSERT OR IGNORE INTO lines (file_id, context_id, line_no) VALUES (?, ?, ?)"
+INSERT_ARC = "INSERT OR IGNORE INTO arcs (file_id, context_id, start_line, end_line) VALUES (?, ?, ?, ?)"
+INSERT_INSTRUCTION_ARC = "INSERT OR IGNORE INTO instruction_arcs (file_id, context_id, from_offset, to_offset) VALUES (?, ?, ?, ?)"
+
+# flushes append to the same partial, so counts already there are added to; the
+# conflict targets are named because SQLite before 3.35 requires them
+INSERT_LINE_COUNT = """
+    INSERT INTO line_counts (file_id, context_id, line_no, hits) VALUES (?, ?, ?, ?)
+    ON CONFLICT(file_id, context_id, line_no) DO UPDATE SET hits = hits + excluded.hits
+"""
+INSERT_ARC_COUNT = """
+    INSERT INTO arc_counts (file_id, context_id, start_line, end_line, hits) VALUES (?, ?, ?, ?, ?)
+    ON CONFLICT(file_id, context_id, start_line, end_line) DO UPDATE SET hits = hits + excluded.hits
+"""
+
+INSERT_LINE_BITMAP = "INSERT OR REPLACE INTO line_bitmaps (file_id, context_id, bitmap) VALUES (?, ?, ?)"
+INSERT_ARC_BLOB = "INSERT OR REPLACE INTO arc_blobs (kind, file_id, context_id, pairs) VALUES (?, ?, ?, ?)"
+
+# upgrade of a version 0 database (file_path TEXT in every row), run per schema
+LEGACY_TABLE_INFO = "PRAGMA {schema}.table_info(lines)"
+LEGACY_RENAME = "ALTER TABLE {schema}.{table} RENAME TO legacy_{table}"
+LEGACY_COPY_FILES = """
+    INSERT OR IGNORE INTO {schema}.files (path)
+    SELECT file_path FROM {schema}.legacy_lines
+    UNION SELECT file_path FROM {schema}.legacy_arcs
+    UNION SELECT file_path FROM {schema}.legacy_instruction_arcs
+"""
+LEGACY_COPY_ROWS = """
+    INSERT OR IGNORE INTO {schema}.{table} ({columns})
+    SELECT f.id, {legacy_columns}
+    FROM {schema}.legacy_{table} t
+    JOIN {schema}.files f ON f.path = t.file_path
+"""
+LEGACY_DROP = "DROP TABLE {schema}.legacy_{table}"
+
+LEGACY_TABLES = {
+    'lines': ('context_id', 'line_no'),
+    'arcs': ('context_id', 'start_line', 'end_line'),
+    'instruction_arcs': ('context_id', 'from_offset', 'to_offset'),
+}
 
 # dynamic queries (format strings)
 MERGE_CONTEXTS = "INSERT OR IGNORE INTO contexts (label) SELECT label FROM {alias}.contexts"
 
-# updated to use remap_path function
+MERGE_SELECT_FILES = "SELECT id, path FROM {alias}.files"
+INSERT_MERGED_FILE = "INSERT OR IGNORE INTO files (path) VALUES (?)"
+SELECT_FILE_ID = "SELECT id FROM files WHERE path = ?"
+
+# used instead of the per-file remap when [paths] is empty
+MERGE_FILES = "INSERT OR IGNORE INTO files (path) SELECT path FROM {alias}.files"
+MERGE_FILE_MAP = """
+    INSERT INTO temp.file_map (partial_id, main_id)
+    SELECT p.id, m.id FROM {alias}.files p JOIN files m ON p.path = m.path
+"""
+
+# partial file id -> main file id, filled once per partial file after remapping its paths
+INIT_FILE_MAP = "CREATE TEMP TABLE IF NOT EXISTS file_map (partial_id INTEGER PRIMARY KEY, main_id INTEGER)"
+CLEAR_FILE_MAP = "DELETE FROM temp.file_map"
+INSERT_FILE_MAP = "INSERT INTO temp.file_map (partial_id, main_id) VALUES (?, ?)"
+
 MERGE_LINES = """
-    INSERT OR IGNORE INTO lines (file_path, context_id, line_no)
-    SELECT remap_path(l.file_path), main_c.id, l.line_no
+    INSERT OR IGNORE INTO lines (file_id, context_id, line_no)
+    SELECT fm.main_id, main_c.id, l.line_no
     FROM {alias}.lines l
+    JOIN temp.file_map fm ON l.file_id = fm.partial_id
     JOIN {alias}.contexts partial_c ON l.context_id = partial_c.id
     JOIN contexts main_c ON partial_c.label = main_c.label
 """
 
 MERGE_ARCS = """
-    INSERT OR IGNORE INTO arcs (file_path, context_id, start_line, end_line)
-    SELECT remap_path(a.file_path), main_c.id, a.start_line, a.end_line
+    INSERT OR IGNORE INTO arcs (file_id, context_id, start_line, end_line)
+    SELECT fm.main_id, main_c.id, a.start_line, a.end_line
     FROM {alias}.arcs a
+    JOIN temp.file_map fm ON a.file_id = fm.partial_id
     JOIN {alias}.contexts partial_c ON a.context_id = partial_c.id
     JOIN contexts main_c ON partial_c.label = main_c.label
 """
 
 MERGE_INSTRUCTION_ARCS = """
-    INSERT OR IGNORE INTO instruction_arcs (file_path, context_id, from_offset, to_offset)
-    SELECT remap_path(a.file_path), main_c.id, a.from_offset, a.to_offset
+    INSERT OR IGNORE INTO instruction_arcs (file_id, context_id, from_offset, to_offset)
+    SELECT fm.main_id, main_c.id, a.from_offset, a.to_offset
     FROM {alias}.instruction_arcs a
+    JOIN temp.file_map fm ON a.file_id = fm.partial_id
+    JOIN {alias}.contexts partial_c ON a.context_id = partial_c.id
+    JOIN contexts main_c ON partial_c.label = main_c.label
+"""
+
+# the WHERE clause lets SQLite parse ON CONFLICT after a SELECT with joins
+MERGE_LINE_COUNTS = """
+    INSERT INTO line_counts (file_id, context_id, line_no, hits)
+    SELECT fm.main_id, main_c.id, l.line_no, l.hits
+    FROM {alias}.line_counts l
+    JOIN temp.file_map fm ON l.file_id = fm.partial_id
+    JOIN {alias}.contexts partial_c ON l.context_id = partial_c.id
+    JOIN contexts main_c ON partial_c.label = main_c.label
+    WHERE true
+    ON CONFLICT(file_id, context_id, line_no) DO UPDATE SET hits = hits + excluded.hits
+"""
+
+MERGE_ARC_COUNTS = """
+    INSERT INTO arc_counts (file_id, context_id, start_line, end_line, hits)
+    SELECT fm.main_id, main_c.id, a.start_line, a.end_line, a.hits
+    FROM {alias}.arc_counts a
+    JOIN temp.file_map fm ON a.file_id = fm.partial_id
     JOIN {alias}.contexts partial_c ON a.context_id = partial_c.id
     JOIN contexts main_c ON partial_c.label = main_c.label
+    WHERE true
+    ON CONFLICT(file_id, context_id, start_line, end_line) DO UPDATE SET hits = hits + excluded.hits
 """
 
-SELECT_LINES = "SELECT file_path, line_no FROM lines"
-SELECT_ARCS = "SELECT file_path, start_line, end_line FROM arcs"
-SELECT_INSTRUCTION_ARCS = "SELECT file_path, from_offset, to_offset FROM instruction_arcs"
+# partial blobs with file and context IDs translated to the main database
+MERGE_SELECT_LINE_BITMAPS = """
+    SELECT fm.main_id, main_c.id, b.bitmap
+    FROM {alias}.line_bitmaps b
+    JOIN temp.file_map fm ON b.file_id = fm.partial_id
+    JOIN {alias}.contexts partial_c ON b.context_id = partial_c.id
+    JOIN contexts main_c ON partial_c.label = main_c.label
+"""
+
+MERGE_SELECT_ARC_BLOBS = """
+    SELECT b.kind, fm.main_id, main_c.id, b.pairs
+    FROM {alias}.arc_blobs b
+    JOIN temp.file_map fm ON b.file_id = fm.partial_id
+    JOIN {alias}.contexts partial_c ON b.context_id = partial_c.id
+    JOIN contexts main_c ON partial_c.label = main_c.label
+"""
+
+SELECT_LINE_BITMAP = "SELECT bitmap FROM line_bitmaps WHERE file_id = ? AND context_id = ?"
+SELECT_ARC_BLOB = "SELECT pairs FROM arc_blobs WHERE kind = ? AND file_id = ? AND context_id = ?"
+
+SELECT_FILES = "SELECT id, path FROM files"
+SELECT_CONTEXTS = "SELECT id, label FROM contexts"
+
+# loading: (file_id, context_id, value) rows of every file, or of one file (WHERE file_id = ?);
+# the per-file form is served by the primary keys, which all lead with file_id
+SELECT_LINES = "SELECT file_id, context_id, line_no FROM lines"
+SELECT_ARCS = "SELECT file_id, context_id, start_line, end_line FROM arcs"
+SELECT_INSTRUCTION_ARCS = "SELECT file_id, context_id, from_offset, to_offset FROM instruction_arcs"
+SELECT_LINE_BITMAPS = "SELECT file_id, context_id, bitmap FROM line_bitmaps"
+SELECT_LINE_COUNTS = "SELECT file_id, context_id, line_no, hits FROM line_counts"
+SELECT_ARC_COUNTS = "SELECT file_id, context_id, start_line, end_line, hits FROM arc_counts"
+SELECT_ARC_BLOBS = "SELECT file_id, context_id, pairs FROM arc_blobs WHERE kind = {kind}"
+FILE_FILTER = " WHERE file_id = ?"
+ARC_BLOB_FILE_FILTER = " AND file_id = ?"
+
+# test-impact lookups (which contexts ran some lines of a file) without scanning the tables;
+# the primary key of lines is (file_id, context_id, line_no), so for a range of line_no
+# it finds the file's rows but has to read those of every context
+INIT_LINES_BY_LINE = "CREATE INDEX IF NOT EXISTS lines_by_line ON lines (file_id, line_no)"
+SELECT_CONTEXTS_FOR_FILE = """
+    SELECT DISTINCT c.label FROM lines l JOIN contexts c ON c.id = l.context_id WHERE l.file_id = ?
+"""
+SELECT_CONTEXTS_FOR_LINES = """
+    SELECT DISTINCT c.label FROM lines l JOIN contexts c ON c.id = l.context_id
+    WHERE l.file_id = ? AND l.line_no BETWEEN ? AND ?
+"""
+SELECT_FILE_LINE_BITMAPS = """
+    SELECT c.label, b.bitmap FROM line_bitmaps b JOIN contexts c ON c.id = b.context_id WHERE b.file_id = ?
+"""
+
+# analysis cache (a separate database, see analysis_cache.py)
+INIT_ANALYSIS = """
+    CREATE TABLE IF NOT EXISTS analysis (
+        key TEXT PRIMARY KEY,
+        elements TEXT,
+        last_used REAL
+    )
+"""
+SELECT_ANALYSIS = "SELECT elements FROM analysis WHERE key = ?"
+INSERT_ANALYSIS = "INSERT OR REPLACE INTO analysis (key, elements, last_used) VALUES (?, ?, ?)"
+TOUCH_ANALYSIS = "UPDATE analysis SET last_used = ? WHERE key = ?"
+PRUNE_ANALYSIS = "DELETE FROM analysis WHERE last_used < ?"
+
+# per-file report output of the previous run, reused while the file's fingerprint is unchanged
+INIT_REPORT_FRAGMENTS = """
+    CREATE TABLE IF NOT EXISTS report_fragments (
+        reporter TEXT,
+        filename TEXT,
+        fingerprint TEXT,
+        fragment TEXT,
+        PRIMARY KEY (reporter, filename)
+    )
+"""
+SELECT_REPORT_FRAGMENT = "SELECT fragment FROM report_fragments WHERE reporter = ? AND filename = ? AND fingerprint = ?"
+INSERT_REPORT_FRAGMENT = """
+    INSERT OR REPLACE INTO report_fragments (reporter, filename, fingerprint, fragment) VALUES (?, ?, ?, ?)
+"""
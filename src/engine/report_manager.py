@@ -1,24 +1,86 @@
-from typing import List
-from ..reporters.base import AnalysisResults
+import time
+import logging
+from collections import defaultdict
+from typing import Callable, Dict, Iterable, List, Optional, Tuple
+from ..reporters.base import AnalysisResults, FileResults
 from ..reporters.console import ConsoleReporter
 from ..reporters.html import HtmlReporter
 from ..reporters.xml import XmlReporter
 from ..reporters.json import JsonReporter
+from .analysis_cache import ReportCache
 
 
 class ReportManager:
-    def __init__(self, reporters: List[str]):
+    def __init__(self, reporters: List[str],
+                 source_reader: Optional[Callable[[str], Optional[bytes]]] = None, jobs: int = 1):
         self.reporters = []
         for r in reporters:
             if r == 'console':
                 self.reporters.append(ConsoleReporter())
             elif r == 'html':
-                self.reporters.append(HtmlReporter(output_dir="htmlcov"))
+                self.reporters.append(HtmlReporter(output_dir="htmlcov", jobs=jobs))
             elif r == 'xml':
                 self.reporters.append(XmlReporter(output_file="coverage.xml"))
             elif r == 'json':
                 self.reporters.append(JsonReporter(output_file="coverage.json"))
 
-    def generate(self, results: AnalysisResults, project_root: str) -> None:
         for reporter in self.reporters:
-            reporter.generate(results, project_root)
+            reporter.source_reader = source_reader
+
+        # seconds spent in each reporter, by reporter class name
+        self.timings: Dict[str, float] = defaultdict(float)
+
+    def generate(self, results: AnalysisResults, project_root: str,
+                 report_cache: Optional[ReportCache] = None, sample_rate: Optional[float] = None) -> None:
+        """
+        Run every reporter. With a report_cache, files unchanged since the previous
+        report reuse their rendered output. sample_rate marks the data as sampled.
+        """
+        for reporter in self.reporters:
+            reporter.report_cache = report_cache
+            reporter.sample_rate = sample_rate
+            start = time.perf_counter()
+            try:
+                reporter.generate(results, project_root)
+            finally:
+                self.timings[type(reporter).__name__] += time.perf_counter() - start
+                reporter.report_cache = None
+                reporter.sample_rate = None
+        self._flush(report_cache)
+
+    def generate_streaming(self, file_results: Iterable[Tuple[str, FileResults]], project_root: str,
+                           report_cache: Optional[ReportCache] = None, sample_rate: Optional[float] = None) -> None:
+        """
+        Fan each (filename, results) pair out to every reporter before taking the next
+        one, then let the reporters write their totals. Reporters without streaming
+        support buffer the files themselves.
+        """
+        for reporter in self.reporters:
+            reporter.report_cache = report_cache
+            reporter.sample_rate = sample_rate
+        timings = self.timings
+        try:
+            for reporter in self.reporters:
+                start = time.perf_counter()
+                reporter.start(project_root)
+                timings[type(reporter).__name__] += time.perf_counter() - start
+            for filename, results in file_results:
+                for reporter in self.reporters:
+                    start = time.perf_counter()
+                    reporter.add_file(filename, results)
+                    timings[type(reporter).__name__] += time.perf_counter() - start
+            for reporter in self.reporters:
+                start = time.perf_counter()
+                reporter.finish()
+                timings[type(reporter).__name__] += time.perf_counter() - start
+        finally:
+            for reporter in self.reporters:
+                reporter.report_cache = None
+                reporter.sample_rate = None
+        self._flush(report_cache)
+
+    def _flush(self, report_cache: Optional[ReportCache]) -> None:
+        if report_cache:
+            report_cache.flush()
+            logging.getLogger(__name__).debug(
+                f"Report output reused for {report_cache.reused} files, rendered for {report_cache.rendered}")
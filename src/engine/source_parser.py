@@ -1,9 +1,26 @@
 import ast
+import os
 import re
 import types
 import logging
+from collections import OrderedDict
+from dataclasses import dataclass, field
 from typing import Tuple, Set, Optional, Iterable
 
+# sources kept in memory after reading, so reporters reuse the analyzer's read
+SOURCE_CACHE_BYTES = 64 * 1024 * 1024
+
+
+@dataclass
+class ParsedSource:
+    """
+    Everything static analysis needs from one source file, derived from a single read.
+    """
+    filename: str
+    tree: ast.Module
+    code: Optional[types.CodeType]
+    ignored_lines: Set[int] = field(default_factory=set)
+
 
 class SourceParser:
     """
@@ -12,6 +29,114 @@ class SourceParser:
 
     def __init__(self) -> None:
         self.logger = logging.getLogger(__name__)
+        # filename -> (mtime_ns, size, contents), least recently read first
+        self._sources: "OrderedDict[str, Tuple[int, int, bytes]]" = OrderedDict()
+        self._cached_bytes = 0
+
+    def __getstate__(self):
+        # worker processes read their own sources
+        state = self.__dict__.copy()
+        state['_sources'] = OrderedDict()
+        state['_cached_bytes'] = 0
+        return state
+
+    def read_source(self, filename: str) -> Optional[bytes]:
+        """
+        Read the raw bytes of a source file, or None if it cannot be read.
+        Recently read files are served from memory while their mtime and size match.
+        """
+        try:
+            st = os.stat(filename)
+            cached = self._sources.get(filename)
+            if cached is not None and cached[:2] == (st.st_mtime_ns, st.st_size):
+                self._sources.move_to_end(filename)
+                return cached[2]
+
+            with open(filename, 'rb') as f:
+                source = f.read()
+        except OSError as e:
+            self.logger.debug(f"Failed to read source {filename}: {e}")
+            return None
+
+        self._remember(filename, (st.st_mtime_ns, st.st_size, source))
+        return source
+
+    def _remember(self, filename: str, entry: Tuple[int, int, bytes]) -> None:
+        old = self._sources.pop(filename, None)
+        if old is not None:
+            self._cached_bytes -= len(old[2])
+        if len(entry[2]) > SOURCE_CACHE_BYTES:
+            return
+        self._sources[filename] = entry
+        self._cached_bytes += len(entry[2])
+        while self._cached_bytes > SOURCE_CACHE_BYTES:
+            _, (_, _, evicted) = self._sources.popitem(last=False)
+            self._cached_bytes -= len(evicted)
+
+    @staticmethod
+    def decode(source: bytes) -> str:
+        """
+        Decode source bytes, with newline handling matching a read in text mode.
+        Raises UnicodeDecodeError for sources that are not UTF-8.
+        """
+        return source.decode('utf-8').replace('\r\n', '\n').replace('\r', '\n')
+
+    def parse(
+        self,
+        filename: str,
+        source: bytes,
+        exclude_patterns: Optional[Iterable[str]] = None
+    ) -> Optional[ParsedSource]:
+        """
+        Parse already read source bytes into an AST, compile the code object from that
+        same tree, and collect the ignored lines.
+
+        Args:
+            filename (str): Path of the source file (used for the code object).
+            source (bytes): The file contents.
+            exclude_patterns (iterable): List of regex strings to ignore.
+        Returns:
+            ParsedSource, or None if the source cannot be decoded or parsed.
+        """
+        try:
+            source_text = self.decode(source)
+            tree = ast.parse(source_text)
+        except (SyntaxError, ValueError) as e:
+            # UnicodeDecodeError is a ValueError
+            self.logger.debug(f"Failed to parse source {filename}: {e}")
+            return None
+
+        try:
+            code = compile(tree, filename, 'exec')
+        except (SyntaxError, ValueError) as e:
+            # errors only detected by the compiler, e.g. 'return' outside function
+            self.logger.debug(f"Failed to compile source {filename}: {e}")
+            code = None
+
+        return ParsedSource(filename, tree, code, self._find_ignored_lines(source_text, exclude_patterns))
+
+    def _find_ignored_lines(self, source_text: str, exclude_patterns: Optional[Iterable[str]]) -> Set[int]:
+        """
+        Scan for '# pragma: no cover' comments AND provided regex patterns.
+        """
+        # default pragma pattern
+        regexes = [re.compile(r'#.*pragma:\s*no\s*cover', re.IGNORECASE)]
+
+        # add user-defined patterns
+        if exclude_patterns:
+            for pat in exclude_patterns:
+                try:
+                    regexes.append(re.compile(pat))
+                except re.error as e:
+                    self.logger.debug(f"Invalid regex pattern '{pat}': {e}")
+
+        ignored_lines: Set[int] = set()
+        for i, line in enumerate(source_text.splitlines(True)):
+            for regex in regexes:
+                if regex.search(line):
+                    ignored_lines.add(i + 1)
+                    break
+        return ignored_lines
 
     def parse_source(
         self,
@@ -31,36 +156,11 @@ class SourceParser:
             tuple: (ast.Module, set) containing the AST tree and a set of ignored line numbers.
                    Returns (None, set()) on failure.
         """
-        ignored_lines: Set[int] = set()
-        try:
-            with open(filename, 'r', encoding='utf-8') as f:
-                source_lines = f.readlines()
-
-            source_text = "".join(source_lines)
-            tree = ast.parse(source_text)
-
-            # default pragma pattern
-            regexes = [re.compile(r'#.*pragma:\s*no\s*cover', re.IGNORECASE)]
-
-            # add user-defined patterns
-            if exclude_patterns:
-                for pat in exclude_patterns:
-                    try:
-                        regexes.append(re.compile(pat))
-                    except re.error as e:
-                        self.logger.debug(f"Invalid regex pattern '{pat}': {e}")
-
-            for i, line in enumerate(source_lines):
-                for regex in regexes:
-                    if regex.search(line):
-                        ignored_lines.add(i + 1)
-                        break
-
-            return tree, ignored_lines
-
-        except (SyntaxError, OSError, UnicodeDecodeError) as e:
-            self.logger.debug(f"Failed to parse source {filename}: {e}")
+        source = self.read_source(filename)
+        parsed = self.parse(filename, source, exclude_patterns) if source is not None else None
+        if not parsed:
             return None, set()
+        return parsed.tree, parsed.ignored_lines
 
     def compile_source(self, filename: str) -> Optional[types.CodeType]:
         """
@@ -70,10 +170,6 @@ class SourceParser:
         Returns:
             types.CodeType: The compiled code object, or None on failure.
         """
-        try:
-            with open(filename, 'r', encoding='utf-8') as f:
-                source = f.read()
-            return compile(source, filename, 'exec')
-        except (SyntaxError, OSError, UnicodeDecodeError) as e:
-            self.logger.debug(f"Failed to compile source {filename}: {e}")
-            return None
+        source = self.read_source(filename)
+        parsed = self.parse(filename, source) if source is not None else None
+        return parsed.code if parsed else None
@@ -4,8 +4,18 @@ import logging
 import glob
 import uuid
 import time
-from typing import Dict, Any, Callable
+from concurrent.futures import ProcessPoolExecutor
+from contextlib import closing
+from collections import defaultdict
+from typing import Dict, Any, Callable, Iterable, List, Optional, Set, Tuple
 from . import queries
+from . import bitmaps
+from .file_table import FileTable
+
+STORAGE_FORMATS = ('rows', 'bitmap')
+
+# partials attached per merge transaction (SQLite allows 10 attached databases by default)
+COMBINE_FAN_IN = 8
 
 
 class CoverageStorage:
@@ -14,9 +24,23 @@ class CoverageStorage:
     Responsible for initializing the DB, saving partial data, and merging results.
     """
 
-    def __init__(self, data_file: str):
+    def __init__(self, data_file: str, storage_format: str = 'rows'):
         self.logger = logging.getLogger(__name__)
         self.data_file = data_file
+        if storage_format not in STORAGE_FORMATS:
+            self.logger.warning(f"Unknown storage format '{storage_format}', using 'rows'")
+            storage_format = 'rows'
+        # how partial files are written; readers always understand both
+        self.storage_format = storage_format
+        # set by a sampling engine; saved with every partial so reports can say so
+        self.sample_rate: Optional[float] = None
+        self.reset_partial()
+
+    def reset_partial(self) -> None:
+        """
+        Pick a new partial file for this process, e.g. in a forked child, which must
+        not append to its parent's.
+        """
         # unique identifier for this process's partial file
         self.pid = os.getpid()
         self.uuid = uuid.uuid4().hex[:6]
@@ -30,22 +54,63 @@ class CoverageStorage:
 
         cur.execute(queries.INIT_CONTEXTS)
         cur.execute(queries.INIT_DEFAULT_CONTEXT)
-        cur.execute(queries.INIT_LINES)
-        cur.execute(queries.INIT_ARCS)
-        cur.execute(queries.INIT_INSTRUCTION_ARCS)
+        self._upgrade_schema(cur, 'main')
+        self._create_tables(cur, 'main')
+        cur.execute(f"PRAGMA user_version = {queries.SCHEMA_VERSION}")
 
         conn.commit()
         return conn
 
-    def save(self, trace_data: Dict[str, Dict[Any, Any]], context_cache: Dict[str, int]) -> None:
+    @staticmethod
+    def _create_tables(cur: sqlite3.Cursor, schema: str) -> None:
+        cur.execute(queries.INIT_FILES.format(schema=schema))
+        cur.execute(queries.INIT_LINES.format(schema=schema))
+        cur.execute(queries.INIT_ARCS.format(schema=schema))
+        cur.execute(queries.INIT_INSTRUCTION_ARCS.format(schema=schema))
+        cur.execute(queries.INIT_LINE_BITMAPS.format(schema=schema))
+        cur.execute(queries.INIT_ARC_BLOBS.format(schema=schema))
+        cur.execute(queries.INIT_LINE_COUNTS.format(schema=schema))
+        cur.execute(queries.INIT_ARC_COUNTS.format(schema=schema))
+        cur.execute(queries.INIT_META.format(schema=schema))
+
+    def _upgrade_schema(self, cur: sqlite3.Cursor, schema: str) -> None:
+        """
+        Convert a database written with a file path in every row (schema version 0)
+        to the interned file table layout. No-op on empty or current databases.
+        """
+        columns = [row[1] for row in cur.execute(queries.LEGACY_TABLE_INFO.format(schema=schema)).fetchall()]
+        if 'file_path' not in columns:
+            return
+
+        self.logger.debug(f"Upgrading legacy coverage schema in {schema}")
+        for table in queries.LEGACY_TABLES:
+            cur.execute(queries.LEGACY_RENAME.format(schema=schema, table=table))
+        self._create_tables(cur, schema)
+        cur.execute(queries.LEGACY_COPY_FILES.format(schema=schema))
+
+        for table, columns in queries.LEGACY_TABLES.items():
+            cur.execute(queries.LEGACY_COPY_ROWS.format(
+                schema=schema, table=table,
+                columns=', '.join(('file_id',) + columns), legacy_columns=', '.join(f"t.{c}" for c in columns)))
+            cur.execute(queries.LEGACY_DROP.format(schema=schema, table=table))
+
+    def save(self, trace_data: Dict[str, Dict[Any, Any]], context_cache: Dict[str, int],
+             file_table: Optional[FileTable] = None) -> None:
         """
         Dump in-memory coverage data to a unique SQLite file.
+
+        Rows reference files by their ID in file_table (shared with the C tracer),
+        so each path string is written once. With the 'bitmap' format every
+        (file, context) pair becomes a single compressed blob instead of one row per hit.
         """
         # check if there is any data to save
         has_data = any(trace_data['lines'].values()) or any(trace_data['arcs'].values())
         if not has_data:
             return
 
+        if file_table is None:
+            file_table = FileTable()
+
         filename = f"{self.data_file}.{self.pid}.{self.uuid}"
 
         try:
@@ -56,38 +121,121 @@ class CoverageStorage:
             ctx_data = [(cid, label) for label, cid in context_cache.items()]
             cur.executemany(queries.INSERT_CONTEXT, ctx_data)
 
-            # batch insert lines
-            line_data = []
-            for file, ctx_map in trace_data['lines'].items():
-                for cid, lines in ctx_map.items():
-                    for line in lines:
-                        line_data.append((file, cid, line))
-            cur.executemany(queries.INSERT_LINE, line_data)
-
-            # batch insert arcs
-            arc_data = []
-            for file, ctx_map in trace_data['arcs'].items():
-                for cid, arcs in ctx_map.items():
-                    for start, end in arcs:
-                        arc_data.append((file, cid, start, end))
-            cur.executemany(queries.INSERT_ARC, arc_data)
+            if self.storage_format == 'bitmap':
+                used_files = self._save_bitmaps(cur, trace_data, file_table)
+            else:
+                used_files = self._save_rows(cur, trace_data, file_table)
 
-            # batch insert instruction arcs
-            instr_data = []
-            for file, ctx_map in trace_data['instruction_arcs'].items():
-                for cid, arcs in ctx_map.items():
-                    for start, end in arcs:
-                        instr_data.append((file, cid, start, end))
-            cur.executemany(queries.INSERT_INSTRUCTION_ARC, instr_data)
+            self._save_counts(cur, trace_data, file_table)
+            cur.executemany(queries.INSERT_FILE, [(file_table.id_for(f), f) for f in used_files])
+            if self.sample_rate is not None:
+                cur.execute(queries.INSERT_META, (queries.META_SAMPLE_RATE, self.sample_rate))
 
             conn.commit()
             conn.close()
         except Exception as e:
             self.logger.error(f"Failed to save coverage data to DB: {e}")
 
-    def combine(self, map_path_func: Callable[[str], str]) -> None:
+    @staticmethod
+    def _save_rows(cur: sqlite3.Cursor, trace_data: Dict[str, Dict[Any, Any]], file_table: FileTable) -> Set[str]:
+        used_files: Set[str] = set()
+
+        # batch insert lines
+        line_data = []
+        for file, ctx_map in trace_data['lines'].items():
+            file_id = file_table.id_for(file)
+            for cid, lines in ctx_map.items():
+                for line in lines:
+                    line_data.append((file_id, cid, line))
+            used_files.add(file)
+        cur.executemany(queries.INSERT_LINE, line_data)
+
+        # batch insert arcs
+        arc_data = []
+        for file, ctx_map in trace_data['arcs'].items():
+            file_id = file_table.id_for(file)
+            for cid, arcs in ctx_map.items():
+                for start, end in arcs:
+                    arc_data.append((file_id, cid, start, end))
+            used_files.add(file)
+        cur.executemany(queries.INSERT_ARC, arc_data)
+
+        # batch insert instruction arcs
+        instr_data = []
+        for file, ctx_map in trace_data['instruction_arcs'].items():
+            file_id = file_table.id_for(file)
+            for cid, arcs in ctx_map.items():
+                for start, end in arcs:
+                    instr_data.append((file_id, cid, start, end))
+            used_files.add(file)
+        cur.executemany(queries.INSERT_INSTRUCTION_ARC, instr_data)
+
+        return used_files
+
+    @staticmethod
+    def _save_counts(cur: sqlite3.Cursor, trace_data: Dict[str, Dict[Any, Any]], file_table: FileTable) -> None:
+        # counted files also have hits, so their paths are written with those
+        line_data = []
+        for file, ctx_map in trace_data['line_counts'].items():
+            file_id = file_table.id_for(file)
+            for cid, counts in ctx_map.items():
+                for line, hits in counts.items():
+                    line_data.append((file_id, cid, line, hits))
+        # only count mode has counts
+        if line_data:
+            cur.executemany(queries.INSERT_LINE_COUNT, line_data)
+
+        arc_data = []
+        for file, ctx_map in trace_data['arc_counts'].items():
+            file_id = file_table.id_for(file)
+            for cid, counts in ctx_map.items():
+                for (start, end), hits in counts.items():
+                    arc_data.append((file_id, cid, start, end, hits))
+        if arc_data:
+            cur.executemany(queries.INSERT_ARC_COUNT, arc_data)
+
+    @staticmethod
+    def _save_bitmaps(cur: sqlite3.Cursor, trace_data: Dict[str, Dict[Any, Any]], file_table: FileTable) -> Set[str]:
+        used_files: Set[str] = set()
+
+        line_data = []
+        for file, ctx_map in trace_data['lines'].items():
+            file_id = file_table.id_for(file)
+            for cid, lines in ctx_map.items():
+                if lines:
+                    blob = bitmaps.encode_lines(lines)
+                    # flushes append to the same partial, so fold in what is already there
+                    existing = cur.execute(queries.SELECT_LINE_BITMAP, (file_id, cid)).fetchone()
+                    if existing:
+                        blob = bitmaps.merge_lines(existing[0], blob)
+                    line_data.append((file_id, cid, blob))
+            used_files.add(file)
+        cur.executemany(queries.INSERT_LINE_BITMAP, line_data)
+
+        blob_data = []
+        for kind, key in ((queries.ARC_KIND_LINES, 'arcs'), (queries.ARC_KIND_INSTRUCTIONS, 'instruction_arcs')):
+            for file, ctx_map in trace_data[key].items():
+                file_id = file_table.id_for(file)
+                for cid, arcs in ctx_map.items():
+                    if arcs:
+                        blob = bitmaps.encode_pairs(arcs)
+                        existing = cur.execute(queries.SELECT_ARC_BLOB, (kind, file_id, cid)).fetchone()
+                        if existing:
+                            blob = bitmaps.merge_pairs(existing[0], blob)
+                        blob_data.append((kind, file_id, cid, blob))
+                used_files.add(file)
+        cur.executemany(queries.INSERT_ARC_BLOB, blob_data)
+
+        return used_files
+
+    def combine(self, map_path_func: Optional[Callable[[str], str]] = None, jobs: int = 1) -> None:
         """
         Merge all partial coverage database files into the main database.
+
+        Partials are attached COMBINE_FAN_IN at a time and merged in one transaction.
+        Paths are remapped once per file of each partial (skipped when map_path_func is
+        None), then rows are copied by ID. With jobs other than 1, large sets of partials
+        are first reduced in a tree by a process pool (0 means one process per CPU).
         """
         try:
             conn = self._init_db(self.data_file)
@@ -95,20 +243,99 @@ class CoverageStorage:
             self.logger.error(f"Error combining main database {self.data_file}: {e}")
             return
 
-        # register the path mapping function for use in SQL queries
-        conn.create_function("remap_path", 1, map_path_func)
-        cur = conn.cursor()
+        if jobs != 1 and len(self._find_partials()) > COMBINE_FAN_IN:
+            self._reduce_in_parallel(jobs)
 
-        pattern = f"{self.data_file}.*.*"
+        self._merge_into(conn, self._find_partials(), map_path_func)
+        # built here rather than at the first query, which should not pay for it
+        try:
+            conn.execute(queries.INIT_LINES_BY_LINE)
+            conn.commit()
+        except sqlite3.Error as e:
+            self.logger.debug(f"Could not index {self.data_file} by line: {e}")
+        conn.close()
 
-        for filename in glob.glob(pattern):
+    def _find_partials(self) -> List[str]:
+        return sorted(glob.glob(f"{self.data_file}.*.*"))
+
+    def _reduce_in_parallel(self, jobs: int) -> None:
+        """
+        Merge partials level by level into intermediate partials until at most
+        COMBINE_FAN_IN are left. Each group of a level is one transaction in a worker.
+        Whatever is left over if the pool fails is merged by the final pass.
+        """
+        workers = jobs if jobs > 0 else (os.cpu_count() or 1)
+        level = 0
+        try:
+            with ProcessPoolExecutor(max_workers=workers) as pool:
+                partials = self._find_partials()
+                while len(partials) > COMBINE_FAN_IN:
+                    groups = [partials[i:i + COMBINE_FAN_IN] for i in range(0, len(partials), COMBINE_FAN_IN)]
+                    # intermediates match the partial pattern, so a crash leaves them combinable
+                    targets = [f"{self.data_file}.{self.pid}.{self.uuid}-l{level}-{i}" for i in range(len(groups))]
+                    list(pool.map(_merge_group, targets, groups))
+                    remaining = self._find_partials()
+                    if len(remaining) >= len(partials):
+                        # only unreadable partials are left, the final pass reports them
+                        break
+                    partials = remaining
+                    level += 1
+        except Exception as e:
+            self.logger.warning(f"Parallel combine failed, merging sequentially: {e}")
+
+    def _merge_into(self, conn: sqlite3.Connection, partials: List[str],
+                    map_path_func: Optional[Callable[[str], str]]) -> None:
+        """
+        Merge partials into the database of conn and delete them.
+        A batch that fails is rolled back and retried one partial at a time.
+        """
+        cur = conn.cursor()
+        cur.execute(queries.INIT_FILE_MAP)
+
+        for i in range(0, len(partials), COMBINE_FAN_IN):
+            batch = partials[i:i + COMBINE_FAN_IN]
             try:
+                self._merge_batch(conn, batch, map_path_func)
+            except Exception as e:
+                if len(batch) == 1:
+                    self._log_merge_error(batch[0], e)
+                    continue
+                self.logger.debug(f"Batch merge failed, retrying file by file: {e}")
+                for filename in batch:
+                    try:
+                        self._merge_batch(conn, [filename], map_path_func)
+                    except Exception as e:
+                        self._log_merge_error(filename, e)
+                        continue
+                    self._remove_partial(filename)
+                continue
+
+            for filename in batch:
+                self._remove_partial(filename)
+
+    def _merge_batch(self, conn: sqlite3.Connection, filenames: List[str],
+                     map_path_func: Optional[Callable[[str], str]]) -> None:
+        cur = conn.cursor()
+        aliases = []
+        try:
+            # ATTACH is not allowed inside a transaction, so attach the whole batch first
+            for filename in filenames:
                 alias = f"partial_{uuid.uuid4().hex}"
                 cur.execute(f"ATTACH DATABASE ? AS {alias}", (filename,))
+                aliases.append(alias)
+
+            for alias in aliases:
+                # partials written by older versions still carry a path per row,
+                # or lack the bitmap tables
+                self._upgrade_schema(cur, alias)
+                self._create_tables(cur, alias)
 
                 # copy new contexts from partial, ignoring existing labels
                 cur.execute(queries.MERGE_CONTEXTS.format(alias=alias))
 
+                # map the partial's file IDs onto the main file table
+                self._merge_files(cur, alias, map_path_func)
+
                 # merge lines (re-mapping IDs via join on label)
                 cur.execute(queries.MERGE_LINES.format(alias=alias))
 
@@ -118,28 +345,89 @@ class CoverageStorage:
                 # merge instruction arcs
                 cur.execute(queries.MERGE_INSTRUCTION_ARCS.format(alias=alias))
 
-                conn.commit()
+                # OR bitmap blobs into the main database's blobs
+                self._merge_bitmaps(cur, alias)
+
+                # sum hit counts
+                cur.execute(queries.MERGE_LINE_COUNTS.format(alias=alias))
+                cur.execute(queries.MERGE_ARC_COUNTS.format(alias=alias))
+
+                cur.execute(queries.MERGE_META.format(alias=alias))
+
+            conn.commit()
+        except Exception:
+            conn.rollback()
+            raise
+        finally:
+            for alias in aliases:
                 cur.execute(f"DETACH DATABASE {alias}")
 
-                # retry loop for deletion to handle Windows file locking
-                for _ in range(5):
-                    try:
-                        os.remove(filename)
-                        break
-                    except OSError:
-                        time.sleep(0.1)
-            except sqlite3.OperationalError as e:
-                # happens if file is locked or corrupt
-                self.logger.debug(f"Skipping locked/corrupt partial file {filename}: {e}")
-            except Exception as e:
-                self.logger.error(f"Error combining {filename}: {e}")
+    def _log_merge_error(self, filename: str, error: Exception) -> None:
+        if isinstance(error, sqlite3.OperationalError):
+            # happens if file is locked or corrupt
+            self.logger.debug(f"Skipping locked/corrupt partial file {filename}: {error}")
+        else:
+            self.logger.error(f"Error combining {filename}: {error}")
 
-        conn.close()
+    @staticmethod
+    def _remove_partial(filename: str) -> None:
+        # retry loop for deletion to handle Windows file locking
+        for _ in range(5):
+            try:
+                os.remove(filename)
+                break
+            except OSError:
+                time.sleep(0.1)
 
-    def load_into(self, trace_data: Dict[str, Dict[Any, Any]], path_manager) -> None:
+    @staticmethod
+    def _merge_files(cur: sqlite3.Cursor, alias: str, map_path_func: Optional[Callable[[str], str]]) -> None:
+        """
+        Fill temp.file_map with partial file ID -> main file ID, adding remapped paths
+        to the main file table. Without map_path_func this is done entirely in SQL.
+        """
+        cur.execute(queries.CLEAR_FILE_MAP)
+        if map_path_func is None:
+            cur.execute(queries.MERGE_FILES.format(alias=alias))
+            cur.execute(queries.MERGE_FILE_MAP.format(alias=alias))
+            return
+
+        mapping = []
+        for partial_id, path in cur.execute(queries.MERGE_SELECT_FILES.format(alias=alias)).fetchall():
+            mapped = map_path_func(path)
+            cur.execute(queries.INSERT_MERGED_FILE, (mapped,))
+            main_id = cur.execute(queries.SELECT_FILE_ID, (mapped,)).fetchone()[0]
+            mapping.append((partial_id, main_id))
+        cur.executemany(queries.INSERT_FILE_MAP, mapping)
+
+    @staticmethod
+    def _merge_bitmaps(cur: sqlite3.Cursor, alias: str) -> None:
+        """
+        Merge the partial's blobs into the main database. Needs temp.file_map filled.
+        """
+        for file_id, cid, blob in cur.execute(queries.MERGE_SELECT_LINE_BITMAPS.format(alias=alias)).fetchall():
+            existing = cur.execute(queries.SELECT_LINE_BITMAP, (file_id, cid)).fetchone()
+            if existing:
+                blob = bitmaps.merge_lines(existing[0], blob)
+            cur.execute(queries.INSERT_LINE_BITMAP, (file_id, cid, blob))
+
+        for kind, file_id, cid, blob in cur.execute(queries.MERGE_SELECT_ARC_BLOBS.format(alias=alias)).fetchall():
+            existing = cur.execute(queries.SELECT_ARC_BLOB, (kind, file_id, cid)).fetchone()
+            if existing:
+                blob = bitmaps.merge_pairs(existing[0], blob)
+            cur.execute(queries.INSERT_ARC_BLOB, (kind, file_id, cid, blob))
+
+    def load_into(self, trace_data: Dict[str, Dict[Any, Any]], path_manager,
+                  files: Optional[Callable[[str], bool]] = None,
+                  context_id: Optional[Callable[[str], int]] = None,
+                  counts: Optional[Dict[str, Dict[Any, Any]]] = None) -> None:
         """
         Populate in-memory trace data from the main database.
-        Currently flattens data into the default context (0) for reporting.
+
+        Rows are streamed from the cursor and each file's path is canonicalized once.
+        files, if given, selects the canonical paths to load; rows of the others are
+        never read. context_id maps context labels to trace_data's context IDs; without
+        it everything is flattened into the default context (0) for reporting.
+        Hit counts are added to counts' line_counts and arc_counts (trace_data's by default).
         """
         if not os.path.exists(self.data_file):
             return
@@ -147,19 +435,151 @@ class CoverageStorage:
         try:
             conn = sqlite3.connect(self.data_file)
             cur = conn.cursor()
+            self._upgrade_schema(cur, 'main')
+            self._create_tables(cur, 'main')
+
+            # canonicalize each path once, rows only carry the file ID
+            paths = {file_id: path_manager.canonicalize(path) for file_id, path in cur.execute(queries.SELECT_FILES)}
+            if files is not None:
+                paths = {file_id: path for file_id, path in paths.items() if files(path)}
+
+            if context_id is None:
+                cids: Dict[int, int] = defaultdict(int)
+            else:
+                cids = {cid: context_id(label) for cid, label in cur.execute(queries.SELECT_CONTEXTS).fetchall()}
 
-            cur.execute(queries.SELECT_LINES)
-            for file, line in cur.fetchall():
-                trace_data['lines'][path_manager.canonicalize(file)][0].add(line)
+            def rows(query: str, file_filter: str):
+                if files is None:
+                    return conn.execute(query)
+                return (row for file_id in paths for row in conn.execute(query + file_filter, (file_id,)))
 
-            cur.execute(queries.SELECT_ARCS)
-            for file, start, end in cur.fetchall():
-                trace_data['arcs'][path_manager.canonicalize(file)][0].add((start, end))
+            for kind, query in (('lines', queries.SELECT_LINES), ('arcs', queries.SELECT_ARCS),
+                                ('instruction_arcs', queries.SELECT_INSTRUCTION_ARCS)):
+                self._load_rows(trace_data[kind], rows(query, queries.FILE_FILTER), paths, cids)
 
-            cur.execute(queries.SELECT_INSTRUCTION_ARCS)
-            for file, start, end in cur.fetchall():
-                trace_data['instruction_arcs'][path_manager.canonicalize(file)][0].add((start, end))
+            # blobs written with the bitmap format (a database may hold both kinds)
+            self._load_blobs(trace_data['lines'], rows(queries.SELECT_LINE_BITMAPS, queries.FILE_FILTER),
+                             paths, cids, bitmaps.decode_lines)
+            for kind, key in ((queries.ARC_KIND_LINES, 'arcs'), (queries.ARC_KIND_INSTRUCTIONS, 'instruction_arcs')):
+                query = queries.SELECT_ARC_BLOBS.format(kind=kind)
+                self._load_blobs(trace_data[key], rows(query, queries.ARC_BLOB_FILE_FILTER),
+                                 paths, cids, bitmaps.decode_pairs)
 
+            if counts is None:
+                counts = trace_data
+            for kind, query in (('line_counts', queries.SELECT_LINE_COUNTS), ('arc_counts', queries.SELECT_ARC_COUNTS)):
+                self._load_counts(counts[kind], rows(query, queries.FILE_FILTER), paths, cids)
+
+            conn.commit()
             conn.close()
         except sqlite3.OperationalError as e:
             self.logger.debug(f"OperationalError loading {self.data_file}: {e}")
+
+    @staticmethod
+    def _load_rows(per_file: Dict[str, Any], rows: Iterable[tuple], paths: Dict[int, str],
+                   cids: Dict[int, int]) -> None:
+        # rows arrive in primary key order, so the target set only changes between runs
+        last_file = last_cid = None
+        target: Set[Any] = set()
+        for row in rows:
+            file_id, cid = row[0], row[1]
+            if file_id != last_file or cid != last_cid:
+                last_file, last_cid = file_id, cid
+                target = per_file[paths[file_id]][cids[cid]]
+            # lines are single values, arcs (start, end) pairs
+            target.add(row[2] if len(row) == 3 else row[2:])
+
+    @staticmethod
+    def _load_counts(per_file: Dict[str, Any], rows: Iterable[tuple], paths: Dict[int, str],
+                     cids: Dict[int, int]) -> None:
+        last_file = last_cid = None
+        target: Dict[Any, int] = {}
+        for row in rows:
+            file_id, cid = row[0], row[1]
+            if file_id != last_file or cid != last_cid:
+                last_file, last_cid = file_id, cid
+                target = per_file[paths[file_id]][cids[cid]]
+            # (file_id, context_id, line_no, hits) or (..., start_line, end_line, hits)
+            value = row[2] if len(row) == 4 else row[2:4]
+            target[value] += row[-1]
+
+    @staticmethod
+    def _load_blobs(per_file: Dict[str, Any], rows: Iterable[tuple], paths: Dict[int, str],
+                    cids: Dict[int, int], decode: Callable[[bytes], Set[Any]]) -> None:
+        for file_id, cid, blob in rows:
+            per_file[paths[file_id]][cids[cid]].update(decode(blob))
+
+    def data_sample_rate(self) -> Optional[float]:
+        """
+        Smallest sample rate of the sampled runs merged into the main database, or
+        None if all of its data was fully traced.
+        """
+        if not os.path.exists(self.data_file):
+            return None
+        try:
+            with closing(sqlite3.connect(self.data_file)) as conn:
+                row = conn.execute(queries.SELECT_META, (queries.META_SAMPLE_RATE,)).fetchone()
+        except sqlite3.OperationalError:
+            # written before the meta table existed
+            return None
+        return row[0] if row else None
+
+    def contexts_for_lines(self, path: str, ranges: Optional[List[Tuple[int, int]]] = None) -> Set[str]:
+        """
+        Labels of the contexts that executed any line of path within ranges, a list of
+        inclusive (start, end) line pairs; None means any line of the file.
+
+        Only the rows and blobs of that file are read, through the lines_by_line index
+        built by combine() and the line_bitmaps primary key, so nothing is loaded into
+        a TraceContainer.
+        """
+        if not os.path.exists(self.data_file):
+            return set()
+
+        labels: Set[str] = set()
+        try:
+            conn = sqlite3.connect(self.data_file)
+        except sqlite3.Error as e:
+            self.logger.error(f"Failed to open {self.data_file}: {e}")
+            return labels
+        try:
+            # only read: the file may be read-only or shared. Without the index (data
+            # combined before it existed) SQLite scans the file's rows instead
+            cur = conn.cursor()
+            row = cur.execute(queries.SELECT_FILE_ID, (path,)).fetchone()
+            if row is None:
+                return labels
+            file_id = row[0]
+
+            if ranges is None:
+                labels.update(label for label, in cur.execute(queries.SELECT_CONTEXTS_FOR_FILE, (file_id,)))
+            else:
+                for start, end in ranges:
+                    labels.update(label for label, in cur.execute(queries.SELECT_CONTEXTS_FOR_LINES,
+                                                                  (file_id, start, end)))
+
+            for label, blob in cur.execute(queries.SELECT_FILE_LINE_BITMAPS, (file_id,)).fetchall():
+                if label in labels:
+                    continue
+                if ranges is None or any(bitmaps.any_line_in_range(blob, start, end) for start, end in ranges):
+                    labels.add(label)
+        except sqlite3.OperationalError as e:
+            self.logger.debug(f"OperationalError querying {self.data_file}: {e}")
+        finally:
+            conn.close()
+        return labels
+
+
+def _merge_group(target: str, partials: List[str]) -> None:
+    """
+    Process pool entry point of the tree combine: merge partials into a new
+    intermediate partial. Paths are kept as they are, the final pass remaps them.
+    """
+    storage = CoverageStorage(target)
+    try:
+        conn = storage._init_db(target)
+    except Exception as e:
+        storage.logger.error(f"Error creating intermediate database {target}: {e}")
+        return
+    storage._merge_into(conn, partials, None)
+    conn.close()
@@ -1,5 +1,12 @@
-from collections import defaultdict
-from typing import Dict, Any
+import sys
+import time
+from collections import Counter, defaultdict
+from typing import Callable, Dict, Any, Optional
+
+# kinds holding the set of recorded values per file and context
+HIT_KINDS = ('lines', 'arcs', 'instruction_arcs')
+# kinds holding a Counter of executions per value (collection_mode = count)
+COUNT_KINDS = ('line_counts', 'arc_counts')
 
 
 class TraceContainer:
@@ -10,7 +17,9 @@ class TraceContainer:
         self._data: Dict[str, Any] = {
             'lines': defaultdict(lambda: defaultdict(set)),
             'arcs': defaultdict(lambda: defaultdict(set)),
-            'instruction_arcs': defaultdict(lambda: defaultdict(set))
+            'instruction_arcs': defaultdict(lambda: defaultdict(set)),
+            'line_counts': defaultdict(lambda: defaultdict(Counter)),
+            'arc_counts': defaultdict(lambda: defaultdict(Counter)),
         }
 
     def add_line(self, filename: str, context_id: int, lineno: int) -> None:
@@ -22,5 +31,84 @@ class TraceContainer:
     def add_instruction_arc(self, filename: str, context_id: int, start: int, end: int) -> None:
         self._data['instruction_arcs'][filename][context_id].add((start, end))
 
+    def count_line(self, filename: str, context_id: int, lineno: int) -> None:
+        self._data['line_counts'][filename][context_id][lineno] += 1
+
+    def count_arc(self, filename: str, context_id: int, start: int, end: int) -> None:
+        self._data['arc_counts'][filename][context_id][(start, end)] += 1
+
     def __getitem__(self, key: str) -> Any:
         return self._data[key]
+
+    def take_counts(self) -> 'TraceContainer':
+        """
+        A container sharing this one's hit sets and holding the counts recorded so far,
+        which are removed from this one. Counts are summed when saved data is combined,
+        so each of them may only be saved once.
+        """
+        taken = self.view()
+        for kind in COUNT_KINDS:
+            per_file = self._data[kind]
+            for filename in list(per_file):
+                taken._data[kind][filename] = per_file.pop(filename)
+        return taken
+
+    def view(self, files: Optional[Callable[[str], bool]] = None,
+             counts: Optional['TraceContainer'] = None) -> 'TraceContainer':
+        """
+        A container sharing the per-file data of the files accepted by files (all by
+        default), with the hit counts taken from counts instead of this container.
+        """
+        view = TraceContainer()
+        for kind in HIT_KINDS + COUNT_KINDS:
+            source = (counts if counts is not None and kind in COUNT_KINDS else self)._data[kind]
+            if files is None and kind in HIT_KINDS:
+                view._data[kind] = source
+            else:
+                view._data[kind].update((f, v) for f, v in source.items() if files is None or files(f))
+        return view
+
+    def take(self, grace: float = 0.0) -> 'TraceContainer':
+        """
+        Move everything recorded so far into a new container and leave this one empty.
+
+        The top-level mappings are emptied in place rather than replaced, because the
+        C tracer holds references to them. A Python tracer in another thread may still
+        be adding to a set it fetched just before; after `grace` seconds the taken sets
+        are copied, so stragglers can no longer change them while they are written out.
+        """
+        taken = TraceContainer()
+        for kind, per_file in self._data.items():
+            for filename in list(per_file):
+                taken._data[kind][filename] = per_file.pop(filename)
+
+        if grace > 0:
+            time.sleep(grace)
+        for kind, per_file in taken._data.items():
+            factory = Counter if kind in COUNT_KINDS else set
+            for filename, per_ctx in per_file.items():
+                frozen = defaultdict(factory)
+                for cid, values in list(per_ctx.items()):
+                    frozen[cid] = factory(values)
+                per_file[filename] = frozen
+        return taken
+
+    def hit_count(self) -> int:
+        """
+        Number of recorded lines, arcs and instruction arcs over all files and contexts.
+        """
+        return sum(len(values) for kind in HIT_KINDS
+                   for per_file in list(self._data[kind].values()) for values in list(per_file.values()))
+
+    def memory_usage(self) -> int:
+        """
+        Approximate number of bytes held by the containers and the recorded values.
+        """
+        total = 0
+        for per_kind in self._data.values():
+            total += sys.getsizeof(per_kind)
+            for per_file in per_kind.values():
+                total += sys.getsizeof(per_file)
+                for values in per_file.values():
+                    total += sys.getsizeof(values) + sum(sys.getsizeof(v) for v in values)
+        return total
@@ -2,10 +2,49 @@ import argparse
 import sys
 import os
 import logging
+from typing import Any, Dict, List, Optional, Tuple
 
 from .engine import MiniCoverage
 
 
+def parse_location(location: str) -> Tuple[str, Optional[List[Tuple[int, int]]]]:
+    """
+    Split 'file.py', 'file.py:12' or 'file.py:12-20' into the file and its line ranges.
+    """
+    filename, sep, lines = location.rpartition(":")
+    if not sep or not lines or not lines[0].isdigit():
+        return location, None
+    start, _, end = lines.partition("-")
+    return filename, [(int(start), int(end) if end else int(start))]
+
+
+def format_profile(stats: Dict[str, Any], project_root: str, top: int = 10) -> str:
+    """
+    Render MiniCoverage.stats() for --profile: events, buffer use, phase timings and
+    the files that produced the most events.
+    """
+    tracer = stats['tracer']
+    lines = ["[minicov profile]"]
+    events = tracer.get('events', {})
+    if events:
+        lines.append("events: " + ", ".join(f"{name}={n}" for name, n in sorted(events.items())))
+    lines.append(f"filtered: {tracer.get('filtered', 0)}  should_trace calls: {tracer.get('should_trace_calls', 0)}")
+    if 'inserts' in tracer:
+        lines.append(f"buffer inserts: {tracer['inserts']}  duplicates: {tracer['duplicates']}  "
+                     f"peak pending: {tracer['peak_pending']}")
+    lines.append(f"pending hits: {stats['pending_hits']}")
+    if stats['timings']:
+        lines.append("timings: " + ", ".join(f"{phase}={seconds:.3f}s" for phase, seconds in stats['timings'].items()))
+
+    file_events = tracer.get('file_events', {})
+    if file_events:
+        lines.append(f"top {min(top, len(file_events))} files by events:")
+        busiest = sorted(file_events.items(), key=lambda item: item[1], reverse=True)[:top]
+        for filename, n in busiest:
+            lines.append(f"  {n:>10}  {os.path.relpath(filename, project_root)}")
+    return "\n".join(lines)
+
+
 def main() -> None:
     logging.basicConfig(
         level=logging.INFO,
@@ -21,6 +60,8 @@ def main() -> None:
 
     # command: run
     parser_run = subparsers.add_parser("run", help="Run a Python program and measure code coverage.")
+    parser_run.add_argument("--profile", action="store_true",
+                            help="Print the tracer's event counters and phase timings afterwards.")
     parser_run.add_argument("script", help="Python script to execute.")
     parser_run.add_argument("script_args", nargs=argparse.REMAINDER, help="Arguments for the script.")
 
@@ -28,9 +69,23 @@ def main() -> None:
     parser_report = subparsers.add_parser("report", help="Report coverage results.")
     parser_report.add_argument("--format", nargs="+", choices=['console', 'html', 'xml', 'json'],
                                help="Specify output formats (console, html, xml, json). Default: console html")
+    parser_report.add_argument("--include", nargs="+", metavar="PATTERN",
+                               help="Report only files matching these patterns (relative to the project root).")
+    parser_report.add_argument("--stream", action="store_true",
+                               help="Report each file as soon as it is analyzed. Default: stream_reports.")
+    parser_report.add_argument("--profile", action="store_true",
+                               help="Print the time spent combining, loading, analyzing and per reporter.")
 
     # command: combine
-    _ = subparsers.add_parser("combine", help="Combine data from multiple run files.")
+    parser_combine = subparsers.add_parser("combine", help="Combine data from multiple run files.")
+    parser_combine.add_argument("--jobs", type=int,
+                                help="Processes used to merge partial files (0: one per CPU). Default: combine_jobs.")
+
+    # command: contexts
+    parser_contexts = subparsers.add_parser(
+        "contexts", help="List the contexts (e.g. tests) that executed lines of files.")
+    parser_contexts.add_argument("locations", nargs="+", metavar="FILE[:START[-END]]",
+                                 help="File, optionally with a line or an inclusive line range.")
 
     args = parser.parse_args()
 
@@ -44,13 +99,33 @@ def main() -> None:
             logging.error(f"Script '{script_path}' not found.")
             sys.exit(1)
 
-        cov.run(script_path, args.script_args)
+        try:
+            cov.run(script_path, args.script_args)
+        finally:
+            if args.profile:
+                print(format_profile(cov.stats(), cov.project_root), file=sys.stderr)
 
     elif args.command == "report":
-        cov.report(reporters=args.format)
+        if args.stream:
+            cov.config.stream_reports = True
+        cov.report(reporters=args.format, include=args.include)
+        if args.profile:
+            print(format_profile(cov.stats(), cov.project_root), file=sys.stderr)
+
+    elif args.command == "contexts":
+        labels = set()
+        for location in args.locations:
+            try:
+                filename, ranges = parse_location(location)
+            except ValueError:
+                logging.error(f"Invalid location '{location}', expected FILE[:START[-END]].")
+                sys.exit(1)
+            labels |= cov.contexts_for(filename, ranges)
+        for label in sorted(labels):
+            print(label)
 
     elif args.command == "combine":
-        cov.combine_data()
+        cov.combine_data(jobs=args.jobs)
         logging.info("Coverage data combined.")
 
 
@@ -30,7 +30,7 @@ class BytecodeControlFlow(CoverageMetric):
         jumps: Set[Tuple[int, int]]
     ) -> None:
         # build CFG for the current code object
-        cfg = ControlFlowGraph(co)
+        cfg = ControlFlowGraph.of(co)
         jumps.update(cfg.get_jumps())
 
         for const in co.co_consts:
@@ -1,7 +1,14 @@
 import dis
 import sys
 import types
-from typing import Set, Dict, List, Tuple
+import weakref
+from typing import Set, Dict, List, Optional, Tuple
+
+# set lookups instead of scanning dis.hasjabs / dis.hasjrel lists per instruction
+_JUMP_OPCODES = frozenset(dis.hasjabs) | frozenset(dis.hasjrel)
+
+# one graph per code object, shared by every metric analyzing it
+_shared_graphs: 'weakref.WeakKeyDictionary[types.CodeType, ControlFlowGraph]' = weakref.WeakKeyDictionary()
 
 
 class ControlFlowGraph:
@@ -10,6 +17,10 @@ class ControlFlowGraph:
 
     Identifies Basic Blocks, computes edges (jumps/fallthroughs),
     exception handlers, and dominators.
+
+    Blocks are identified by their start offset. Dominators are computed as an
+    immediate-dominator tree (`idom`); the full `dominators` sets are derived from it
+    on first access.
     """
 
     def __init__(self, code: types.CodeType):
@@ -19,13 +30,30 @@ class ControlFlowGraph:
 
         self.leaders = self._find_leaders()
         self.blocks = self._build_blocks()
+        # block start -> offset of its last instruction
+        self.block_end: Dict[int, int] = dict(self.blocks)
 
         self.successors: Dict[int, Set[int]] = {b_start: set() for b_start, _ in self.blocks}
         self.predecessors: Dict[int, Set[int]] = {b_start: set() for b_start, _ in self.blocks}
         self._build_edges()
 
-        self.dominators: Dict[int, Set[int]] = {}
+        # block start -> start of its immediate dominator (the entry maps to itself);
+        # blocks unreachable from the entry have no entry
+        self.idom: Dict[int, int] = {}
         self._compute_dominators()
+        self._dominators: Optional[Dict[int, Set[int]]] = None
+
+    @classmethod
+    def of(cls, code: types.CodeType) -> 'ControlFlowGraph':
+        """
+        Return the graph of a code object, building it on first use. The graph lives as
+        long as the code object, so metrics analyzing the same code share it.
+        """
+        cfg = _shared_graphs.get(code)
+        if cfg is None:
+            cfg = cls(code)
+            _shared_graphs[code] = cfg
+        return cfg
 
     def _find_leaders(self) -> Set[int]:
         """Find the starting offset of all basic blocks."""
@@ -33,7 +61,7 @@ class ControlFlowGraph:
 
         for i, instr in enumerate(self.instructions):
             # target of any jump is a leader
-            if instr.opcode in dis.hasjabs or instr.opcode in dis.hasjrel:
+            if instr.opcode in _JUMP_OPCODES:
                 target = int(instr.argval)
                 leaders.add(target)
 
@@ -82,7 +110,7 @@ class ControlFlowGraph:
             targets = []
 
             # 1. jumps
-            if end_instr.opcode in dis.hasjabs or end_instr.opcode in dis.hasjrel:
+            if end_instr.opcode in _JUMP_OPCODES:
                 targets.append(int(end_instr.argval))
 
             # 2. fallthrough: unconditional flow breakers
@@ -110,54 +138,100 @@ class ControlFlowGraph:
                     self.successors[start].add(t)
                     self.predecessors[t].add(start)
 
+    def _reverse_postorder(self, entry: int) -> List[int]:
+        """Blocks reachable from entry in reverse postorder (iterative DFS)."""
+        postorder = []
+        visited = {entry}
+        stack = [(entry, iter(self.successors[entry]))]
+        while stack:
+            node, successors = stack[-1]
+            for succ in successors:
+                if succ not in visited:
+                    visited.add(succ)
+                    stack.append((succ, iter(self.successors[succ])))
+                    break
+            else:
+                stack.pop()
+                postorder.append(node)
+        postorder.reverse()
+        return postorder
+
     def _compute_dominators(self) -> None:
         """
-        Compute dominators for each block using a standard iterative algorithm.
-        Dom(n) = {n} U (Intersection of Dom(p) for all p in pred(n))
+        Compute immediate dominators with the Cooper-Harvey-Kennedy algorithm
+        ("A Simple, Fast Dominance Algorithm") over reverse-postorder indices.
         """
-        # initialize
-        all_nodes = set(self.successors.keys())
-        self.dominators = {node: all_nodes.copy() for node in all_nodes}
-
-        # start node dominates itself
-        start_node = 0
-        if start_node in self.dominators:
-            self.dominators[start_node] = {start_node}
+        entry = 0
+        if entry not in self.successors:
+            return
+
+        order = self._reverse_postorder(entry)
+        index = {node: i for i, node in enumerate(order)}
+        preds = [[index[p] for p in self.predecessors[node] if p in index] for node in order]
+
+        # idom by RPO index; -1 means not computed yet
+        idom = [-1] * len(order)
+        idom[0] = 0
+
+        def intersect(a: int, b: int) -> int:
+            while a != b:
+                while a > b:
+                    a = idom[a]
+                while b > a:
+                    b = idom[b]
+            return a
 
         changed = True
         while changed:
             changed = False
-            for node in all_nodes:
-                if node == start_node:
-                    continue
-
-                preds = self.predecessors[node]
-                if not preds:
-                    continue
-
-                # Intersection of all predecessors
-                # Start with the first predecessor's dominators
-                first_pred = next(iter(preds))
-                new_dom = self.dominators[first_pred].copy()
-
-                for p in preds:
-                    new_dom &= self.dominators[p]
+            for i in range(1, len(order)):
+                new_idom = -1
+                for p in preds[i]:
+                    if idom[p] == -1:
+                        continue
+                    new_idom = p if new_idom == -1 else intersect(p, new_idom)
+                if idom[i] != new_idom:
+                    idom[i] = new_idom
+                    changed = True
 
-                new_dom.add(node)
+        self.idom = {node: order[idom[i]] for i, node in enumerate(order)}
 
-                if new_dom != self.dominators[node]:
-                    self.dominators[node] = new_dom
-                    changed = True
+    @property
+    def dominators(self) -> Dict[int, Set[int]]:
+        """
+        Dom(n): every block on all paths from the entry to n, including n.
+        Blocks unreachable from the entry are dominated by every block.
+        """
+        if self._dominators is None:
+            all_nodes = set(self.successors)
+            doms: Dict[int, Set[int]] = {}
+            for node in self.successors:
+                if node not in self.idom:
+                    doms[node] = all_nodes.copy()
+                    continue
+                # walk up the tree until a block whose set is known
+                chain = []
+                current = node
+                while current not in doms:
+                    chain.append(current)
+                    parent = self.idom[current]
+                    if parent == current:
+                        doms[current] = {current}
+                        chain.pop()
+                        break
+                    current = parent
+                for n in reversed(chain):
+                    doms[n] = doms[self.idom[n]] | {n}
+            self._dominators = doms
+        return self._dominators
 
     def get_jumps(self) -> Set[Tuple[int, int]]:
         """Return all edges as (source_instruction_offset, target_instruction_offset)"""
         jumps = set()
         for src, targets in self.successors.items():
-            # src is the block start. We usually want the edge from the *end* instruction of the block
-            # to the *start* instruction of the target block.
-            # find the end instruction of the 'src' block
-            block_end = next(end for s, end in self.blocks if s == src)
-
+            # src is the block start; edges go from its *end* instruction
+            # to the *start* instruction of the target block
+            block_end = self.block_end[src]
             for t in targets:
                 jumps.add((block_end, t))
         return jumps
@@ -33,7 +33,7 @@ class ConditionCoverage(CoverageMetric):
 
     def _analyze_boolean_jumps(self, co: types.CodeType, arcs: Set[Tuple[int, int]]) -> None:
         # instructions to find offsets
-        cfg = ControlFlowGraph(co)
+        cfg = ControlFlowGraph.of(co)
 
         for i, instr in enumerate(cfg.instructions):
             # instructions relevant for boolean logic
@@ -1,10 +1,19 @@
-import pytest  # noqa: F401
+import pytest
 import os  # noqa: F401
 from ..engine import MiniCoverage
 
 # global instance for the session
 _cov_engine = None
 
+# key of the coverage delta in xdist's workeroutput
+_XDIST_KEY = "minicov_delta"
+
+
+def _is_xdist_worker(config) -> bool:
+    # pytest-xdist gives worker processes a workerinput dict, and sends their
+    # workeroutput dict to the controller when the session finishes
+    return hasattr(config, "workerinput")
+
 
 def pytest_addoption(parser) -> None:
     """Register command line options."""
@@ -34,6 +43,14 @@ def pytest_sessionfinish(session, exitstatus) -> None:
     """
     global _cov_engine
     if _cov_engine:
+        if _is_xdist_worker(session.config):
+            # the controller merges this in memory and saves it with its own data,
+            # so no partial file is written per worker
+            _cov_engine.stop(save=False)
+            session.config.workeroutput[_XDIST_KEY] = _cov_engine.export_delta()
+            _cov_engine = None
+            return
+
         _cov_engine.stop()
         # optionally print a small summary or generate a report here
         # _cov_engine.report()
@@ -41,6 +58,16 @@ def pytest_sessionfinish(session, exitstatus) -> None:
         _cov_engine = None
 
 
+@pytest.hookimpl(optionalhook=True)
+def pytest_testnodedown(node, error) -> None:
+    """
+    xdist controller: merge the coverage delta a finished worker sent back.
+    """
+    delta = getattr(node, "workeroutput", {}).get(_XDIST_KEY)
+    if _cov_engine and delta:
+        _cov_engine.merge_delta(delta)
+
+
 def pytest_runtest_setup(item) -> None:
     """
     Switch context before each test.
@@ -1,4 +1,4 @@
-from .base import BaseReporter
+from .base import BaseReporter, StreamingReporter
 from .console import ConsoleReporter
 from .html import HtmlReporter
 from .xml import XmlReporter
@@ -6,6 +6,7 @@ from .json import JsonReporter
 
 __all__ = [
     "BaseReporter",
+    "StreamingReporter",
     "ConsoleReporter",
     "HtmlReporter",
     "XmlReporter",
@@ -1,17 +1,51 @@
 from abc import ABC
-from typing import Dict, Any
+from typing import Dict, Any, Callable, Optional
 
 # type aliases for clarity
 CoverageStats = Dict[str, Any]
 FileResults = Dict[str, CoverageStats]
 AnalysisResults = Dict[str, FileResults]
 
+# file results key of count mode data, next to the metrics:
+# {'lines': {lineno: hits}, 'arcs': {(start, end): hits}}
+HIT_COUNTS = 'HitCounts'
+
 
 class BaseReporter(ABC):
     """
     Abstract base class for all coverage reporters.
     Enforces a consistent interface for the strategy pattern.
     """
+    # ReportCache of the engine, set by ReportManager for incremental reports
+    report_cache: Any = None
+    # SourceParser.read_source of the engine, so sources read by the analyzer are reused
+    source_reader: Optional[Callable[[str], Optional[bytes]]] = None
+    # fraction of code objects a sampled run recorded, None for fully traced data
+    sample_rate: Optional[float] = None
+
+    def _sampling_notice(self) -> Optional[str]:
+        if self.sample_rate is None:
+            return None
+        return (f"Sampled data: {self.sample_rate:.0%} of code objects were traced, "
+                f"so code reported as missing may have run.")
+
+    def _read_source(self, filename: str) -> Optional[bytes]:
+        if self.source_reader is not None:
+            return self.source_reader(filename)
+        try:
+            with open(filename, 'rb') as f:
+                return f.read()
+        except OSError:
+            return None
+
+    def _render_cached(self, kind: str, filename: str, render: Callable[[], str]) -> str:
+        """
+        Render one file's output fragment, or reuse it from the previous report.
+        """
+        if self.report_cache is None:
+            return render()
+        return self.report_cache.fragment(kind, filename, render)
+
     def generate(self, results: AnalysisResults, project_root: str) -> None:
         """
         Generate the report based on analysis results.
@@ -21,3 +55,39 @@ class BaseReporter(ABC):
             project_root (str): The root directory of the project.
         """
         raise NotImplementedError
+
+    # streamed reporting: start(), add_file() per analyzed file in filename order, finish().
+    # reporters that only implement generate() get the files buffered for them.
+
+    def start(self, project_root: str) -> None:
+        self._streamed_root = project_root
+        self._streamed: AnalysisResults = {}
+
+    def add_file(self, filename: str, file_results: FileResults) -> None:
+        self._streamed[filename] = file_results
+
+    def finish(self) -> None:
+        results, self._streamed = self._streamed, {}
+        self.generate(results, self._streamed_root)
+
+
+class StreamingReporter(BaseReporter):
+    """
+    Base class for reporters that write each file's output as it arrives and keep
+    only running totals, so generate() is implemented on top of the streamed calls.
+    """
+
+    def generate(self, results: AnalysisResults, project_root: str) -> None:
+        self.start(project_root)
+        for filename in sorted(results):
+            self.add_file(filename, results[filename])
+        self.finish()
+
+    def start(self, project_root: str) -> None:
+        raise NotImplementedError
+
+    def add_file(self, filename: str, file_results: FileResults) -> None:
+        raise NotImplementedError
+
+    def finish(self) -> None:
+        raise NotImplementedError
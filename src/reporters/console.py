@@ -1,27 +1,33 @@
 import os
 from typing import Optional
-from .base import BaseReporter, AnalysisResults, CoverageStats
+from .base import StreamingReporter, FileResults, CoverageStats
 
 
-class ConsoleReporter(BaseReporter):
+class ConsoleReporter(StreamingReporter):
     """
     Outputs coverage statistics to the standard output.
     """
 
-    def generate(self, results: AnalysisResults, project_root: str) -> None:
+    def start(self, project_root: str) -> None:
+        self.project_root = project_root
         print("\n" + "=" * 115)
         headers = f"{'File':<40} | {'Stmt':>6} | {'Branch':>6} | {'Cond':>6} | {'Missing'}"
         print(headers)
         print("-" * 115)
 
-        for filename in sorted(results.keys()):
-            file_data = results[filename]
-            stmt_data = file_data.get('Statement')
-            branch_data = file_data.get('Branch')
-            cond_data = file_data.get('Condition')
+    def add_file(self, filename: str, file_results: FileResults) -> None:
+        stmt_data = file_results.get('Statement')
+        branch_data = file_results.get('Branch')
+        cond_data = file_results.get('Condition')
 
-            if stmt_data:
-                self._print_row(filename, stmt_data, branch_data, cond_data, project_root)
+        if stmt_data:
+            self._print_row(filename, stmt_data, branch_data, cond_data, self.project_root)
+
+    def finish(self) -> None:
+        notice = self._sampling_notice()
+        if notice:
+            print("-" * 115)
+            print(notice)
         print("=" * 115)
 
     def _print_row(self, filename: str, stmt_data: CoverageStats, branch_data: Optional[CoverageStats],
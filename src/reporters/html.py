@@ -1,67 +1,181 @@
 import os
 import html
+import math
+import logging
 import collections
-from .base import BaseReporter, AnalysisResults, FileResults
+from concurrent.futures import Future, ProcessPoolExecutor
+from typing import Dict, List, Optional, Set, Tuple
+from .base import StreamingReporter, FileResults, HIT_COUNTS
 from . import templates
 
+# below this many pages, starting a worker pool costs more than it saves
+PARALLEL_MIN_PAGES = 16
 
-class HtmlReporter(BaseReporter):
+# shades of the hit count gutter, from rarely to most executed line of a file
+HEAT_LEVELS = 5
+
+# (output path, relative name, executed lines, missing lines, missed branch targets, source, line hit counts)
+PageJob = Tuple[str, str, Set[int], Set[int], Dict[int, List[int]], Optional[bytes], Dict[int, int]]
+
+
+def source_lines(source: bytes) -> List[str]:
+    """
+    Split UTF-8 source bytes into lines the way readlines() in text mode would.
+    """
+    text = source.decode('utf-8').replace('\r\n', '\n').replace('\r', '\n')
+    lines = [line + '\n' for line in text.split('\n')]
+    if text.endswith('\n') or not text:
+        lines.pop()
+    else:
+        lines[-1] = lines[-1][:-1]
+    return lines
+
+
+def heat_level(hits: int, max_hits: int) -> int:
+    """
+    Heat of a line executed hits times, 1 to HEAT_LEVELS on a log scale up to max_hits.
+    """
+    if max_hits <= 1:
+        return 1
+    return 1 + int((HEAT_LEVELS - 1) * math.log(max(hits, 1)) / math.log(max_hits))
+
+
+def render_page(rel_name: str, executed_lines: Set[int], missing_lines: Set[int],
+                missing_branches: Dict[int, List[int]], source: Optional[bytes],
+                line_hits: Optional[Dict[int, int]] = None) -> str:
+    """
+    Render the annotated source page of one file, with a hit count gutter shaded by
+    heat when line_hits (count mode data) is given.
+    """
+    try:
+        lines = source_lines(source) if source is not None else None
+    except ValueError:
+        lines = None
+    if lines is None:
+        lines = ["Error reading source file."]
+
+    max_hits = max(line_hits.values()) if line_hits else 0
+
+    parts = []
+    for i, line in enumerate(lines):
+        lineno = i + 1
+        css_class = ""
+        annotation = ""
+
+        if lineno in executed_lines:
+            css_class = "hit"
+        elif lineno in missing_lines:
+            css_class = "miss"
+
+        if lineno in missing_branches:
+            targets = missing_branches[lineno]
+            if css_class == "hit":
+                css_class = "partial"
+
+            targets_str = ", ".join(map(str, targets))
+            annotation = f"<span class='annotate'>Missed branch to: {targets_str}</span>"
+
+        hits = ""
+        if line_hits:
+            count = line_hits.get(lineno)
+            hits = templates.render_hits(count, heat_level(count, max_hits) if count else 0)
+
+        line_content = html.escape(line.rstrip())
+        parts.append(templates.render_code_line(lineno, line_content, css_class, annotation, hits))
+
+    return templates.render_file(html.escape(rel_name), "".join(parts))
+
+
+def write_page(job: PageJob) -> None:
+    out_path, rel_name, executed_lines, missing_lines, missing_branches, source, line_hits = job
+    with open(out_path, "w") as f:
+        f.write(render_page(rel_name, executed_lines, missing_lines, missing_branches, source, line_hits))
+
+
+class HtmlReporter(StreamingReporter):
     """
     Generates a static HTML website visualizing coverage.
     """
 
-    def __init__(self, output_dir: str = "htmlcov") -> None:
+    def __init__(self, output_dir: str = "htmlcov", jobs: int = 1) -> None:
+        self.logger = logging.getLogger(__name__)
         self.output_dir = output_dir
+        # processes rendering the per-file pages: 1 renders in-process, 0 uses every CPU
+        self.jobs = jobs
 
-    def generate(self, results: AnalysisResults, project_root: str) -> None:
+    def start(self, project_root: str) -> None:
         if not os.path.exists(self.output_dir):
             os.makedirs(self.output_dir)
 
         print(f"Generating HTML report in {self.output_dir}...")
-        self._generate_index(results, project_root)
-
-        for filename, data in results.items():
-            self._generate_file_report(filename, data, project_root)
-
-    def _generate_index(self, results: AnalysisResults, project_root: str) -> None:
-        totals = {
+        self.project_root = project_root
+        self._totals = {
             'stmt': {'possible': 0, 'missing': 0},
             'branch': {'possible': 0, 'missing': 0},
             'cond': {'possible': 0, 'missing': 0}
         }
+        # only the index rows are kept until finish(), pages are written as files arrive
+        self._rows: List[str] = []
+
+        self._workers = self.jobs if self.jobs > 0 else (os.cpu_count() or 1)
+        self._pool: Optional[ProcessPoolExecutor] = None
+        # pages waiting for PARALLEL_MIN_PAGES to be reached, then pages being rendered by the pool
+        self._waiting: List[Tuple[str, PageJob]] = []
+        self._in_flight: "collections.deque[Tuple[str, PageJob, Future]]" = collections.deque()
+
+    def add_file(self, filename: str, file_results: FileResults) -> None:
+        stmt = file_results.get('Statement')
+        if not stmt:
+            return
 
-        rows = ""
-        for filename in sorted(results.keys()):
-            stmt = results[filename].get('Statement')
-            if not stmt:
-                continue
-
-            branch = results[filename].get('Branch', {})
-            cond = results[filename].get('Condition', {})
-
-            totals['stmt']['possible'] += len(stmt.get('possible', []))
-            totals['stmt']['missing'] += len(stmt.get('missing', []))
-
-            totals['branch']['possible'] += len(branch.get('possible', []))
-            totals['branch']['missing'] += len(branch.get('missing', []))
-
-            totals['cond']['possible'] += len(cond.get('possible', []))
-            totals['cond']['missing'] += len(cond.get('missing', []))
-
-            # calculate percentages for this file
-            # ensure pct exists even if empty
-            stmt.setdefault('pct', 0)
-
-            rel_name = os.path.relpath(filename, project_root)
-            file_html_link = f"{self._sanitize_filename(rel_name)}.html"
+        self._add_index_row(filename, file_results)
 
-            rows += templates.render_index_row(
-                file_html_link,
-                html.escape(rel_name),
-                stmt,
-                branch,
-                cond
-            )
+        job = self._page_job(filename, file_results, self.project_root)
+        if job is None:
+            return
+        if self._workers <= 1:
+            write_page(job)
+            self._remember(filename)
+        else:
+            self._waiting.append((filename, job))
+            self._dispatch_pages()
+
+    def finish(self) -> None:
+        self._dispatch_pages(final=True)
+        self._generate_index()
+
+    def _add_index_row(self, filename: str, file_results: FileResults) -> None:
+        stmt = file_results['Statement']
+        branch = file_results.get('Branch', {})
+        cond = file_results.get('Condition', {})
+        totals = self._totals
+
+        totals['stmt']['possible'] += len(stmt.get('possible', []))
+        totals['stmt']['missing'] += len(stmt.get('missing', []))
+
+        totals['branch']['possible'] += len(branch.get('possible', []))
+        totals['branch']['missing'] += len(branch.get('missing', []))
+
+        totals['cond']['possible'] += len(cond.get('possible', []))
+        totals['cond']['missing'] += len(cond.get('missing', []))
+
+        # calculate percentages for this file
+        # ensure pct exists even if empty
+        stmt.setdefault('pct', 0)
+
+        rel_name = os.path.relpath(filename, self.project_root)
+        file_html_link = f"{self._sanitize_filename(rel_name)}.html"
+
+        self._rows.append(templates.render_index_row(
+            file_html_link,
+            html.escape(rel_name),
+            stmt,
+            branch,
+            cond
+        ))
+
+    def _generate_index(self) -> None:
+        totals = self._totals
 
         # calculate total percentages
         def calc_pct(poss, miss):
@@ -72,21 +186,30 @@ class HtmlReporter(BaseReporter):
         total_branch_pct = calc_pct(totals['branch']['possible'], totals['branch']['missing'])
         total_cond_pct = calc_pct(totals['cond']['possible'], totals['cond']['missing'])
 
-        html_content = templates.render_index(total_stmt_pct, total_branch_pct, total_cond_pct, rows)
+        notice = self._sampling_notice()
+        notice_html = f"<p><em>{html.escape(notice)}</em></p>" if notice else ""
+        html_content = templates.render_index(total_stmt_pct, total_branch_pct, total_cond_pct, "".join(self._rows),
+                                              notice_html)
+        self._rows = []
 
         with open(os.path.join(self.output_dir, "index.html"), "w") as f:
             f.write(html_content)
 
-    def _generate_file_report(self, filename: str, data: FileResults, project_root: str) -> None:
+    def _page_job(self, filename: str, data: FileResults, project_root: str) -> Optional[PageJob]:
+        """
+        Everything needed to write one file's page, or None if the page is not needed.
+        """
         rel_name = os.path.relpath(filename, project_root)
-        out_name = f"{self._sanitize_filename(rel_name)}.html"
+        out_path = os.path.join(self.output_dir, f"{self._sanitize_filename(rel_name)}.html")
 
         stmt_data = data.get('Statement')
         if not stmt_data:
-            return
+            return None
 
-        executed_lines = stmt_data['executed']
-        missing_lines = stmt_data['missing']
+        # pages of unchanged files are left as written by the previous report
+        if self.report_cache and os.path.exists(out_path) and \
+                self.report_cache.is_current(self._cache_kind(), filename):
+            return None
 
         branch_data = data.get('Branch')
         missing_branches = collections.defaultdict(list)
@@ -94,38 +217,74 @@ class HtmlReporter(BaseReporter):
             for start, end in branch_data['missing']:
                 missing_branches[start].append(end)
 
+        # the analyzer already read the source; the engine's reader serves it from memory
+        source = self._read_source(filename)
+        line_hits = data.get(HIT_COUNTS, {}).get('lines', {})
+        return (out_path, rel_name, stmt_data['executed'], stmt_data['missing'], dict(missing_branches), source,
+                line_hits)
+
+    def _dispatch_pages(self, final: bool = False) -> None:
+        """
+        Hand waiting pages to the worker pool, started once PARALLEL_MIN_PAGES pages are
+        waiting. Pages of smaller reports, and of a pool that failed, are written here.
+        """
+        if self._pool is None and self._waiting and (final or len(self._waiting) >= PARALLEL_MIN_PAGES):
+            if not final:
+                try:
+                    self._pool = ProcessPoolExecutor(max_workers=self._workers)
+                except Exception as e:
+                    self.logger.warning(f"Parallel HTML rendering failed, rendering sequentially: {e}")
+                    self._workers = 1
+            if self._pool is None:
+                for filename, job in self._waiting:
+                    write_page(job)
+                    self._remember(filename)
+                self._waiting = []
+
+        if self._pool is not None:
+            waiting, self._waiting = self._waiting, []
+            for i, (filename, job) in enumerate(waiting):
+                try:
+                    future = self._pool.submit(write_page, job)
+                except Exception as e:
+                    # e.g. a worker died; finish what was submitted and render the rest here
+                    self.logger.warning(f"Parallel HTML rendering failed, rendering sequentially: {e}")
+                    self._stop_pool()
+                    for filename, job in waiting[i:]:
+                        write_page(job)
+                        self._remember(filename)
+                    return
+                self._in_flight.append((filename, job, future))
+
+            # bound the pages held in memory by the pool's backlog
+            backlog = 0 if final else self._workers * 4
+            while len(self._in_flight) > backlog:
+                self._collect_page(*self._in_flight.popleft())
+
+            if final:
+                self._stop_pool()
+
+    def _stop_pool(self) -> None:
+        while self._in_flight:
+            self._collect_page(*self._in_flight.popleft())
+        self._pool.shutdown()
+        self._pool = None
+        self._workers = 1
+
+    def _collect_page(self, filename: str, job: PageJob, future: Future) -> None:
         try:
-            with open(filename, 'r', encoding='utf-8') as f:
-                source_lines = f.readlines()
-        except Exception:
-            source_lines = ["Error reading source file."]
-
-        code_html = ""
-        for i, line in enumerate(source_lines):
-            lineno = i + 1
-            css_class = ""
-            annotation = ""
-
-            if lineno in executed_lines:
-                css_class = "hit"
-            elif lineno in missing_lines:
-                css_class = "miss"
-
-            if lineno in missing_branches:
-                targets = missing_branches[lineno]
-                if css_class == "hit":
-                    css_class = "partial"
-
-                targets_str = ", ".join(map(str, targets))
-                annotation = f"<span class='annotate'>Missed branch to: {targets_str}</span>"
-
-            line_content = html.escape(line.rstrip())
-            code_html += templates.render_code_line(lineno, line_content, css_class, annotation)
-
-        html_content = templates.render_file(html.escape(rel_name), code_html)
-
-        with open(os.path.join(self.output_dir, out_name), "w") as f:
-            f.write(html_content)
+            future.result()
+        except Exception as e:
+            self.logger.warning(f"Parallel HTML rendering failed, rendering {job[1]} in-process: {e}")
+            write_page(job)
+        self._remember(filename)
+
+    def _remember(self, filename: str) -> None:
+        if self.report_cache:
+            self.report_cache.remember(self._cache_kind(), filename)
+
+    def _cache_kind(self) -> str:
+        return f"html:{os.path.abspath(self.output_dir)}"
 
     def _sanitize_filename(self, path: str) -> str:
         return path.replace(os.sep, "_").replace(".", "_")
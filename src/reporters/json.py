@@ -2,10 +2,11 @@ import os
 import json
 import time
 import logging
-from .base import BaseReporter, AnalysisResults
+from typing import Any, Dict
+from .base import StreamingReporter, FileResults, HIT_COUNTS
 
 
-class JsonReporter(BaseReporter):
+class JsonReporter(StreamingReporter):
     """
     Generates a JSON report for programmatic consumption.
     """
@@ -14,30 +15,51 @@ class JsonReporter(BaseReporter):
         self.logger = logging.getLogger(__name__)
         self.output_file = output_file
 
-    def generate(self, results: AnalysisResults, project_root: str) -> None:
+    def start(self, project_root: str) -> None:
         self.logger.info(f"Generating JSON report to {self.output_file}...")
+        self.project_root = project_root
+        self._files_written = 0
 
-        serializable_results = {}
-        for filename, metrics in results.items():
-            rel_name = os.path.relpath(filename, project_root)
-            file_metrics = {}
+        meta = {
+            'timestamp': time.time(),
+            'project_root': project_root
+        }
+        if self.sample_rate is not None:
+            meta['sample_rate'] = self.sample_rate
+
+        # written by hand in the layout of json.dump(indent=4), so file entries (and cached
+        # fragments of them) go out as they arrive
+        self._out = open(self.output_file, 'w', encoding='utf-8')
+        self._out.write('{\n    "meta": ')
+        self._out.write(json.dumps(meta, indent=4).replace('\n', '\n    '))
+        self._out.write(',\n    "files": {')
+
+    def add_file(self, filename: str, file_results: FileResults) -> None:
+        rel_name = os.path.relpath(filename, self.project_root)
+        fragment = self._render_cached("json", filename, lambda: self._render_file(file_results))
+        self._out.write(',\n        ' if self._files_written else '\n        ')
+        self._out.write(json.dumps(rel_name) + ': ' + fragment.replace('\n', '\n        '))
+        self._files_written += 1
 
-            for metric_name, stats in metrics.items():
+    def finish(self) -> None:
+        self._out.write('\n    }\n}' if self._files_written else '}\n}')
+        self._out.close()
+
+    @staticmethod
+    def _render_file(metrics: Dict[str, Any]) -> str:
+        file_metrics = {}
+        for metric_name, stats in metrics.items():
+            if metric_name == HIT_COUNTS:
+                # JSON keys are strings, so arcs are [start, end, hits] triples
                 file_metrics[metric_name] = {
-                    'pct': stats['pct'],
-                    'missing': sorted(list(stats['missing'])),
-                    'executed': sorted(list(stats['executed'])),
-                    'possible': sorted(list(stats['possible']))
+                    'lines': {str(line): hits for line, hits in sorted(stats['lines'].items())},
+                    'arcs': [[start, end, hits] for (start, end), hits in sorted(stats['arcs'].items())],
                 }
-            serializable_results[rel_name] = file_metrics
-
-        final_report = {
-            'meta': {
-                'timestamp': time.time(),
-                'project_root': project_root
-            },
-            'files': serializable_results
-        }
-
-        with open(self.output_file, 'w', encoding='utf-8') as f:
-            json.dump(final_report, f, indent=4)
+                continue
+            file_metrics[metric_name] = {
+                'pct': stats['pct'],
+                'missing': sorted(list(stats['missing'])),
+                'executed': sorted(list(stats['executed'])),
+                'possible': sorted(list(stats['possible']))
+            }
+        return json.dumps(file_metrics, indent=4)
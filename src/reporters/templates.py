@@ -3,7 +3,7 @@ HTML templates and rendering helpers for the HTML reporter.
 """
 
 
-def render_index(stmt_pct, branch_pct, cond_pct, rows):
+def render_index(stmt_pct, branch_pct, cond_pct, rows, notice=""):
     return f"""
 <!DOCTYPE html>
 <html>
@@ -35,6 +35,7 @@ def render_index(stmt_pct, branch_pct, cond_pct, rows):
         Statements: <span class="{_get_css_class(stmt_pct)}">{stmt_pct:.1f}%</span> | 
         Branches: <span class="{_get_css_class(branch_pct)}">{branch_pct:.1f}%</span> | 
         Conditions (MC/DC): <span class="{_get_css_class(cond_pct)}">{cond_pct:.1f}%</span>
+        {notice}
     </div>
     <table>
         <thead>
@@ -96,6 +97,12 @@ def render_file(filename, code_html):
         .miss {{ background-color: #f8d7da; }}
         .partial {{ background-color: #fff3cd; }}
         .annotate {{ color: #856404; font-weight: bold; float: right; margin-left: 20px; }}
+        .hits {{ display: inline-block; min-width: 8ch; text-align: right; padding-right: 8px; color: #555; user-select: none; }}
+        .heat1 {{ background-color: #fff5eb; }}
+        .heat2 {{ background-color: #fdd0a2; }}
+        .heat3 {{ background-color: #fd8d3c; }}
+        .heat4 {{ background-color: #e6550d; color: #fff; }}
+        .heat5 {{ background-color: #a63603; color: #fff; }}
     </style>
 </head>
 <body>
@@ -105,9 +112,17 @@ def render_file(filename, code_html):
 """
 
 
-def render_code_line(lineno, content, css_class, annotation):
+def render_hits(count, level):
+    # hit count gutter of count mode data; lines that never ran get an empty cell
+    if not count:
+        return '<span class="hits"></span>'
+    return f'<span class="hits heat{level}" title="{count} execution{"s" if count != 1 else ""}">{count}</span>'
+
+
+def render_code_line(lineno, content, css_class, annotation, hits=""):
     # content is already escaped
     line_div = f'<div class="line {css_class}">'
+    line_div += hits
     line_div += f'<span class="lineno">{lineno}</span>'
 
     if annotation:
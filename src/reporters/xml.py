@@ -1,11 +1,18 @@
 import os
 import time
+import shutil
+import tempfile
 import collections
 import xml.etree.ElementTree as ET
-from .base import BaseReporter, AnalysisResults
+from typing import Any, Dict
+from xml.sax.saxutils import escape
+from .base import StreamingReporter, FileResults
 
+# attribute escaping of ElementTree, on top of &, < and >
+_ATTR_ENTITIES = {'"': '&quot;', '\n': '&#10;', '\r': '&#13;', '\t': '&#09;'}
 
-class XmlReporter(BaseReporter):
+
+class XmlReporter(StreamingReporter):
     """
     Generates a Cobertura-compatible XML coverage report.
     Useful for integration with CI/CD tools like Jenkins or Codecov.
@@ -14,24 +21,34 @@ class XmlReporter(BaseReporter):
     def __init__(self, output_file: str = "coverage.xml") -> None:
         self.output_file = output_file
 
-    def generate(self, results: AnalysisResults, project_root: str) -> None:
+    def start(self, project_root: str) -> None:
         print(f"Generating XML report to {self.output_file}...")
-
-        total_lines_valid = 0
-        total_lines_covered = 0
-        total_branches_valid = 0
-        total_branches_covered = 0
-
-        for file_res in results.values():
-            stmt = file_res.get('Statement')
-            if stmt:
-                total_lines_valid += len(stmt['possible'])
-                total_lines_covered += len(stmt['executed'])
-
-            branch = file_res.get('Branch')
-            if branch:
-                total_branches_valid += len(branch['possible'])
-                total_branches_covered += len(branch['executed'])
+        self.project_root = project_root
+        self._totals = {'lines_valid': 0, 'lines_covered': 0, 'branches_valid': 0, 'branches_covered': 0}
+        # the totals on <coverage> are only known at the end, so the <class> elements are
+        # spooled to a temporary file as they are rendered and copied after the header
+        self._classes = tempfile.TemporaryFile('w+', encoding='utf-8')
+
+    def add_file(self, filename: str, file_results: FileResults) -> None:
+        stmt = file_results.get('Statement')
+        if stmt:
+            self._totals['lines_valid'] += len(stmt['possible'])
+            self._totals['lines_covered'] += len(stmt['executed'])
+
+        branch = file_results.get('Branch')
+        if branch:
+            self._totals['branches_valid'] += len(branch['possible'])
+            self._totals['branches_covered'] += len(branch['executed'])
+
+        if stmt:
+            self._classes.write(self._render_cached(
+                "xml", filename, lambda: self._render_class(filename, file_results, self.project_root)))
+
+    def finish(self) -> None:
+        total_lines_valid = self._totals['lines_valid']
+        total_lines_covered = self._totals['lines_covered']
+        total_branches_valid = self._totals['branches_valid']
+        total_branches_covered = self._totals['branches_covered']
 
         line_rate = (total_lines_covered / total_lines_valid) if total_lines_valid > 0 else 1.0
         branch_rate = (total_branches_covered / total_branches_valid) if total_branches_valid > 0 else 1.0
@@ -49,7 +66,7 @@ class XmlReporter(BaseReporter):
 
         sources = ET.SubElement(root, "sources")
         source = ET.SubElement(sources, "source")
-        source.text = project_root
+        source.text = self.project_root
 
         packages = ET.SubElement(root, "packages")
         package = ET.SubElement(packages, "package")
@@ -59,58 +76,63 @@ class XmlReporter(BaseReporter):
         package.set("complexity", "0")
 
         classes = ET.SubElement(package, "classes")
-
-        for filename in sorted(results.keys()):
-            rel_name = os.path.relpath(filename, project_root)
-            file_data = results[filename]
-            stmt = file_data.get('Statement')
-            if not stmt:
-                continue
-
-            file_line_rate = stmt['pct'] / 100.0
-
-            cls = ET.SubElement(classes, "class")
-            cls.set("name", rel_name.replace(".py", ""))
-            cls.set("filename", rel_name)
-            cls.set("line-rate", str(file_line_rate))
-
-            branch = file_data.get('Branch')
-            file_branch_rate = (branch['pct'] / 100.0) if branch else 0.0
-            cls.set("branch-rate", str(file_branch_rate))
-            cls.set("complexity", "0")
-
-            lines_elem = ET.SubElement(cls, "lines")
-
-            all_lines = stmt['possible']
-            executed = stmt['executed']
-
-            branch_map = collections.defaultdict(list)
-            executed_branches = set()
-            if branch:
-                for start, end in branch['possible']:
-                    branch_map[start].append(end)
-                executed_branches = set(branch['executed'])
-
-            for lineno in sorted(all_lines):
-                line_elem = ET.SubElement(lines_elem, "line")
-                line_elem.set("number", str(lineno))
-                hits = 1 if lineno in executed else 0
-                line_elem.set("hits", str(hits))
-
-                if lineno in branch_map:
-                    targets = branch_map[lineno]
-                    line_elem.set("branch", "true")
-
-                    covered_count = 0
-                    for t in targets:
-                        if (lineno, t) in executed_branches:
-                            covered_count += 1
-
-                    coverage_percent = int((covered_count / len(targets)) * 100)
-                    line_elem.set("condition-coverage", f"{coverage_percent}% ({covered_count}/{len(targets)})")
-                else:
-                    line_elem.set("branch", "false")
-
-        tree = ET.ElementTree(root)
-        with open(self.output_file, "wb") as f:
-            tree.write(f, encoding="utf-8", xml_declaration=True)
+        # the <class> elements are not part of the tree, they are written in its place
+        classes.append(ET.Comment("classes"))
+
+        prefix, suffix = ET.tostring(root, encoding="unicode").split("<!--classes-->")
+        with self._classes, open(self.output_file, "w", encoding="utf-8") as f:
+            f.write("<?xml version='1.0' encoding='utf-8'?>\n")
+            f.write(prefix)
+            self._classes.seek(0)
+            shutil.copyfileobj(self._classes, f)
+            f.write(suffix)
+
+    def _render_class(self, filename: str, file_data: Dict[str, Any], project_root: str) -> str:
+        """
+        Serialize one file's <class> element, in the same form ElementTree would.
+        """
+        rel_name = os.path.relpath(filename, project_root)
+        stmt = file_data['Statement']
+        file_line_rate = stmt['pct'] / 100.0
+
+        branch = file_data.get('Branch')
+        file_branch_rate = (branch['pct'] / 100.0) if branch else 0.0
+
+        parts = [
+            f'<class name={_attr(rel_name.replace(".py", ""))} filename={_attr(rel_name)} '
+            f'line-rate="{file_line_rate}" branch-rate="{file_branch_rate}" complexity="0"><lines>'
+        ]
+
+        all_lines = stmt['possible']
+        executed = stmt['executed']
+
+        branch_map = collections.defaultdict(list)
+        executed_branches = set()
+        if branch:
+            for start, end in branch['possible']:
+                branch_map[start].append(end)
+            executed_branches = set(branch['executed'])
+
+        for lineno in sorted(all_lines):
+            hits = 1 if lineno in executed else 0
+
+            if lineno in branch_map:
+                targets = branch_map[lineno]
+
+                covered_count = 0
+                for t in targets:
+                    if (lineno, t) in executed_branches:
+                        covered_count += 1
+
+                coverage_percent = int((covered_count / len(targets)) * 100)
+                parts.append(f'<line number="{lineno}" hits="{hits}" branch="true" '
+                             f'condition-coverage="{coverage_percent}% ({covered_count}/{len(targets)})" />')
+            else:
+                parts.append(f'<line number="{lineno}" hits="{hits}" branch="false" />')
+
+        parts.append('</lines></class>')
+        return "".join(parts)
+
+
+def _attr(value: str) -> str:
+    return '"' + escape(value, _ATTR_ENTITIES) + '"'
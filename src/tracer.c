@@ -1,5 +1,249 @@
 #include <Python.h>
 #include <frameobject.h>
+#include <structmember.h>
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+
+#if PY_VERSION_HEX < 0x030B0000
+// PyFrame_GetLasti was added in 3.11, older frames expose f_lasti in code units
+static inline int PyFrame_GetLasti(PyFrameObject *frame) {
+    return frame->f_lasti < 0 ? -1 : frame->f_lasti * (int)sizeof(_Py_CODEUNIT);
+}
+#endif
+
+#if PY_VERSION_HEX >= 0x030C0000
+#define Code_RequestExtraIndex PyUnstable_Eval_RequestCodeExtraIndex
+#define Code_GetExtra PyUnstable_Code_GetExtra
+#define Code_SetExtra PyUnstable_Code_SetExtra
+#else
+#define Code_RequestExtraIndex _PyEval_RequestCodeExtraIndex
+#define Code_GetExtra _PyCode_GetExtra
+#define Code_SetExtra _PyCode_SetExtra
+#endif
+
+/*
+ * Native hit buffers.
+ *
+ * Every recorded event is a (file, context, a, b) record stored in an open-addressing
+ * hash set. Lines use (lineno, 0), arcs use (start, end) and instruction arcs use
+ * (from_offset, to_offset). Nothing on the per-event path allocates Python objects;
+ * records are converted into TraceContainer sets by Tracer.drain().
+ *
+ * In count mode line and arc sets also keep a uint64_t execution counter per slot,
+ * drained into the TraceContainer's Counters.
+ */
+
+#define HIT_EMPTY UINT32_MAX
+#define HIT_INITIAL_CAPACITY 256
+#define HIT_SMALL_CAPACITY 8     // per-code sets, which hold a few records each
+
+typedef struct {
+    uint32_t file;
+    uint32_t ctx;
+    int32_t a;
+    int32_t b;
+} HitKey;
+
+typedef struct {
+    HitKey *slots;
+    size_t capacity;  // always a power of two
+    size_t size;
+    uint64_t adds;    // hitset_add() calls, new or duplicate (for Tracer.stats())
+    uint64_t *counts; // executions per slot, allocated by the first hitset_count(); NULL otherwise
+} HitSet;
+
+static inline size_t hit_hash(uint32_t file, uint32_t ctx, int32_t a, int32_t b) {
+    uint64_t h = (((uint64_t)file << 32) | ctx) * 0x9E3779B97F4A7C15ULL;
+    h ^= (((uint64_t)(uint32_t)a << 32) | (uint32_t)b) + 0xBF58476D1CE4E5B9ULL + (h << 6) + (h >> 2);
+    h ^= h >> 31;
+    h *= 0x94D049BB133111EBULL;
+    h ^= h >> 29;
+    return (size_t)h;
+}
+
+static HitKey* hitset_alloc_slots(size_t capacity) {
+    HitKey *slots = PyMem_Malloc(capacity * sizeof(HitKey));
+    if (slots) {
+        // all bits set marks a slot as empty (file == HIT_EMPTY)
+        memset(slots, 0xFF, capacity * sizeof(HitKey));
+    }
+    return slots;
+}
+
+static int hitset_resize(HitSet *set, size_t new_capacity) {
+    HitKey *new_slots = hitset_alloc_slots(new_capacity);
+    uint64_t *new_counts = set->counts ? PyMem_Calloc(new_capacity, sizeof(uint64_t)) : NULL;
+    if (!new_slots || (set->counts && !new_counts)) {
+        PyMem_Free(new_slots);
+        PyErr_NoMemory();
+        return -1;
+    }
+
+    size_t mask = new_capacity - 1;
+    for (size_t i = 0; i < set->capacity; i++) {
+        HitKey *k = &set->slots[i];
+        if (k->file == HIT_EMPTY) continue;
+        size_t pos = hit_hash(k->file, k->ctx, k->a, k->b) & mask;
+        while (new_slots[pos].file != HIT_EMPTY) {
+            pos = (pos + 1) & mask;
+        }
+        new_slots[pos] = *k;
+        if (new_counts) new_counts[pos] = set->counts[i];
+    }
+
+    PyMem_Free(set->slots);
+    PyMem_Free(set->counts);
+    set->slots = new_slots;
+    set->counts = new_counts;
+    set->capacity = new_capacity;
+    return 0;
+}
+
+static int hitset_grow(HitSet *set) {
+    return hitset_resize(set, set->capacity ? set->capacity * 2 : HIT_INITIAL_CAPACITY);
+}
+
+// returns the slot holding the record, or -1 on memory error; *added tells whether it is new
+static inline Py_ssize_t hitset_slot(HitSet *set, uint32_t file, uint32_t ctx, int32_t a, int32_t b, int *added) {
+    set->adds++;
+    // keep load factor below 3/4
+    if ((set->size + 1) * 4 > set->capacity * 3) {
+        if (hitset_grow(set) < 0) return -1;
+    }
+
+    size_t mask = set->capacity - 1;
+    size_t pos = hit_hash(file, ctx, a, b) & mask;
+    for (;;) {
+        HitKey *k = &set->slots[pos];
+        if (k->file == HIT_EMPTY) {
+            k->file = file;
+            k->ctx = ctx;
+            k->a = a;
+            k->b = b;
+            set->size++;
+            *added = 1;
+            return (Py_ssize_t)pos;
+        }
+        if (k->file == file && k->ctx == ctx && k->a == a && k->b == b) {
+            *added = 0;
+            return (Py_ssize_t)pos;
+        }
+        pos = (pos + 1) & mask;
+    }
+}
+
+// returns 1 if the record is new, 0 if it was already present, -1 on memory error
+static int hitset_add(HitSet *set, uint32_t file, uint32_t ctx, int32_t a, int32_t b) {
+    int added;
+    if (hitset_slot(set, file, ctx, a, b, &added) < 0) return -1;
+    return added;
+}
+
+// like hitset_add(), and count one more execution of the record
+static int hitset_count(HitSet *set, uint32_t file, uint32_t ctx, int32_t a, int32_t b) {
+    int added;
+    Py_ssize_t pos = hitset_slot(set, file, ctx, a, b, &added);
+    if (pos < 0) return -1;
+    if (!set->counts) {
+        // records added before counting started keep a count of 0
+        set->counts = PyMem_Calloc(set->capacity, sizeof(uint64_t));
+        if (!set->counts) {
+            PyErr_NoMemory();
+            return -1;
+        }
+    }
+    set->counts[pos]++;
+    return added;
+}
+
+static void hitset_free(HitSet *set) {
+    PyMem_Free(set->slots);
+    PyMem_Free(set->counts);
+    set->slots = NULL;
+    set->counts = NULL;
+    set->capacity = 0;
+    set->size = 0;
+}
+
+/*
+ * Shared arena (shared_arena = true, see src/engine/arena.py).
+ *
+ * A region of a file-backed mapping shared by every process of a run: one bit per line
+ * and an open-addressing table of packed (kind, a, b) pair keys. Processes set hits in
+ * it with atomic operations instead of buffering them privately; context 0 only, other
+ * contexts and hits that do not fit go to the HitSets as usual.
+ */
+#if defined(__GNUC__) || defined(__clang__)
+#define ARENA_ATOMICS 1
+#endif
+
+#define ARENA_ARC 0ULL
+#define ARENA_INSTRUCTION_ARC 1ULL
+
+typedef struct {
+    uint64_t *lines;     // bit per line number, NULL when the file has no region
+    uint64_t *pairs;     // pair keys ((kind << 62) | (a << 31) | b) + 1, 0 is an empty slot
+    uint32_t nlines;
+    uint32_t pair_mask;  // table capacity - 1, a power of two
+    char resolved;       // engine._arena_region() was asked for this file id
+} ArenaRegion;
+
+// arc-tracking history of one frame: where its previous traced event was
+typedef struct {
+    PyCodeObject *code;  // code object of the previous traced event, NULL after a reset
+    int line;            // -1 when unset
+    int lasti;           // -1 when unset
+} FrameHistory;
+
+/*
+ * Arc-tracking history of one stack of frames. A frame starting or resuming pushes its
+ * caller's history and a returning, yielding or unwinding one pops it, so the caller's
+ * arc chain continues across the call. Coroutines interleaved by an event loop nest the
+ * same way on their thread; greenlets, which swap whole stacks, each get their own
+ * ArcHistory (see Tracer_greenlet_switch).
+ */
+typedef struct {
+    FrameHistory current;
+    FrameHistory *callers;  // innermost caller last
+    int depth;
+    int capacity;
+} ArcHistory;
+
+/*
+ * Per-thread collection state. Each OS thread records into its own buffers, so events
+ * never contend on shared containers; buffers are merged when drained.
+ *
+ * The arc-tracking history lives here as plain ints, so the hot path never touches
+ * Python attributes. Code objects in it are only compared, never dereferenced.
+ */
+typedef struct ThreadState {
+    PyThreadState *tstate;
+    ArcHistory history;
+    int64_t context_id;       // per-thread context set by set_thread_context(), -1 for the tracer-wide one
+    HitSet lines;
+    HitSet arcs;
+    HitSet instr_arcs;
+    struct ThreadState *next;
+} ThreadState;
+
+// self-metrics kept by every Tracer, reported by Tracer.stats()
+enum {
+    // settrace events, indexed like PyTrace_CALL..PyTrace_RETURN
+    STAT_CALL, STAT_EXCEPTION, STAT_LINE, STAT_RETURN,
+    STAT_OPCODE,
+    // sys.monitoring callbacks
+    STAT_PY_START, STAT_PY_RESUME, STAT_MONITOR_LINE, STAT_BRANCH, STAT_JUMP,
+    STAT_PY_RETURN,     // PY_RETURN, PY_YIELD and PY_UNWIND of traced code
+    STAT_FILTERED,      // events of code that is not traced (outside the project, omitted, sampled out)
+    STAT_SHOULD_TRACE,  // engine._should_trace() calls, i.e. cache_traceable misses
+    STAT_COUNT
+};
+
+static const char *stat_event_names[STAT_FILTERED] = {
+    "call", "exception", "line", "return", "opcode",
+    "py_start", "py_resume", "monitor_line", "branch", "jump", "py_return",
+};
 
 typedef struct {
     PyObject_HEAD
@@ -7,187 +251,834 @@ typedef struct {
     PyObject *trace_data_lines;
     PyObject *trace_data_arcs;
     PyObject *trace_data_instr_arcs;
-    PyObject *engine_thread_local;
+    PyObject *trace_data_line_counts;  // {filename: {context_id: Counter}}, filled in count mode
+    PyObject *trace_data_arc_counts;
     PyObject *cache_traceable;
+    PyObject *file_index;  // FileTable.index, {filename: file id}
+    PyObject *file_names;  // FileTable.paths, position is the file id
+    ThreadState *threads;
+    ThreadState *current_thread;  // last used entry, hit on almost every event
+    PyObject *greenlet_histories; // {address of a suspended greenlet: capsule of its ArcHistory}
+    uint64_t serial;              // identifies this instance in per-code caches
+    char started;                 // the native trace hook is installed by Tracer.start()
+    uint32_t context_id;          // active context, pushed by MiniCoverage.switch_context()
+    // sys.monitoring objects (Python 3.12+), NULL on older versions
+    PyObject *monitoring_disable;
+    PyObject *monitoring_tool;
+    PyObject *set_local_events;
+    PyObject *local_events;            // LINE | BRANCH | PY_RESUME | PY_RETURN | PY_YIELD
+    PyObject *local_events_first_hit;  // LINE | BRANCH | JUMP
+    char flow_stop[256];               // opcodes ending straight-line flow (jumps, returns, raises)
+    char first_hit;                    // record each location once, then DISABLE it
+    char count_hits;                   // count executions of lines and arcs (collection_mode = count)
+    double sample_rate;                // fraction of traceable code objects recorded (sampled mode)
+    uint64_t sample_state;             // splitmix64 state for the per-code sampling draw
+    // self-metrics: plain increments under the GIL, see Tracer.stats()
+    uint64_t stats[STAT_COUNT];
+    uint64_t drained_adds;     // hitset_add() calls of already drained buffers
+    uint64_t drained_records;  // distinct records of already drained buffers
+    size_t peak_pending;       // largest buffered record count seen at a drain
+    uint64_t *file_events;     // events of traced code per file id
+    size_t file_events_capacity;
+    // shared arena attached by attach_arena(), see ArenaRegion
+    Py_buffer arena;
+    char arena_attached;
+    ArenaRegion *arena_regions;  // by file id
+    size_t arena_regions_capacity;
+    uint64_t arena_overflows;    // pairs that found an arena table full
 } Tracer;
 
-static PyObject* get_context_id(Tracer *self) {
-    return PyObject_CallMethod(self->engine, "_get_current_context_id", NULL);
+/*
+ * Per-code-object cache kept in the code object's co_extra slot, so the traceability
+ * decision is made once per code object instead of once per event. Entries are stamped
+ * with the serial of the Tracer that filled them; an entry left behind by another
+ * instance is simply re-evaluated.
+ */
+typedef struct {
+    uint64_t serial;
+    int32_t file;       // interned file index, -1 when the code is not traceable
+    char local_events;  // sys.monitoring local events enabled for this code: 0 none, 1 full, 2 first-hit
+    char jumps_scanned;       // jump_map below has been computed; kept across Tracer instances
+    unsigned char *jump_map;  // one bit per code unit marking boolean jumps, NULL if the code has none
+    HitSet branch_seen;       // sys.monitoring branch destinations recorded for this code, by context
+} CodeInfo;
+
+static Py_ssize_t code_extra_index = -1;
+static uint64_t next_tracer_serial = 1;
+
+// opcodes ConditionCoverage._analyze_boolean_jumps measures, filled from dis.opmap at import
+static char boolean_jump_ops[256];
+// RESUME opcode (3.11+), -1 where it does not exist
+static int resume_op = -1;
+
+static void free_code_info(void *ptr) {
+    CodeInfo *info = ptr;
+    if (info) {
+        PyMem_Free(info->jump_map);
+        hitset_free(&info->branch_seen);
+        PyMem_Free(info);
+    }
 }
 
-static int handle_call_or_return(Tracer *self, PyFrameObject *frame, int what) {
-    if (what == PyTrace_CALL) {
-        if (PyObject_SetAttrString((PyObject*)frame, "f_trace_opcodes", Py_True) < 0) {
+static inline void reset_history(ThreadState *ts) {
+    ts->history.current.code = NULL;
+    ts->history.current.line = -1;
+    ts->history.current.lasti = -1;
+}
+
+// forget the whole stack, e.g. of a thread whose PyThreadState was reused
+static void clear_history(ThreadState *ts) {
+    ts->history.depth = 0;
+    reset_history(ts);
+}
+
+/*
+ * A frame starts: keep the caller's history and start an empty one or, for a resumed
+ * generator or coroutine (resume_line >= 0), one ending on the line it was suspended on.
+ */
+static int enter_frame(ThreadState *ts, PyCodeObject *code, int resume_line) {
+    ArcHistory *h = &ts->history;
+    if (h->depth == h->capacity) {
+        int capacity = h->capacity ? h->capacity * 2 : 32;
+        FrameHistory *callers = PyMem_Realloc(h->callers, (size_t)capacity * sizeof(FrameHistory));
+        if (!callers) {
+            PyErr_NoMemory();
             return -1;
         }
+        h->callers = callers;
+        h->capacity = capacity;
     }
-    // clear history to prevent cross-function arcs for both CALL and RETURN
-    if (PyObject_SetAttrString(self->engine_thread_local, "last_line", Py_None) < 0) return -1;
-    if (PyObject_SetAttrString(self->engine_thread_local, "last_file", Py_None) < 0) return -1;
-    if (PyObject_SetAttrString(self->engine_thread_local, "last_lasti", Py_None) < 0) return -1;
+    h->callers[h->depth++] = h->current;
+    h->current.code = resume_line >= 0 ? code : NULL;
+    h->current.line = resume_line;
+    h->current.lasti = -1;
     return 0;
 }
 
-static int trace_logic(Tracer *self, PyFrameObject *frame, int what, PyObject *arg) {
+// the current frame returned, yielded or unwound: continue its caller's history
+static inline void exit_frame(ThreadState *ts) {
+    ArcHistory *h = &ts->history;
+    if (h->depth > 0) {
+        h->current = h->callers[--h->depth];
+    } else {
+        // the frame started before tracing did
+        reset_history(ts);
+    }
+}
 
-    if (what == PyTrace_CALL || what == PyTrace_RETURN)
-        return handle_call_or_return(self, frame, what);
+static ThreadState* get_thread_state(Tracer *self) {
+    PyThreadState *tstate = PyThreadState_Get();
+    if (self->current_thread && self->current_thread->tstate == tstate) {
+        return self->current_thread;
+    }
 
-    if (what != PyTrace_LINE && what != PyTrace_OPCODE) {
-        return 0;
+    ThreadState *ts = self->threads;
+    while (ts && ts->tstate != tstate) {
+        ts = ts->next;
     }
 
-    // get filename
-    PyObject *code = PyObject_GetAttrString((PyObject*)frame, "f_code");
-    if (!code) return -1;
+    if (!ts) {
+        ts = PyMem_Calloc(1, sizeof(ThreadState));
+        if (!ts) {
+            PyErr_NoMemory();
+            return NULL;
+        }
+        ts->tstate = tstate;
+        ts->context_id = -1;
+        reset_history(ts);
+        ts->next = self->threads;
+        self->threads = ts;
+    }
 
-    PyObject *filename = PyObject_GetAttrString(code, "co_filename");
-    Py_DECREF(code);
-    if (!filename) return -1;
+    self->current_thread = ts;
+    return ts;
+}
 
-    // cache check
-    int cached = PyDict_Contains(self->cache_traceable, filename);
-    if (cached == -1) {
-        Py_DECREF(filename);
+// returns the interned index of filename, assigning a new one on first sight
+static long get_file_index(Tracer *self, PyObject *filename) {
+    PyObject *idx = PyDict_GetItemWithError(self->file_index, filename);
+    if (idx) {
+        return PyLong_AsLong(idx);
+    }
+    if (PyErr_Occurred()) return -1;
+
+    Py_ssize_t new_idx = PyList_GET_SIZE(self->file_names);
+    idx = PyLong_FromSsize_t(new_idx);
+    if (!idx) return -1;
+
+    if (PyDict_SetItem(self->file_index, filename, idx) < 0 || PyList_Append(self->file_names, filename) < 0) {
+        Py_DECREF(idx);
         return -1;
     }
+    Py_DECREF(idx);
+    return (long)new_idx;
+}
+
+// contexts only change on switch_context(), so the hot path reads a plain int
+static inline uint32_t get_context_id(Tracer *self, ThreadState *ts) {
+    return ts->context_id >= 0 ? (uint32_t)ts->context_id : self->context_id;
+}
 
-    if (cached == 0) {
-        PyObject *should = PyObject_CallMethod(self->engine, "_should_trace", "O", filename);
-        if (!should) {
-            Py_DECREF(filename);
+// returns 1 if filename should be traced, 0 if not, -1 on error
+static int check_traceable(Tracer *self, PyObject *filename) {
+    PyObject *cached = PyDict_GetItemWithError(self->cache_traceable, filename);
+    if (!cached) {
+        if (PyErr_Occurred()) return -1;
+
+        self->stats[STAT_SHOULD_TRACE]++;
+        cached = PyObject_CallMethod(self->engine, "_should_trace", "O", filename);
+        if (!cached) return -1;
+        if (PyDict_SetItem(self->cache_traceable, filename, cached) < 0) {
+            Py_DECREF(cached);
             return -1;
         }
-        if (PyDict_SetItem(self->cache_traceable, filename, should) < 0) {
-            Py_DECREF(should);
-            Py_DECREF(filename);
+        Py_DECREF(cached);
+    }
+    return cached == Py_True;
+}
+
+// uniform double in [0, 1)
+static double next_sample(Tracer *self) {
+    uint64_t z = (self->sample_state += 0x9E3779B97F4A7C15ULL);
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+    z ^= z >> 31;
+    return (double)(z >> 11) * (1.0 / 9007199254740992.0);
+}
+
+/*
+ * Find the arena region of a file id once, through engine._arena_region(filename):
+ * None for files the arena has no region for, else (lines offset, line count,
+ * pairs offset, pairs capacity) within the attached buffer.
+ */
+static int resolve_arena_region(Tracer *self, long file, PyObject *filename) {
+    if ((size_t)file >= self->arena_regions_capacity) {
+        size_t capacity = self->arena_regions_capacity ? self->arena_regions_capacity : 64;
+        while (capacity <= (size_t)file) capacity *= 2;
+        ArenaRegion *grown = PyMem_Realloc(self->arena_regions, capacity * sizeof(ArenaRegion));
+        if (!grown) {
+            PyErr_NoMemory();
             return -1;
         }
-        Py_DECREF(should);
+        memset(grown + self->arena_regions_capacity, 0,
+               (capacity - self->arena_regions_capacity) * sizeof(ArenaRegion));
+        self->arena_regions = grown;
+        self->arena_regions_capacity = capacity;
     }
+    ArenaRegion *region = &self->arena_regions[file];
+    if (region->resolved) return 0;
 
-    PyObject *is_traceable = PyDict_GetItem(self->cache_traceable, filename);
-    if (is_traceable != Py_True) {
-        Py_DECREF(filename);
+    PyObject *found = PyObject_CallMethod(self->engine, "_arena_region", "O", filename);
+    if (!found) return -1;
+    region->resolved = 1;
+    if (found == Py_None) {
+        Py_DECREF(found);
         return 0;
     }
 
-    // get context ID
-    PyObject *cid = get_context_id(self);
-    if (!cid) {
-        Py_DECREF(filename);
+    unsigned long long lines_offset, pairs_offset, capacity;
+    unsigned int nlines;
+    int ok = PyArg_ParseTuple(found, "KIKK", &lines_offset, &nlines, &pairs_offset, &capacity);
+    Py_DECREF(found);
+    if (!ok) return -1;
+
+    unsigned long long size = (unsigned long long)self->arena.len;
+    unsigned long long words = nlines / 64 + 1;
+    if (lines_offset % 8 || pairs_offset % 8 || !capacity || capacity & (capacity - 1) || capacity > UINT32_MAX ||
+        lines_offset > size || words > (size - lines_offset) / 8 ||
+        pairs_offset > size || capacity > (size - pairs_offset) / 8) {
+        PyErr_Format(PyExc_ValueError, "arena region of %R lies outside the arena", filename);
         return -1;
     }
+    char *base = self->arena.buf;
+    region->lines = (uint64_t *)(base + lines_offset);
+    region->pairs = (uint64_t *)(base + pairs_offset);
+    region->nlines = nlines;
+    region->pair_mask = (uint32_t)(capacity - 1);
+    return 0;
+}
+
+static CodeInfo* get_code_info(Tracer *self, PyCodeObject *code) {
+    void *extra = NULL;
+    if (Code_GetExtra((PyObject*)code, code_extra_index, &extra) < 0) return NULL;
 
-    // initialize thread local if needed
-    if (!PyObject_HasAttrString(self->engine_thread_local, "last_line")) {
-        PyObject_SetAttrString(self->engine_thread_local, "last_line", Py_None);
-        PyObject_SetAttrString(self->engine_thread_local, "last_file", Py_None);
-        PyObject_SetAttrString(self->engine_thread_local, "last_lasti", Py_None);
+    CodeInfo *info = extra;
+    if (info && info->serial == self->serial) {
+        return info;
     }
 
-    if (what == PyTrace_LINE) {
-        if (handle_line_event(self, frame, filename, cid) < 0) {
-            Py_DECREF(cid);
-            Py_DECREF(filename);
-            return -1;
+    if (!info) {
+        info = PyMem_Malloc(sizeof(CodeInfo));
+        if (!info) {
+            PyErr_NoMemory();
+            return NULL;
+        }
+        info->serial = 0;
+        info->jumps_scanned = 0;
+        info->jump_map = NULL;
+        memset(&info->branch_seen, 0, sizeof(HitSet));
+        if (Code_SetExtra((PyObject*)code, code_extra_index, info) < 0) {
+            PyMem_Free(info);
+            return NULL;
         }
     }
 
-    // handle OPCODE event (MC/DC) - runs for both LINE and OPCODE events
-    if (handle_opcode_event(self, frame, filename, cid) < 0) {
-        Py_DECREF(cid);
-        Py_DECREF(filename);
-        return -1;
+    int traceable = check_traceable(self, code->co_filename);
+    if (traceable < 0) return NULL;
+
+    // sampled mode draws once per code object; the others are treated as untraceable
+    if (traceable && self->sample_rate < 1.0 && next_sample(self) >= self->sample_rate) {
+        traceable = 0;
     }
 
-    Py_DECREF(cid);
-    Py_DECREF(filename);
+    long file = -1;
+    if (traceable) {
+        file = get_file_index(self, code->co_filename);
+        if (file < 0) return NULL;
+        if ((size_t)file >= self->file_events_capacity) {
+            size_t capacity = self->file_events_capacity ? self->file_events_capacity : 64;
+            while (capacity <= (size_t)file) capacity *= 2;
+            uint64_t *grown = PyMem_Realloc(self->file_events, capacity * sizeof(uint64_t));
+            if (!grown) {
+                PyErr_NoMemory();
+                return NULL;
+            }
+            memset(grown + self->file_events_capacity, 0, (capacity - self->file_events_capacity) * sizeof(uint64_t));
+            self->file_events = grown;
+            self->file_events_capacity = capacity;
+        }
+        if (self->arena_attached && resolve_arena_region(self, file, code->co_filename) < 0) return NULL;
+    }
+
+    // context ids of another instance mean nothing to this one
+    hitset_free(&info->branch_seen);
+    info->file = (int32_t)file;
+    info->local_events = 0;
+    info->serial = self->serial;
+    return info;
+}
+
+/*
+ * Mark the offsets of boolean jumps in the code's bytecode. Only those frames need
+ * opcode events, and only arcs leaving those offsets are measured by MC/DC.
+ */
+static int scan_boolean_jumps(PyCodeObject *code, CodeInfo *info) {
+#if PY_VERSION_HEX >= 0x030B0000
+    PyObject *co_code = PyCode_GetCode(code);  // de-specialized bytecode
+#else
+    PyObject *co_code = Py_NewRef(code->co_code);
+#endif
+    if (!co_code) return -1;
+
+    const unsigned char *bytes = (const unsigned char *)PyBytes_AS_STRING(co_code);
+    Py_ssize_t units = PyBytes_GET_SIZE(co_code) / 2;
+    unsigned char *map = NULL;
+
+    for (Py_ssize_t i = 0; i < units; i++) {
+        if (!boolean_jump_ops[bytes[i * 2]]) continue;
+        if (!map) {
+            map = PyMem_Calloc((size_t)units / 8 + 1, 1);
+            if (!map) {
+                Py_DECREF(co_code);
+                PyErr_NoMemory();
+                return -1;
+            }
+        }
+        map[i >> 3] |= (unsigned char)(1 << (i & 7));
+    }
 
+    Py_DECREF(co_code);
+    info->jump_map = map;
+    info->jumps_scanned = 1;
     return 0;
 }
 
-static int handle_line_event(Tracer *self, PyFrameObject *frame, PyObject *filename, PyObject *cid) {
-    int lineno = PyFrame_GetLineNumber(frame);
-    PyObject *py_lineno = PyLong_FromLong(lineno);
+/*
+ * Line a generator or coroutine frame entered by a settrace CALL event was suspended on,
+ * -1 for a frame that just started, -2 on error. The first CALL of a 3.10 frame comes
+ * before its first instruction; 3.11+ frames start at a RESUME with oparg 0, while
+ * resumed ones continue at the RESUME following their yield.
+ */
+static int resume_line(PyFrameObject *frame, PyCodeObject *code) {
+    if (!(code->co_flags & (CO_GENERATOR | CO_COROUTINE | CO_ASYNC_GENERATOR | CO_ITERABLE_COROUTINE))) return -1;
 
-    // update lines
-    PyObject *file_dict = PyObject_GetItem(self->trace_data_lines, filename);
-    if (file_dict) {
-        PyObject *lines_set = PyObject_GetItem(file_dict, cid);
-        if (lines_set) {
-            PySet_Add(lines_set, py_lineno);
-            Py_DECREF(lines_set);
+    int lasti = PyFrame_GetLasti(frame);
+    if (lasti < 0) return -1;
+#if PY_VERSION_HEX >= 0x030B0000
+    PyObject *co_code = PyCode_GetCode(code);
+    if (!co_code) return -2;
+    const unsigned char *bytes = (const unsigned char *)PyBytes_AS_STRING(co_code);
+    int started = lasti + 1 < PyBytes_GET_SIZE(co_code) && bytes[lasti] == resume_op && bytes[lasti + 1] == 0;
+    Py_DECREF(co_code);
+    if (started) return -1;
+#endif
+    return PyFrame_GetLineNumber(frame);
+}
+
+static inline int is_boolean_jump(const CodeInfo *info, int offset) {
+    int unit = offset / 2;
+    return info->jump_map && (info->jump_map[unit >> 3] >> (unit & 7)) & 1;
+}
+
+// record a line in the shared arena; 0 when it belongs in the HitSets instead
+static inline int arena_add_line(Tracer *self, uint32_t file, uint32_t cid, int line) {
+#ifdef ARENA_ATOMICS
+    if (cid || file >= self->arena_regions_capacity) return 0;
+    ArenaRegion *region = &self->arena_regions[file];
+    if (!region->lines || line < 0 || (uint32_t)line > region->nlines) return 0;
+
+    uint64_t *word = region->lines + (line >> 6);
+    uint64_t bit = 1ULL << (line & 63);
+    // most lines are set already; only a miss pays for the locked instruction
+    if (!(__atomic_load_n(word, __ATOMIC_RELAXED) & bit)) {
+        __atomic_fetch_or(word, bit, __ATOMIC_RELAXED);
+    }
+    return 1;
+#else
+    return 0;
+#endif
+}
+
+// record an arc or instruction arc in the shared arena; 0 when it belongs in the HitSets
+static inline int arena_add_pair(Tracer *self, uint32_t file, uint32_t cid, uint64_t kind, int a, int b) {
+#ifdef ARENA_ATOMICS
+    if (cid || file >= self->arena_regions_capacity) return 0;
+    ArenaRegion *region = &self->arena_regions[file];
+    if (!region->pairs || a < 0 || b < 0) return 0;
+
+    uint64_t key = ((kind << 62) | ((uint64_t)a << 31) | (uint64_t)b) + 1;
+    uint32_t mask = region->pair_mask;
+    uint32_t slot = (uint32_t)((key * 0x9E3779B97F4A7C15ULL) >> 32) & mask;
+    for (uint32_t probes = 0; probes <= mask; probes++, slot = (slot + 1) & mask) {
+        uint64_t *entry = region->pairs + slot;
+        uint64_t seen = __atomic_load_n(entry, __ATOMIC_RELAXED);
+        if (seen == 0) {
+            // another process may claim the slot first, with this key or another one
+            if (__atomic_compare_exchange_n(entry, &seen, key, 0, __ATOMIC_RELAXED, __ATOMIC_RELAXED)) return 1;
         }
-        Py_DECREF(file_dict);
-    }
-
-    // update arcs
-    PyObject *last_file = PyObject_GetAttrString(self->engine_thread_local, "last_file");
-    PyObject *last_line = PyObject_GetAttrString(self->engine_thread_local, "last_line");
-
-    if (last_file && last_line && last_file != Py_None && last_line != Py_None) {
-        int cmp = PyObject_RichCompareBool(last_file, filename, Py_EQ);
-        if (cmp == 1) {
-            PyObject *file_arcs_dict = PyObject_GetItem(self->trace_data_arcs, filename);
-            if (file_arcs_dict) {
-                PyObject *arcs_set = PyObject_GetItem(file_arcs_dict, cid);
-                if (arcs_set) {
-                    PyObject *arc = PyTuple_Pack(2, last_line, py_lineno);
-                    PySet_Add(arcs_set, arc);
-                    Py_DECREF(arc);
-                    Py_DECREF(arcs_set);
-                }
-                Py_DECREF(file_arcs_dict);
-            }
+        if (seen == key) return 1;
+    }
+    self->arena_overflows++;
+    return 0;
+#else
+    return 0;
+#endif
+}
+
+static int record_line(Tracer *self, ThreadState *ts, PyCodeObject *code, uint32_t file, uint32_t cid, int lineno) {
+    FrameHistory *last = &ts->history.current;
+    int has_arc = last->code == code && last->line >= 0;
+
+    if (self->count_hits) {
+        if (hitset_count(&ts->lines, file, cid, lineno, 0) < 0) return -1;
+        if (has_arc && hitset_count(&ts->arcs, file, cid, last->line, lineno) < 0) return -1;
+    } else {
+        // update lines
+        if (!arena_add_line(self, file, cid, lineno) && hitset_add(&ts->lines, file, cid, lineno, 0) < 0) return -1;
+
+        // update arcs
+        if (has_arc && !arena_add_pair(self, file, cid, ARENA_ARC, last->line, lineno) &&
+            hitset_add(&ts->arcs, file, cid, last->line, lineno) < 0) {
+            return -1;
         }
     }
-    Py_XDECREF(last_file);
-    Py_XDECREF(last_line);
 
-    PyObject_SetAttrString(self->engine_thread_local, "last_line", py_lineno);
-    PyObject_SetAttrString(self->engine_thread_local, "last_file", filename);
-    Py_DECREF(py_lineno);
+    last->line = lineno;
+    last->code = code;
     return 0;
 }
 
-static int handle_opcode_event(Tracer *self, PyFrameObject *frame, PyObject *filename, PyObject *cid) {
-    // track instruction arcs: last_lasti -> current_lasti
-    int current_lasti_int = PyFrame_GetLasti(frame);
-    PyObject *current_lasti = PyLong_FromLong(current_lasti_int);
-
-    PyObject *last_lasti = PyObject_GetAttrString(self->engine_thread_local, "last_lasti");
-    PyObject *last_file_op = PyObject_GetAttrString(self->engine_thread_local, "last_file");
-
-    if (last_lasti && last_file_op && last_lasti != Py_None && last_file_op != Py_None) {
-        int cmp = PyObject_RichCompareBool(last_file_op, filename, Py_EQ);
-        if (cmp == 1) {
-            PyObject *file_instr_dict = PyObject_GetItem(self->trace_data_instr_arcs, filename);
-            if (file_instr_dict) {
-                PyObject *instr_set = PyObject_GetItem(file_instr_dict, cid);
-                if (instr_set) {
-                    PyObject *arc = PyTuple_Pack(2, last_lasti, current_lasti);
-                    PySet_Add(instr_set, arc);
-                    Py_DECREF(arc);
-                    Py_DECREF(instr_set);
-                }
-                Py_DECREF(file_instr_dict);
+// count an event of code with the given CodeInfo; returns 0 if the code is not traced
+static inline int count_event(Tracer *self, const CodeInfo *info, int stat) {
+    self->stats[stat]++;
+    if (info->file < 0) {
+        self->stats[STAT_FILTERED]++;
+        return 0;
+    }
+    self->file_events[info->file]++;
+    return 1;
+}
+
+static int handle_line_event(Tracer *self, ThreadState *ts, PyFrameObject *frame, PyCodeObject *code,
+                             uint32_t file, uint32_t cid);
+static int handle_opcode_event(Tracer *self, ThreadState *ts, PyFrameObject *frame, PyCodeObject *code,
+                               const CodeInfo *info, uint32_t file, uint32_t cid);
+
+static int handle_call_or_return(Tracer *self, PyFrameObject *frame, PyCodeObject *code, CodeInfo *info, int what) {
+    if (what == PyTrace_CALL) {
+        if (!info->jumps_scanned && scan_boolean_jumps(code, info) < 0) return -1;
+
+        // per-instruction events only pay off where there is a boolean jump to measure
+        if (info->jump_map) {
+#if PY_VERSION_HEX >= 0x030D0000
+            // 3.13+ only arms INSTRUCTION events for frames with a local trace function;
+            // the native hook does not call it, it just has to be set
+            if (PyObject_SetAttrString((PyObject*)frame, "f_trace", (PyObject*)self) < 0) return -1;
+#endif
+            if (PyObject_SetAttrString((PyObject*)frame, "f_trace_opcodes", Py_True) < 0) return -1;
+        }
+    }
+
+    ThreadState *ts = get_thread_state(self);
+    if (!ts) return -1;
+
+    // a new history per frame prevents cross-function arcs; RETURN (also sent for a
+    // yield or an unwinding exception) brings the caller's back
+    if (what == PyTrace_RETURN) {
+        exit_frame(ts);
+        return 0;
+    }
+    int line = resume_line(frame, code);
+    if (line == -2) return -1;
+    return enter_frame(ts, code, line);
+}
+
+/*
+ * Returns 0 to keep tracing the frame, 1 when the frame is not traceable and its
+ * local trace function should be dropped, -1 on error.
+ */
+static int trace_logic(Tracer *self, PyFrameObject *frame, int what, PyObject *arg) {
+    PyCodeObject *code = PyFrame_GetCode(frame);
+
+    // the traceability decision is made once per code object and kept in co_extra
+    CodeInfo *info = get_code_info(self, code);
+    if (!info) {
+        Py_DECREF(code);
+        return -1;
+    }
+    // anything else (unknown event strings) is counted with exceptions
+    int stat = what == PyTrace_OPCODE ? STAT_OPCODE : (what >= 0 && what <= PyTrace_RETURN ? what : STAT_EXCEPTION);
+    if (!count_event(self, info, stat)) {
+        Py_DECREF(code);
+        return 1;
+    }
+
+    int result = 0;
+    if (what == PyTrace_CALL || what == PyTrace_RETURN) {
+        result = handle_call_or_return(self, frame, code, info, what);
+    }
+    else if (what == PyTrace_LINE || what == PyTrace_OPCODE) {
+        uint32_t file = (uint32_t)info->file;
+        ThreadState *ts = get_thread_state(self);
+
+        result = -1;
+        if (ts) {
+            uint32_t cid = get_context_id(self, ts);
+            result = 0;
+            if (what == PyTrace_LINE) {
+                result = handle_line_event(self, ts, frame, code, file, cid);
+            }
+            // handle OPCODE event (MC/DC) - runs for both LINE and OPCODE events
+            if (result == 0 && info->jump_map) {
+                result = handle_opcode_event(self, ts, frame, code, info, file, cid);
             }
         }
     }
-    Py_XDECREF(last_lasti);
-    Py_XDECREF(last_file_op);
+
+    Py_DECREF(code);
+    return result;
+}
+
+static int handle_line_event(Tracer *self, ThreadState *ts, PyFrameObject *frame, PyCodeObject *code,
+                             uint32_t file, uint32_t cid) {
+    return record_line(self, ts, code, file, cid, PyFrame_GetLineNumber(frame));
+}
+
+static int handle_opcode_event(Tracer *self, ThreadState *ts, PyFrameObject *frame, PyCodeObject *code,
+                               const CodeInfo *info, uint32_t file, uint32_t cid) {
+    // track instruction arcs: last_lasti -> current_lasti, leaving a boolean jump only
+    int current_lasti = PyFrame_GetLasti(frame);
+    FrameHistory *last = &ts->history.current;
+
+    if (last->code == code && last->lasti >= 0 && is_boolean_jump(info, last->lasti)) {
+        if (!arena_add_pair(self, file, cid, ARENA_INSTRUCTION_ARC, last->lasti, current_lasti) &&
+            hitset_add(&ts->instr_arcs, file, cid, last->lasti, current_lasti) < 0) {
+            return -1;
+        }
+    }
 
     // update state
-    PyObject_SetAttrString(self->engine_thread_local, "last_lasti", current_lasti);
-    PyObject_SetAttrString(self->engine_thread_local, "last_file", filename);
+    last->lasti = current_lasti;
+    last->code = code;
+    return 0;
+}
+
+// target[filename][context id], creating the entries through the defaultdicts
+static PyObject* get_bucket(Tracer *self, PyObject *target, const HitKey *k) {
+    PyObject *filename = PyList_GET_ITEM(self->file_names, k->file);
+    PyObject *per_file = PyObject_GetItem(target, filename);
+    if (!per_file) return NULL;
+    PyObject *ctx = PyLong_FromUnsignedLong(k->ctx);
+    if (!ctx) {
+        Py_DECREF(per_file);
+        return NULL;
+    }
+    PyObject *bucket = PyObject_GetItem(per_file, ctx);
+    Py_DECREF(ctx);
+    Py_DECREF(per_file);
+    return bucket;
+}
+
+// counter[value] += count on a Counter (a dict subclass), without calling __missing__
+static int add_count(PyObject *counter, PyObject *value, uint64_t count) {
+    PyObject *current = PyDict_GetItemWithError(counter, value);
+    if (!current && PyErr_Occurred()) return -1;
+
+    PyObject *total;
+    if (current) {
+        PyObject *delta = PyLong_FromUnsignedLongLong(count);
+        if (!delta) return -1;
+        total = PyNumber_Add(current, delta);
+        Py_DECREF(delta);
+    } else {
+        total = PyLong_FromUnsignedLongLong(count);
+    }
+    if (!total) return -1;
+    int result = PyDict_SetItem(counter, value, total);
+    Py_DECREF(total);
+    return result;
+}
+
+/*
+ * Move the records of one hit set into the matching TraceContainer mapping
+ * ({filename: {context_id: set}}). Pairs are stored as (a, b) tuples, lines as ints.
+ * Counted records are also added to count_target's Counters.
+ */
+static int drain_hitset(Tracer *self, HitSet *set, PyObject *target, PyObject *count_target, int pairs) {
+    PyObject *bucket = NULL;
+    PyObject *counter = NULL;
+    uint32_t bucket_file = HIT_EMPTY;
+    uint32_t bucket_ctx = HIT_EMPTY;
+    int counting = set->counts && count_target;
+    int result = 0;
+
+    for (size_t i = 0; i < set->capacity; i++) {
+        HitKey *k = &set->slots[i];
+        if (k->file == HIT_EMPTY) continue;
+
+        // records of the same file/context usually cluster, so cache the last bucket
+        if (!bucket || k->file != bucket_file || k->ctx != bucket_ctx) {
+            Py_CLEAR(bucket);
+            Py_CLEAR(counter);
+            bucket = get_bucket(self, target, k);
+            if (!bucket || (counting && !(counter = get_bucket(self, count_target, k)))) {
+                result = -1;
+                break;
+            }
+            if (counter && !PyDict_Check(counter)) {
+                PyErr_SetString(PyExc_TypeError, "hit counts must be stored in Counters");
+                result = -1;
+                break;
+            }
+            bucket_file = k->file;
+            bucket_ctx = k->ctx;
+        }
+
+        PyObject *value = pairs ? Py_BuildValue("(ii)", k->a, k->b) : PyLong_FromLong(k->a);
+        if (!value || PySet_Add(bucket, value) < 0 ||
+                (counting && set->counts[i] && add_count(counter, value, set->counts[i]) < 0)) {
+            Py_XDECREF(value);
+            result = -1;
+            break;
+        }
+        Py_DECREF(value);
+    }
+
+    Py_XDECREF(bucket);
+    Py_XDECREF(counter);
+    return result;
+}
+
+static size_t pending_records(Tracer *self) {
+    size_t total = 0;
+    for (ThreadState *ts = self->threads; ts; ts = ts->next) {
+        total += ts->lines.size + ts->arcs.size + ts->instr_arcs.size;
+    }
+    return total;
+}
+
+static PyObject *
+Tracer_drain(Tracer *self, PyObject *Py_UNUSED(ignored)) {
+    int result = 0;
+
+    size_t pending = pending_records(self);
+    if (pending > self->peak_pending) self->peak_pending = pending;
+
+    for (ThreadState *ts = self->threads; ts; ts = ts->next) {
+        // detach the buffers first: draining runs Python code (defaultdict factories)
+        // which may itself be traced and record into fresh buffers
+        HitSet lines = ts->lines;
+        HitSet arcs = ts->arcs;
+        HitSet instr_arcs = ts->instr_arcs;
+        memset(&ts->lines, 0, sizeof(HitSet));
+        memset(&ts->arcs, 0, sizeof(HitSet));
+        memset(&ts->instr_arcs, 0, sizeof(HitSet));
+
+        self->drained_adds += lines.adds + arcs.adds + instr_arcs.adds;
+        self->drained_records += lines.size + arcs.size + instr_arcs.size;
+
+        if (result == 0) result = drain_hitset(self, &lines, self->trace_data_lines, self->trace_data_line_counts, 0);
+        if (result == 0) result = drain_hitset(self, &arcs, self->trace_data_arcs, self->trace_data_arc_counts, 1);
+        if (result == 0) result = drain_hitset(self, &instr_arcs, self->trace_data_instr_arcs, NULL, 1);
+
+        hitset_free(&lines);
+        hitset_free(&arcs);
+        hitset_free(&instr_arcs);
+    }
+
+    if (result < 0) return NULL;
+    Py_RETURN_NONE;
+}
+
+static PyObject *
+Tracer_pending(Tracer *self, PyObject *Py_UNUSED(ignored)) {
+    return PyLong_FromSize_t(pending_records(self));
+}
+
+static PyObject *
+Tracer_detach_arena(Tracer *self, PyObject *Py_UNUSED(ignored)) {
+    if (self->arena_attached) {
+        PyBuffer_Release(&self->arena);
+        self->arena_attached = 0;
+    }
+    PyMem_Free(self->arena_regions);
+    self->arena_regions = NULL;
+    self->arena_regions_capacity = 0;
+    Py_RETURN_NONE;
+}
+
+/*
+ * Record into a shared arena from now on: buffer is a writable mapping laid out by
+ * src/engine/arena.py. Cached per-code decisions are dropped, so every file resolves
+ * its region on its next event.
+ */
+static PyObject *
+Tracer_attach_arena(Tracer *self, PyObject *buffer) {
+#ifdef ARENA_ATOMICS
+    Py_buffer view;
+    if (PyObject_GetBuffer(buffer, &view, PyBUF_WRITABLE | PyBUF_SIMPLE) < 0) return NULL;
+    if ((uintptr_t)view.buf % 8) {
+        PyBuffer_Release(&view);
+        PyErr_SetString(PyExc_ValueError, "arena buffer must be 8-byte aligned");
+        return NULL;
+    }
+    Tracer_detach_arena(self, NULL);
+    self->arena = view;
+    self->arena_attached = 1;
+    self->serial = next_tracer_serial++;
+    Py_RETURN_NONE;
+#else
+    PyErr_SetString(PyExc_NotImplementedError, "shared arenas need compiler atomics");
+    return NULL;
+#endif
+}
+
+static int set_stat(PyObject *dict, const char *key, unsigned long long value) {
+    PyObject *v = PyLong_FromUnsignedLongLong(value);
+    if (!v) return -1;
+    int result = PyDict_SetItemString(dict, key, v);
+    Py_DECREF(v);
+    return result;
+}
+
+static PyObject *
+Tracer_stats(Tracer *self, PyObject *Py_UNUSED(ignored)) {
+    uint64_t adds = self->drained_adds;
+    uint64_t records = self->drained_records;
+    for (ThreadState *ts = self->threads; ts; ts = ts->next) {
+        adds += ts->lines.adds + ts->arcs.adds + ts->instr_arcs.adds;
+        records += ts->lines.size + ts->arcs.size + ts->instr_arcs.size;
+    }
+    size_t pending = pending_records(self);
 
-    Py_DECREF(current_lasti);
+    PyObject *stats = PyDict_New();
+    PyObject *events = PyDict_New();
+    PyObject *files = PyDict_New();
+    if (!stats || !events || !files) goto error;
+
+    for (int i = 0; i < STAT_FILTERED; i++) {
+        if (self->stats[i] && set_stat(events, stat_event_names[i], self->stats[i]) < 0) goto error;
+    }
+    Py_ssize_t known = PyList_GET_SIZE(self->file_names);
+    for (size_t i = 0; i < self->file_events_capacity && (Py_ssize_t)i < known; i++) {
+        if (!self->file_events[i]) continue;
+        PyObject *count = PyLong_FromUnsignedLongLong(self->file_events[i]);
+        if (!count || PyDict_SetItem(files, PyList_GET_ITEM(self->file_names, i), count) < 0) {
+            Py_XDECREF(count);
+            goto error;
+        }
+        Py_DECREF(count);
+    }
+
+    if (PyDict_SetItemString(stats, "events", events) < 0 ||
+        set_stat(stats, "filtered", self->stats[STAT_FILTERED]) < 0 ||
+        set_stat(stats, "should_trace_calls", self->stats[STAT_SHOULD_TRACE]) < 0 ||
+        set_stat(stats, "inserts", records) < 0 ||
+        set_stat(stats, "duplicates", adds - records) < 0 ||
+        set_stat(stats, "peak_pending", pending > self->peak_pending ? pending : self->peak_pending) < 0 ||
+        set_stat(stats, "arena_overflows", self->arena_overflows) < 0 ||
+        PyDict_SetItemString(stats, "file_events", files) < 0) {
+        goto error;
+    }
+    Py_DECREF(events);
+    Py_DECREF(files);
+    return stats;
+
+error:
+    Py_XDECREF(stats);
+    Py_XDECREF(events);
+    Py_XDECREF(files);
+    return NULL;
+}
+
+static int context_arg(PyObject *arg, uint32_t *cid) {
+    unsigned long value = PyLong_AsUnsignedLong(arg);
+    if (value == (unsigned long)-1 && PyErr_Occurred()) return -1;
+    if (value >= UINT32_MAX) {
+        PyErr_SetString(PyExc_OverflowError, "context id out of range");
+        return -1;
+    }
+    *cid = (uint32_t)value;
     return 0;
 }
 
 static PyObject *
-Tracer_call(Tracer *self, PyObject *args) {
+Tracer_set_context(Tracer *self, PyObject *arg) {
+    uint32_t cid;
+    if (context_arg(arg, &cid) < 0) return NULL;
+    self->context_id = cid;
+    Py_RETURN_NONE;
+}
+
+static PyObject *
+Tracer_set_thread_context(Tracer *self, PyObject *arg) {
+    ThreadState *ts = get_thread_state(self);
+    if (!ts) return NULL;
+
+    if (arg == Py_None) {
+        ts->context_id = -1;
+        Py_RETURN_NONE;
+    }
+
+    uint32_t cid;
+    if (context_arg(arg, &cid) < 0) return NULL;
+    ts->context_id = cid;
+    Py_RETURN_NONE;
+}
+
+static int event_from_string(PyObject *event) {
+    const char *event_str = PyUnicode_AsUTF8(event);
+    if (!event_str) return -2;
+    if (strcmp(event_str, "line") == 0) return PyTrace_LINE;
+    if (strcmp(event_str, "call") == 0) return PyTrace_CALL;
+    if (strcmp(event_str, "return") == 0) return PyTrace_RETURN;
+    if (strcmp(event_str, "exception") == 0) return PyTrace_EXCEPTION;
+    if (strcmp(event_str, "opcode") == 0) return PyTrace_OPCODE;
+    return -1;
+}
+
+static PyObject *
+Tracer_call(Tracer *self, PyObject *args, PyObject *kwds) {
     PyObject *frame;
     PyObject *event;
     PyObject *arg;
@@ -196,22 +1087,558 @@ Tracer_call(Tracer *self, PyObject *args) {
         return NULL;
     }
 
-    const char *event_str = PyUnicode_AsUTF8(event);
-    int what = -1;
-    if (strcmp(event_str, "line") == 0) what = PyTrace_LINE;
-    else if (strcmp(event_str, "call") == 0) what = PyTrace_CALL;
-    else if (strcmp(event_str, "return") == 0) what = PyTrace_RETURN;
-    else if (strcmp(event_str, "exception") == 0) what = PyTrace_EXCEPTION;
-    else if (strcmp(event_str, "opcode") == 0) what = PyTrace_OPCODE;
-
-    if (trace_logic(self, (PyFrameObject*)frame, what, arg) < 0) {
+    int what = event_from_string(event);
+    if (what == -2) return NULL;
+
+    int result = trace_logic(self, (PyFrameObject*)frame, what, arg);
+    if (result < 0) {
         return NULL;
     }
 
+    // frames outside the project get no local trace function, so they cost nothing
+    // beyond their CALL event
+    if (result > 0) {
+        Py_RETURN_NONE;
+    }
+
     Py_INCREF(self);
     return (PyObject *)self;
 }
 
+/*
+ * Native trace hook installed by Tracer.start(). CPython calls it directly with the
+ * integer event, so no argument tuple is built and no event string is compared.
+ *
+ * A native hook sees every event of every frame instead of relying on a returned
+ * local trace function, so untraceable frames have their line events switched off
+ * on CALL instead.
+ */
+static int
+Tracer_trace(PyObject *obj, PyFrameObject *frame, int what, PyObject *arg) {
+    Tracer *self = (Tracer *)obj;
+
+    int result = trace_logic(self, frame, what, arg);
+    if (result < 0) return -1;
+
+    if (result > 0 && what == PyTrace_CALL) {
+        if (PyObject_SetAttrString((PyObject*)frame, "f_trace_lines", Py_False) < 0) return -1;
+    }
+    return 0;
+}
+
+static int set_thread_hook(PyObject *hook) {
+    PyObject *threading = PyImport_ImportModule("threading");
+    if (!threading) return -1;
+    PyObject *res = PyObject_CallMethod(threading, "settrace", "O", hook);
+    Py_DECREF(threading);
+    if (!res) return -1;
+    Py_DECREF(res);
+    return 0;
+}
+
+static PyObject *
+Tracer_start(Tracer *self, PyObject *Py_UNUSED(ignored)) {
+    // threads started later run _start_thread through threading.settrace first
+    PyObject *hook = PyObject_GetAttrString((PyObject*)self, "_start_thread");
+    if (!hook) return NULL;
+    int result = set_thread_hook(hook);
+    Py_DECREF(hook);
+    if (result < 0) return NULL;
+
+#if PY_VERSION_HEX >= 0x030C0000 && PY_VERSION_HEX < 0x030D0000
+    // 3.12 only gives the hook INSTRUCTION events when some frame asked for opcode
+    // events before it was installed; ask on the calling frame, then put its flag back
+    PyObject *caller = (PyObject*)PyEval_GetFrame();
+    PyObject *caller_opcodes = NULL;
+    if (caller) {
+        caller_opcodes = PyObject_GetAttrString(caller, "f_trace_opcodes");
+        if (!caller_opcodes) return NULL;
+        if (PyObject_SetAttrString(caller, "f_trace_opcodes", Py_True) < 0) {
+            Py_DECREF(caller_opcodes);
+            return NULL;
+        }
+    }
+    PyEval_SetTraceAllThreads(Tracer_trace, (PyObject*)self);
+    if (caller) {
+        result = PyObject_SetAttrString(caller, "f_trace_opcodes", caller_opcodes);
+        Py_DECREF(caller_opcodes);
+        if (result < 0) return NULL;
+    }
+#elif PY_VERSION_HEX >= 0x030D0000
+    PyEval_SetTraceAllThreads(Tracer_trace, (PyObject*)self);
+#else
+    PyEval_SetTrace(Tracer_trace, (PyObject*)self);
+#endif
+    self->started = 1;
+    Py_RETURN_NONE;
+}
+
+static PyObject *
+Tracer_stop(Tracer *self, PyObject *Py_UNUSED(ignored)) {
+    if (!self->started) {
+        Py_RETURN_NONE;
+    }
+    self->started = 0;
+
+    if (set_thread_hook(Py_None) < 0) return NULL;
+#if PY_VERSION_HEX >= 0x030C0000
+    PyEval_SetTraceAllThreads(NULL, NULL);
+#else
+    PyEval_SetTrace(NULL, NULL);
+#endif
+    Py_RETURN_NONE;
+}
+
+/*
+ * threading.settrace() hook: runs once at the start of a new thread, replaces itself
+ * with the native hook for that thread and handles the thread's first event.
+ */
+static PyObject *
+Tracer_start_thread(Tracer *self, PyObject *const *args, Py_ssize_t nargs) {
+    if (nargs != 3) {
+        PyErr_SetString(PyExc_TypeError, "_start_thread expects (frame, event, arg)");
+        return NULL;
+    }
+
+    int what = event_from_string(args[1]);
+    if (what == -2) return NULL;
+
+    // a finished thread's PyThreadState may be reused, drop what it left behind
+    ThreadState *ts = get_thread_state(self);
+    if (!ts) return NULL;
+    ts->context_id = -1;
+    clear_history(ts);
+
+    PyEval_SetTrace(Tracer_trace, (PyObject*)self);
+    if (Tracer_trace((PyObject*)self, (PyFrameObject*)args[0], what, args[2]) < 0) return NULL;
+    Py_RETURN_NONE;
+}
+
+#define ARC_HISTORY_CAPSULE "minicov_tracer.ArcHistory"
+
+static void free_parked_history(PyObject *capsule) {
+    ArcHistory *parked = PyCapsule_GetPointer(capsule, ARC_HISTORY_CAPSULE);
+    if (parked) {
+        PyMem_Free(parked->callers);
+        PyMem_Free(parked);
+    }
+}
+
+/*
+ * greenlet.settrace() callback, installed by the engine for concurrency = greenlet,
+ * gevent or eventlet. A switch replaces the whole stack of frames, so the thread's
+ * ArcHistory is parked under the greenlet switched away from and the target's own is
+ * brought back; the history of a finished greenlet is dropped.
+ */
+static PyObject *
+Tracer_greenlet_switch(Tracer *self, PyObject *const *args, Py_ssize_t nargs) {
+    if (nargs != 2 || !PyTuple_Check(args[1]) || PyTuple_GET_SIZE(args[1]) != 2) {
+        PyErr_SetString(PyExc_TypeError, "_greenlet_switch expects (event, (origin, target))");
+        return NULL;
+    }
+    PyObject *origin = PyTuple_GET_ITEM(args[1], 0);
+    PyObject *target = PyTuple_GET_ITEM(args[1], 1);
+
+    ThreadState *ts = get_thread_state(self);
+    if (!ts) return NULL;
+
+    PyObject *dead = PyObject_GetAttrString(origin, "dead");
+    if (!dead) return NULL;
+    int finished = PyObject_IsTrue(dead);
+    Py_DECREF(dead);
+    if (finished < 0) return NULL;
+
+    if (finished) {
+        PyMem_Free(ts->history.callers);
+    } else {
+        ArcHistory *parked = PyMem_Malloc(sizeof(ArcHistory));
+        if (!parked) return PyErr_NoMemory();
+        *parked = ts->history;
+        PyObject *capsule = PyCapsule_New(parked, ARC_HISTORY_CAPSULE, free_parked_history);
+        if (!capsule) {
+            PyMem_Free(parked);
+            return NULL;
+        }
+        PyObject *key = PyLong_FromVoidPtr(origin);
+        int result = key ? PyDict_SetItem(self->greenlet_histories, key, capsule) : -1;
+        Py_XDECREF(key);
+        if (result < 0) {
+            // the thread keeps its callers
+            parked->callers = NULL;
+            Py_DECREF(capsule);
+            return NULL;
+        }
+        Py_DECREF(capsule);
+    }
+    memset(&ts->history, 0, sizeof(ArcHistory));
+    reset_history(ts);
+
+    PyObject *key = PyLong_FromVoidPtr(target);
+    if (!key) return NULL;
+    PyObject *capsule = PyDict_GetItemWithError(self->greenlet_histories, key);  // borrowed
+    int result = 0;
+    if (capsule) {
+        ArcHistory *parked = PyCapsule_GetPointer(capsule, ARC_HISTORY_CAPSULE);
+        if (parked) {
+            ts->history = *parked;
+            parked->callers = NULL;  // now owned by the thread
+        }
+        result = parked ? PyDict_DelItem(self->greenlet_histories, key) : -1;
+    } else if (PyErr_Occurred()) {
+        result = -1;
+    }
+    Py_DECREF(key);
+    if (result < 0) return NULL;
+    Py_RETURN_NONE;
+}
+
+#if PY_VERSION_HEX >= 0x030C0000
+/*
+ * sys.monitoring callbacks (Python 3.12+).
+ *
+ * Registered by SysMonitoringTracer in place of its pure-Python callbacks; they share
+ * the per-code cache, thread state and hit buffers with the settrace path.
+ */
+
+static PyCodeObject* monitor_code_arg(PyObject *const *args, Py_ssize_t nargs, Py_ssize_t expected) {
+    if (nargs != expected || !PyCode_Check(args[0])) {
+        PyErr_SetString(PyExc_TypeError, "unexpected sys.monitoring callback arguments");
+        return NULL;
+    }
+    return (PyCodeObject*)args[0];
+}
+
+/*
+ * First-hit mode: every location returns DISABLE once recorded, so hot loops stop
+ * paying for events. Arcs cannot come from consecutive LINE events any more; they are
+ * rebuilt from BRANCH and JUMP events as (line of source, line of destination).
+ *
+ * A destination on the source's own line (a loop's fallthrough into its target
+ * assignment, the second operand of `a and b`) is followed forward to the first
+ * instruction on another line. The walk gives up at any instruction that leaves the
+ * straight-line flow, since that instruction reports its own BRANCH/JUMP event.
+ */
+static int resolve_dest_line(Tracer *self, PyCodeObject *code, int from_line, int to) {
+    int line = PyCode_Addr2Line(code, to);
+    if (line != from_line && line >= 0) return line;
+
+    PyObject *co_code = PyCode_GetCode(code);
+    if (!co_code) return -2;
+
+    const unsigned char *bytes = (const unsigned char *)PyBytes_AS_STRING(co_code);
+    Py_ssize_t size = PyBytes_GET_SIZE(co_code);
+    Py_ssize_t unit = 2;  // code units are 16 bits wide
+
+    line = -1;
+    for (Py_ssize_t offset = to; offset >= 0 && offset + unit <= size; offset += unit) {
+        int offset_line = PyCode_Addr2Line(code, (int)offset);
+        if (offset_line >= 0 && offset_line != from_line) {
+            line = offset_line;
+            break;
+        }
+        if (self->flow_stop[bytes[offset]]) break;
+    }
+
+    Py_DECREF(co_code);
+    return line;
+}
+
+static int record_jump_arc(Tracer *self, ThreadState *ts, PyCodeObject *code, uint32_t file, uint32_t cid,
+                           int from, int to) {
+    int from_line = PyCode_Addr2Line(code, from);
+    if (from_line < 0) return 0;
+
+    int to_line = resolve_dest_line(self, code, from_line, to);
+    if (to_line == -2) return -1;
+    if (to_line < 0) return 0;
+    if (arena_add_pair(self, file, cid, ARENA_ARC, from_line, to_line)) return 0;
+    return hitset_add(&ts->arcs, file, cid, from_line, to_line) < 0 ? -1 : 0;
+}
+
+static PyObject *
+Tracer_monitor_py_start(Tracer *self, PyObject *const *args, Py_ssize_t nargs) {
+    PyCodeObject *code = monitor_code_arg(args, nargs, 2);
+    if (!code) return NULL;
+
+    CodeInfo *info = get_code_info(self, code);
+    if (!info) return NULL;
+
+    // code outside the project never reports PY_START again
+    if (!count_event(self, info, STAT_PY_START)) {
+        return Py_NewRef(self->monitoring_disable);
+    }
+
+    // 1 for the full event set, 2 for the first-hit one
+    char wanted = 1 + self->first_hit;
+    if (info->local_events != wanted) {
+        PyObject *events = self->first_hit ? self->local_events_first_hit : self->local_events;
+        PyObject *res = PyObject_CallFunctionObjArgs(self->set_local_events, self->monitoring_tool, (PyObject*)code,
+                                                     events, NULL);
+        if (!res) return NULL;
+        Py_DECREF(res);
+        info->local_events = wanted;
+    }
+
+    // first-hit mode keeps no arc history, so there is nothing left to do for this code
+    if (self->first_hit) {
+        return Py_NewRef(self->monitoring_disable);
+    }
+
+    // a new history per frame prevents cross-function arcs
+    ThreadState *ts = get_thread_state(self);
+    if (!ts) return NULL;
+    if (enter_frame(ts, code, -1) < 0) return NULL;
+    Py_RETURN_NONE;
+}
+
+// a generator or coroutine continues: its arc chain goes on from the line it was suspended on
+static PyObject *
+resume_frame(Tracer *self, PyCodeObject *code, PyObject *offset) {
+    int instruction = PyLong_AsLong(offset);
+    if (instruction == -1 && PyErr_Occurred()) return NULL;
+
+    ThreadState *ts = get_thread_state(self);
+    if (!ts) return NULL;
+    if (enter_frame(ts, code, PyCode_Addr2Line(code, instruction)) < 0) return NULL;
+    Py_RETURN_NONE;
+}
+
+// PY_START pushed a history unless the code is untraced or only first hits are recorded
+static inline int frame_entered(const CodeInfo *info) {
+    return info->file >= 0 && info->local_events == 1;
+}
+
+static PyObject *
+Tracer_monitor_py_resume(Tracer *self, PyObject *const *args, Py_ssize_t nargs) {
+    PyCodeObject *code = monitor_code_arg(args, nargs, 2);
+    if (!code) return NULL;
+
+    // only enabled locally for traced code
+    self->stats[STAT_PY_RESUME]++;
+    return resume_frame(self, code, args[1]);
+}
+
+static PyObject *
+Tracer_monitor_py_throw(Tracer *self, PyObject *const *args, Py_ssize_t nargs) {
+    PyCodeObject *code = monitor_code_arg(args, nargs, 3);
+    if (!code) return NULL;
+
+    // a global event: throw() resumes a frame without PY_RESUME, in any code
+    CodeInfo *info = get_code_info(self, code);
+    if (!info) return NULL;
+    if (!frame_entered(info)) Py_RETURN_NONE;
+
+    self->stats[STAT_PY_RESUME]++;
+    return resume_frame(self, code, args[1]);
+}
+
+static PyObject *
+Tracer_monitor_py_return(Tracer *self, PyObject *const *args, Py_ssize_t nargs) {
+    // PY_RETURN and PY_YIELD, only enabled locally for traced code
+    self->stats[STAT_PY_RETURN]++;
+    ThreadState *ts = get_thread_state(self);
+    if (!ts) return NULL;
+    exit_frame(ts);
+    Py_RETURN_NONE;
+}
+
+static PyObject *
+Tracer_monitor_py_unwind(Tracer *self, PyObject *const *args, Py_ssize_t nargs) {
+    PyCodeObject *code = monitor_code_arg(args, nargs, 3);
+    if (!code) return NULL;
+
+    // a global event that cannot be disabled: frames left by an exception, in any code
+    CodeInfo *info = get_code_info(self, code);
+    if (!info) return NULL;
+    if (!frame_entered(info)) Py_RETURN_NONE;
+
+    self->stats[STAT_PY_RETURN]++;
+    ThreadState *ts = get_thread_state(self);
+    if (!ts) return NULL;
+    exit_frame(ts);
+    Py_RETURN_NONE;
+}
+
+static PyObject *
+Tracer_monitor_line(Tracer *self, PyObject *const *args, Py_ssize_t nargs) {
+    PyCodeObject *code = monitor_code_arg(args, nargs, 2);
+    if (!code) return NULL;
+
+    CodeInfo *info = get_code_info(self, code);
+    if (!info) return NULL;
+    if (!count_event(self, info, STAT_MONITOR_LINE)) {
+        return Py_NewRef(self->monitoring_disable);
+    }
+
+    int lineno = PyLong_AsLong(args[1]);
+    if (lineno == -1 && PyErr_Occurred()) return NULL;
+
+    ThreadState *ts = get_thread_state(self);
+    if (!ts) return NULL;
+    uint32_t cid = get_context_id(self, ts);
+
+    if (self->first_hit) {
+        uint32_t file = (uint32_t)info->file;
+        if (!arena_add_line(self, file, cid, lineno) && hitset_add(&ts->lines, file, cid, lineno, 0) < 0) return NULL;
+        return Py_NewRef(self->monitoring_disable);
+    }
+
+    // LINE stays enabled: arcs are built from consecutive line events
+    if (record_line(self, ts, code, (uint32_t)info->file, cid, lineno) < 0) return NULL;
+    Py_RETURN_NONE;
+}
+
+static PyObject *
+Tracer_monitor_branch(Tracer *self, PyObject *const *args, Py_ssize_t nargs) {
+    PyCodeObject *code = monitor_code_arg(args, nargs, 3);
+    if (!code) return NULL;
+
+    CodeInfo *info = get_code_info(self, code);
+    if (!info) return NULL;
+    if (!count_event(self, info, STAT_BRANCH)) {
+        return Py_NewRef(self->monitoring_disable);
+    }
+
+    int from = PyLong_AsLong(args[1]);
+    int to = PyLong_AsLong(args[2]);
+    if (PyErr_Occurred()) return NULL;
+
+    ThreadState *ts = get_thread_state(self);
+    if (!ts) return NULL;
+    uint32_t cid = get_context_id(self, ts);
+
+    uint32_t file = (uint32_t)info->file;
+    if (!arena_add_pair(self, file, cid, ARENA_INSTRUCTION_ARC, from, to) &&
+        hitset_add(&ts->instr_arcs, file, cid, from, to) < 0) {
+        return NULL;
+    }
+
+    // DISABLE silences the branch instruction for both of its destinations, so only
+    // return it once both have been recorded for the current context.
+    // (from, to) marks a seen destination, (from, -1) marks that one was seen before.
+    // Offsets are only unique within a code object, so the records are kept in its CodeInfo.
+    HitSet *seen = &info->branch_seen;
+    if (!seen->capacity && hitset_resize(seen, HIT_SMALL_CAPACITY) < 0) return NULL;
+    int new_dest = hitset_add(seen, 0, cid, from, to);
+    if (new_dest < 0) return NULL;
+    if (new_dest) {
+        if (self->first_hit && record_jump_arc(self, ts, code, file, cid, from, to) < 0) return NULL;
+
+        int first_dest = hitset_add(seen, 0, cid, from, -1);
+        if (first_dest < 0) return NULL;
+        if (!first_dest) {
+            return Py_NewRef(self->monitoring_disable);
+        }
+    }
+    Py_RETURN_NONE;
+}
+
+static PyObject *
+Tracer_monitor_jump(Tracer *self, PyObject *const *args, Py_ssize_t nargs) {
+    PyCodeObject *code = monitor_code_arg(args, nargs, 3);
+    if (!code) return NULL;
+
+    CodeInfo *info = get_code_info(self, code);
+    if (!info) return NULL;
+    if (!count_event(self, info, STAT_JUMP)) {
+        return Py_NewRef(self->monitoring_disable);
+    }
+
+    int from = PyLong_AsLong(args[1]);
+    int to = PyLong_AsLong(args[2]);
+    if (PyErr_Occurred()) return NULL;
+
+    ThreadState *ts = get_thread_state(self);
+    if (!ts) return NULL;
+    uint32_t cid = get_context_id(self, ts);
+
+    // an unconditional jump has a single destination, one event is all it takes
+    if (record_jump_arc(self, ts, code, (uint32_t)info->file, cid, from, to) < 0) return NULL;
+    return Py_NewRef(self->monitoring_disable);
+}
+
+static PyObject* event_mask(PyObject *events, const char **names, size_t count) {
+    long mask = 0;
+    for (size_t i = 0; i < count; i++) {
+        PyObject *value = PyObject_GetAttrString(events, names[i]);
+        if (!value) return NULL;
+        mask |= PyLong_AsLong(value);
+        Py_DECREF(value);
+    }
+    return PyLong_FromLong(mask);
+}
+
+// fill flow_stop with every jump, return and raise opcode known to the dis module
+static int init_flow_stop(Tracer *self) {
+    PyObject *dis = PyImport_ImportModule("dis");
+    if (!dis) return -1;
+
+    int result = 0;
+    const char *tables[] = {"hasjrel", "hasjabs"};
+    for (size_t i = 0; i < sizeof(tables) / sizeof(tables[0]) && result == 0; i++) {
+        PyObject *ops = PyObject_GetAttrString(dis, tables[i]);
+        PyObject *seq = ops ? PySequence_Fast(ops, "opcode table is not a sequence") : NULL;
+        Py_XDECREF(ops);
+        if (!seq) {
+            result = -1;
+            break;
+        }
+        for (Py_ssize_t j = 0; j < PySequence_Fast_GET_SIZE(seq); j++) {
+            long op = PyLong_AsLong(PySequence_Fast_GET_ITEM(seq, j));
+            if (op >= 0 && op < 256) self->flow_stop[op] = 1;
+        }
+        Py_DECREF(seq);
+    }
+
+    PyObject *opmap = result == 0 ? PyObject_GetAttrString(dis, "opmap") : NULL;
+    if (opmap) {
+        const char *names[] = {"RETURN_VALUE", "RETURN_CONST", "RAISE_VARARGS", "RERAISE"};
+        for (size_t i = 0; i < sizeof(names) / sizeof(names[0]); i++) {
+            PyObject *op = PyMapping_GetItemString(opmap, names[i]);
+            if (!op) {
+                PyErr_Clear();
+                continue;
+            }
+            long value = PyLong_AsLong(op);
+            if (value >= 0 && value < 256) self->flow_stop[value] = 1;
+            Py_DECREF(op);
+        }
+        Py_DECREF(opmap);
+    } else {
+        result = -1;
+    }
+
+    Py_DECREF(dis);
+    if (result == 0 && PyErr_Occurred()) result = -1;
+    return result;
+}
+
+static int init_monitoring(Tracer *self) {
+    PyObject *monitoring = PySys_GetObject("monitoring");  // borrowed
+    if (!monitoring) {
+        PyErr_SetString(PyExc_RuntimeError, "sys.monitoring is not available");
+        return -1;
+    }
+
+    self->monitoring_disable = PyObject_GetAttrString(monitoring, "DISABLE");
+    self->monitoring_tool = PyObject_GetAttrString(monitoring, "COVERAGE_ID");
+    self->set_local_events = PyObject_GetAttrString(monitoring, "set_local_events");
+    if (!self->monitoring_disable || !self->monitoring_tool || !self->set_local_events) return -1;
+
+    PyObject *events = PyObject_GetAttrString(monitoring, "events");
+    if (!events) return -1;
+
+    const char *full[] = {"LINE", "BRANCH", "PY_RESUME", "PY_RETURN", "PY_YIELD"};
+    const char *first_hit[] = {"LINE", "BRANCH", "JUMP"};
+    self->local_events = event_mask(events, full, sizeof(full) / sizeof(full[0]));
+    self->local_events_first_hit = event_mask(events, first_hit, sizeof(first_hit) / sizeof(first_hit[0]));
+    Py_DECREF(events);
+    if (!self->local_events || !self->local_events_first_hit) return -1;
+
+    return init_flow_stop(self);
+}
+#endif
+
 static int
 Tracer_init(Tracer *self, PyObject *args, PyObject *kwds) {
     PyObject *engine = NULL;
@@ -237,30 +1664,140 @@ Tracer_init(Tracer *self, PyObject *args, PyObject *kwds) {
     self->trace_data_instr_arcs = PyObject_GetItem(trace_data, key_instr);
     Py_DECREF(key_instr);
 
+    PyObject *key_line_counts = PyUnicode_FromString("line_counts");
+    self->trace_data_line_counts = PyObject_GetItem(trace_data, key_line_counts);
+    Py_DECREF(key_line_counts);
+
+    PyObject *key_arc_counts = PyUnicode_FromString("arc_counts");
+    self->trace_data_arc_counts = PyObject_GetItem(trace_data, key_arc_counts);
+    Py_DECREF(key_arc_counts);
+
     Py_DECREF(trace_data);
 
-    self->engine_thread_local = PyObject_GetAttrString(engine, "thread_local");
     self->cache_traceable = PyObject_GetAttrString(engine, "_cache_traceable");
+    self->greenlet_histories = PyDict_New();
+
+    // intern into the engine's FileTable, so storage writes the same IDs
+    PyObject *file_table = PyObject_GetAttrString(engine, "file_table");
+    if (!file_table) return -1;
+    self->file_index = PyObject_GetAttrString(file_table, "index");
+    self->file_names = PyObject_GetAttrString(file_table, "paths");
+    Py_DECREF(file_table);
 
-    if (!self->trace_data_lines || !self->trace_data_arcs || !self->trace_data_instr_arcs || !self->engine_thread_local || !self->cache_traceable) {
-        Py_XDECREF(self->engine);
+    if (!self->trace_data_lines || !self->trace_data_arcs || !self->trace_data_instr_arcs ||
+        !self->trace_data_line_counts || !self->trace_data_arc_counts || !self->cache_traceable ||
+        !self->greenlet_histories || !self->file_index || !self->file_names) {
+        return -1;
+    }
+    if (!PyDict_Check(self->file_index) || !PyList_Check(self->file_names)) {
+        PyErr_SetString(PyExc_TypeError, "file_table must provide an index dict and a paths list");
         return -1;
     }
 
+    self->serial = next_tracer_serial++;
+    self->sample_rate = 1.0;
+    self->sample_state = (uint64_t)(uintptr_t)self ^ ((uint64_t)time(NULL) << 20) ^ self->serial;
+
+    PyObject *cid = PyObject_CallMethod(engine, "_get_current_context_id", NULL);
+    if (!cid) return -1;
+    int result = context_arg(cid, &self->context_id);
+    Py_DECREF(cid);
+    if (result < 0) return -1;
+
+#if PY_VERSION_HEX >= 0x030C0000
+    if (init_monitoring(self) < 0) return -1;
+#endif
+
     return 0;
 }
 
 static void
 Tracer_dealloc(Tracer *self) {
+    ThreadState *ts = self->threads;
+    while (ts) {
+        ThreadState *next = ts->next;
+        hitset_free(&ts->lines);
+        hitset_free(&ts->arcs);
+        hitset_free(&ts->instr_arcs);
+        PyMem_Free(ts->history.callers);
+        PyMem_Free(ts);
+        ts = next;
+    }
+
     Py_XDECREF(self->engine);
     Py_XDECREF(self->trace_data_lines);
     Py_XDECREF(self->trace_data_arcs);
     Py_XDECREF(self->trace_data_instr_arcs);
-    Py_XDECREF(self->engine_thread_local);
+    Py_XDECREF(self->trace_data_line_counts);
+    Py_XDECREF(self->trace_data_arc_counts);
     Py_XDECREF(self->cache_traceable);
+    Py_XDECREF(self->greenlet_histories);
+    Py_XDECREF(self->file_index);
+    Py_XDECREF(self->file_names);
+    Py_XDECREF(self->monitoring_disable);
+    Py_XDECREF(self->monitoring_tool);
+    Py_XDECREF(self->set_local_events);
+    Py_XDECREF(self->local_events);
+    Py_XDECREF(self->local_events_first_hit);
+    PyMem_Free(self->file_events);
+    Tracer_detach_arena(self, NULL);
     Py_TYPE(self)->tp_free((PyObject *)self);
 }
 
+static PyMethodDef Tracer_methods[] = {
+    {"drain", (PyCFunction)Tracer_drain, METH_NOARGS,
+     "Move natively buffered hits into the engine's TraceContainer and reset the buffers."},
+    {"pending", (PyCFunction)Tracer_pending, METH_NOARGS,
+     "Number of hits buffered natively since the last drain."},
+    {"set_context", (PyCFunction)Tracer_set_context, METH_O,
+     "Set the integer context id recorded by every thread without a per-thread context."},
+    {"set_thread_context", (PyCFunction)Tracer_set_thread_context, METH_O,
+     "Set the integer context id recorded by the calling thread, or None to follow set_context()."},
+    {"start", (PyCFunction)Tracer_start, METH_NOARGS,
+     "Install the native trace hook on this thread (all threads on 3.12+) and on threads started later."},
+    {"stop", (PyCFunction)Tracer_stop, METH_NOARGS,
+     "Remove the native trace hook installed by start()."},
+    {"_start_thread", (PyCFunction)(void(*)(void))Tracer_start_thread, METH_FASTCALL,
+     "threading.settrace() hook installing the native trace hook in a new thread."},
+    {"_greenlet_switch", (PyCFunction)(void(*)(void))Tracer_greenlet_switch, METH_FASTCALL,
+     "greenlet.settrace() callback keeping the arc history of every greenlet apart."},
+    {"attach_arena", (PyCFunction)Tracer_attach_arena, METH_O,
+     "Record context 0 hits into a shared arena mapping (see src/engine/arena.py)."},
+    {"detach_arena", (PyCFunction)Tracer_detach_arena, METH_NOARGS,
+     "Release the arena mapping; later hits go to the native buffers again."},
+    {"stats", (PyCFunction)Tracer_stats, METH_NOARGS,
+     "Self-metrics: events by type, filtered events, buffer inserts and duplicates, events per file."},
+#if PY_VERSION_HEX >= 0x030C0000
+    {"_monitor_py_start", (PyCFunction)(void(*)(void))Tracer_monitor_py_start, METH_FASTCALL,
+     "sys.monitoring PY_START callback."},
+    {"_monitor_py_resume", (PyCFunction)(void(*)(void))Tracer_monitor_py_resume, METH_FASTCALL,
+     "sys.monitoring PY_RESUME callback."},
+    {"_monitor_py_throw", (PyCFunction)(void(*)(void))Tracer_monitor_py_throw, METH_FASTCALL,
+     "sys.monitoring PY_THROW callback."},
+    {"_monitor_py_return", (PyCFunction)(void(*)(void))Tracer_monitor_py_return, METH_FASTCALL,
+     "sys.monitoring PY_RETURN and PY_YIELD callback."},
+    {"_monitor_py_unwind", (PyCFunction)(void(*)(void))Tracer_monitor_py_unwind, METH_FASTCALL,
+     "sys.monitoring PY_UNWIND callback."},
+    {"_monitor_line", (PyCFunction)(void(*)(void))Tracer_monitor_line, METH_FASTCALL,
+     "sys.monitoring LINE callback."},
+    {"_monitor_branch", (PyCFunction)(void(*)(void))Tracer_monitor_branch, METH_FASTCALL,
+     "sys.monitoring BRANCH callback."},
+    {"_monitor_jump", (PyCFunction)(void(*)(void))Tracer_monitor_jump, METH_FASTCALL,
+     "sys.monitoring JUMP callback (first-hit mode only)."},
+#endif
+    {NULL}
+};
+
+static PyMemberDef Tracer_members[] = {
+    {"first_hit", T_BOOL, offsetof(Tracer, first_hit), 0,
+     "Record each sys.monitoring location once and DISABLE it (statement-only runs)."},
+    {"count_hits", T_BOOL, offsetof(Tracer, count_hits), 0,
+     "Count executions of every line and arc into trace_data's line_counts and arc_counts."},
+    {"sample_rate", T_DOUBLE, offsetof(Tracer, sample_rate), 0,
+     "Fraction of traceable code objects recorded; set before tracing starts."},
+    {NULL}
+};
+
 static PyTypeObject TracerType = {
     PyVarObject_HEAD_INIT(NULL, 0)
     .tp_name = "minicov_tracer.Tracer",
@@ -272,6 +1809,8 @@ static PyTypeObject TracerType = {
     .tp_init = (initproc)Tracer_init,
     .tp_dealloc = (destructor)Tracer_dealloc,
     .tp_call = (ternaryfunc)Tracer_call,
+    .tp_methods = Tracer_methods,
+    .tp_members = Tracer_members,
 };
 
 static PyModuleDef minicov_tracer_module = {
@@ -281,12 +1820,59 @@ static PyModuleDef minicov_tracer_module = {
     .m_size = -1,
 };
 
+static int init_boolean_jump_ops(void) {
+    PyObject *dis = PyImport_ImportModule("dis");
+    if (!dis) return -1;
+    PyObject *opmap = PyObject_GetAttrString(dis, "opmap");
+    Py_DECREF(dis);
+    if (!opmap) return -1;
+
+    // keep in sync with ConditionCoverage._analyze_boolean_jumps; names missing from
+    // the running Python version are skipped
+    const char *names[] = {
+        "POP_JUMP_IF_FALSE", "POP_JUMP_IF_TRUE", "JUMP_IF_FALSE_OR_POP", "JUMP_IF_TRUE_OR_POP",
+        "POP_JUMP_FORWARD_IF_FALSE", "POP_JUMP_FORWARD_IF_TRUE",
+        "POP_JUMP_BACKWARD_IF_FALSE", "POP_JUMP_BACKWARD_IF_TRUE",
+    };
+    for (size_t i = 0; i < sizeof(names) / sizeof(names[0]); i++) {
+        PyObject *op = PyMapping_GetItemString(opmap, names[i]);
+        if (!op) {
+            PyErr_Clear();
+            continue;
+        }
+        long value = PyLong_AsLong(op);
+        if (value >= 0 && value < 256) boolean_jump_ops[value] = 1;
+        Py_DECREF(op);
+    }
+
+    PyObject *resume = PyMapping_GetItemString(opmap, "RESUME");
+    if (resume) {
+        long value = PyLong_AsLong(resume);
+        if (value >= 0 && value < 256) resume_op = (int)value;
+        Py_DECREF(resume);
+    } else {
+        PyErr_Clear();
+    }
+
+    Py_DECREF(opmap);
+    return PyErr_Occurred() ? -1 : 0;
+}
+
 PyMODINIT_FUNC
 PyInit_minicov_tracer(void) {
     PyObject *m;
     if (PyType_Ready(&TracerType) < 0)
         return NULL;
 
+    code_extra_index = Code_RequestExtraIndex(free_code_info);
+    if (code_extra_index < 0) {
+        PyErr_SetString(PyExc_RuntimeError, "no free co_extra slot for the tracer");
+        return NULL;
+    }
+
+    if (init_boolean_jump_ops() < 0)
+        return NULL;
+
     m = PyModule_Create(&minicov_tracer_module);
     if (m == NULL)
         return NULL;
@@ -299,4 +1885,4 @@ PyInit_minicov_tracer(void) {
     }
 
     return m;
-}
\ No newline at end of file
+}
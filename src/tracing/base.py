@@ -1,12 +1,18 @@
-from typing import Any
+from collections import Counter
+from typing import Any, Dict, Tuple
 
 
 class BaseTracer:
     """
     Abstract base class for tracing strategies.
     """
+    # event counters reported by stats(), in the C Tracer's names
+    EVENTS: Tuple[str, ...] = ()
+
     def __init__(self, engine: Any):
         self.engine = engine
+        # self-metrics of the Python callbacks, the C tracer keeps its own
+        self.counters: Counter = Counter()
 
     def start(self) -> bool:
         """Start tracing. Return True if successful."""
@@ -15,3 +21,14 @@ class BaseTracer:
     def stop(self) -> None:
         """Stop tracing."""
         raise NotImplementedError
+
+    def stats(self) -> Dict[str, Any]:
+        """
+        Counters of the Python callbacks, in the layout of the C Tracer.stats().
+        """
+        counters = self.counters
+        return {
+            'events': {name: counters[name] for name in self.EVENTS if counters[name]},
+            'filtered': counters['filtered'],
+            'should_trace_calls': counters['should_trace_calls'],
+        }
@@ -1,27 +1,82 @@
 import sys
+import dis
 import types
-from typing import Any
+import random
+import weakref
+from typing import Any, Dict, List, Optional, Set, Tuple
 from .base import BaseTracer
 
+# opcodes that leave straight-line flow; a destination walk stops at them
+_FLOW_STOP = set(dis.hasjrel) | set(dis.hasjabs) | {
+    dis.opmap[name] for name in ('RETURN_VALUE', 'RETURN_CONST', 'RAISE_VARARGS', 'RERAISE') if name in dis.opmap
+}
+
 
 class SysMonitoringTracer(BaseTracer):
     """
     Tracer implementation using sys.monitoring (Python 3.12+).
+
+    When the C extension is available its callbacks are registered instead of the
+    pure-Python ones below; they record into the C tracer's native buffers.
+
+    With ``collection_mode = first-hit`` every location returns DISABLE once recorded
+    and arcs are rebuilt from BRANCH/JUMP events instead of consecutive LINE events.
+    ``sampled`` does the same for a random ``sample_rate`` fraction of code objects and
+    disables the others at their first PY_START.
     """
+    EVENTS = ('py_start', 'py_resume', 'monitor_line', 'branch', 'jump', 'py_return')
+
+    def __init__(self, engine: Any):
+        super().__init__(engine)
+        self.active = False
+        self.first_hit = False
+        self.sample_rate = 1.0
+        # sampling decision per code object, kept when restart_events() re-fires PY_START;
+        # weakly keyed, since sampled runs are meant for long-running processes
+        self._sampled: 'weakref.WeakKeyDictionary[types.CodeType, bool]' = weakref.WeakKeyDictionary()
+        # per code object and weakly keyed, so code that is thrown away (exec, lambdas)
+        # does not pin memory in long-running processes
+        self._line_tables: 'weakref.WeakKeyDictionary[types.CodeType, List[Optional[int]]]' = \
+            weakref.WeakKeyDictionary()
+        # branch destinations seen, {code: {(context id, from offset): {to offsets}}}
+        self._branch_seen: 'weakref.WeakKeyDictionary[types.CodeType, Dict[Tuple[int, int], Set[int]]]' = \
+            weakref.WeakKeyDictionary()
+
     def start(self) -> bool:
         try:
             tool_id = sys.monitoring.COVERAGE_ID
             sys.monitoring.use_tool_id(tool_id, "MiniCoverage")
 
+            mode = self.engine.config.collection_mode
+            self.first_hit = mode in ('first-hit', 'sampled')
+            self.sample_rate = self.engine.sample_rate()
+            callbacks = self.engine.c_tracer if self.engine.c_tracer else self
+            if self.engine.c_tracer:
+                self.engine.c_tracer.first_hit = self.first_hit
+                self.engine.c_tracer.sample_rate = self.sample_rate
+
             # register callbacks
             # monitor PY_START to filter files efficiently
-            sys.monitoring.register_callback(tool_id, sys.monitoring.events.PY_START, self._monitor_py_start)
-            sys.monitoring.register_callback(tool_id, sys.monitoring.events.PY_RESUME, self._monitor_py_resume)
-            sys.monitoring.register_callback(tool_id, sys.monitoring.events.LINE, self._monitor_line)
-            sys.monitoring.register_callback(tool_id, sys.monitoring.events.BRANCH, self._monitor_branch)
+            sys.monitoring.register_callback(tool_id, sys.monitoring.events.PY_START, callbacks._monitor_py_start)
+            sys.monitoring.register_callback(tool_id, sys.monitoring.events.PY_RESUME, callbacks._monitor_py_resume)
+            sys.monitoring.register_callback(tool_id, sys.monitoring.events.PY_THROW, callbacks._monitor_py_throw)
+            sys.monitoring.register_callback(tool_id, sys.monitoring.events.PY_RETURN, callbacks._monitor_py_return)
+            sys.monitoring.register_callback(tool_id, sys.monitoring.events.PY_YIELD, callbacks._monitor_py_return)
+            sys.monitoring.register_callback(tool_id, sys.monitoring.events.PY_UNWIND, callbacks._monitor_py_unwind)
+            sys.monitoring.register_callback(tool_id, sys.monitoring.events.LINE, callbacks._monitor_line)
+            sys.monitoring.register_callback(tool_id, sys.monitoring.events.BRANCH, callbacks._monitor_branch)
+            sys.monitoring.register_callback(tool_id, sys.monitoring.events.JUMP, callbacks._monitor_jump)
+
+            # callbacks return DISABLE; re-arm anything a previous session disabled
+            sys.monitoring.restart_events()
 
             # enable PY_START globally. Local events will be enabled in _monitor_py_start.
-            sys.monitoring.set_events(tool_id, sys.monitoring.events.PY_START)
+            # PY_THROW and PY_UNWIND cannot be enabled locally, they keep the per-frame
+            # arc history of frames resumed by throw() or left by an exception
+            events = sys.monitoring.events
+            global_events = events.PY_START if self.first_hit else events.PY_START | events.PY_THROW | events.PY_UNWIND
+            sys.monitoring.set_events(tool_id, global_events)
+            self.active = True
             return True
 
         except Exception as e:
@@ -29,6 +84,10 @@ class SysMonitoringTracer(BaseTracer):
             return False
 
     def stop(self) -> None:
+        self.active = False
+        self._sampled.clear()
+        self._line_tables.clear()
+        self._branch_seen.clear()
         try:
             tool_id = sys.monitoring.COVERAGE_ID
             sys.monitoring.set_events(tool_id, 0)
@@ -36,50 +95,172 @@ class SysMonitoringTracer(BaseTracer):
         except Exception as e:
             self.engine.logger.debug(f"Error stopping sys.monitoring: {e}")
 
+    def restart_events(self) -> None:
+        """
+        Re-enable events disabled by the callbacks, so a newly switched context
+        records its own hits instead of staying silent on already covered code.
+        """
+        if self.active and (self.engine.c_tracer or self.first_hit):
+            # re-armed branches have to see both destinations again before DISABLE
+            self._branch_seen.clear()
+            sys.monitoring.restart_events()
+
     def _monitor_py_start(self, code: types.CodeType, instruction_offset: int) -> Any:
         """
         sys.monitoring callback for PY_START.
         Determines if a code object should be traced.
         """
         filename = code.co_filename
+        self.counters['py_start'] += 1
 
         if filename not in self.engine._cache_traceable:
+            self.counters['should_trace_calls'] += 1
             self.engine._cache_traceable[filename] = self.engine.path_manager.should_trace(filename, self.engine.excluded_files)
 
-        if self.engine._cache_traceable[filename]:
-            # enable LINE and BRANCH events for this code object
+        traceable = self.engine._cache_traceable[filename]
+        if traceable and self.sample_rate < 1.0:
+            sampled = self._sampled.get(code)
+            if sampled is None:
+                sampled = self._sampled[code] = random.random() < self.sample_rate
+            traceable = sampled
+
+        if traceable:
+            events = sys.monitoring.events
+            if self.first_hit:
+                # no arc history to reset, so PY_START is not needed again either
+                sys.monitoring.set_local_events(sys.monitoring.COVERAGE_ID, code,
+                                                events.LINE | events.BRANCH | events.JUMP)
+                return sys.monitoring.DISABLE
+
+            # enable LINE and BRANCH events for this code object, and the events
+            # delimiting its frames
             sys.monitoring.set_local_events(sys.monitoring.COVERAGE_ID, code,
-                                            sys.monitoring.events.LINE | sys.monitoring.events.BRANCH | sys.monitoring.events.PY_RESUME)
+                                            events.LINE | events.BRANCH | events.PY_RESUME |
+                                            events.PY_RETURN | events.PY_YIELD)
 
-            # clear history on function entry to prevent cross-function arcs
-            if hasattr(self.engine.thread_local, 'last_line'):
-                self.engine.thread_local.last_line = None
-                self.engine.thread_local.last_lasti = None
+            # a new history per frame prevents cross-function arcs
+            self.engine._enter_frame()
         else:
+            self.counters['filtered'] += 1
             sys.monitoring.set_local_events(sys.monitoring.COVERAGE_ID, code, 0)
+            return sys.monitoring.DISABLE
 
     def _monitor_py_resume(self, code: types.CodeType, instruction_offset: int) -> Any:
         """
         sys.monitoring callback for PY_RESUME.
         """
-        # clear history on function resume to prevent cross-function arcs
-        if hasattr(self.engine.thread_local, 'last_line'):
-            self.engine.thread_local.last_line = None
-            self.engine.thread_local.last_lasti = None
+        self.counters['py_resume'] += 1
+        # the arc chain goes on from the line the frame was suspended on
+        self.engine._enter_frame(code.co_filename, self._line_at(code, instruction_offset))
         return None
 
+    def _monitor_py_throw(self, code: types.CodeType, instruction_offset: int, exception: BaseException) -> Any:
+        """
+        sys.monitoring callback for PY_THROW, a global event: throw() resumes a frame
+        without PY_RESUME.
+        """
+        if self._frame_entered(code):
+            self.counters['py_resume'] += 1
+            self.engine._enter_frame(code.co_filename, self._line_at(code, instruction_offset))
+        return None
+
+    def _monitor_py_return(self, code: types.CodeType, instruction_offset: int, retval: Any) -> Any:
+        """
+        sys.monitoring callback for PY_RETURN and PY_YIELD.
+        """
+        self.counters['py_return'] += 1
+        self.engine._exit_frame()
+        return None
+
+    def _monitor_py_unwind(self, code: types.CodeType, instruction_offset: int, exception: BaseException) -> Any:
+        """
+        sys.monitoring callback for PY_UNWIND, a global event that cannot be disabled.
+        """
+        if self._frame_entered(code):
+            self.counters['py_return'] += 1
+            self.engine._exit_frame()
+        return None
+
+    def _frame_entered(self, code: types.CodeType) -> bool:
+        # _monitor_py_start pushed a history for frames of this code (never in first-hit mode)
+        return not self.first_hit and bool(self.engine._cache_traceable.get(code.co_filename))
+
+    def _line_at(self, code: types.CodeType, instruction_offset: int) -> Optional[int]:
+        lines = self._line_table(code)
+        unit = instruction_offset // 2
+        return lines[unit] if unit < len(lines) else None
+
     def _monitor_line(self, code: types.CodeType, line_number: int) -> Any:
         """
         sys.monitoring callback for LINE events.
         """
+        self.counters['monitor_line'] += 1
         filename = code.co_filename
         cid = self.engine._get_current_context_id()
 
+        if self.first_hit:
+            self.engine.trace_data.add_line(filename, cid, line_number)
+            return sys.monitoring.DISABLE
+
         self.engine._record_line(filename, line_number, cid)
         return None  # keep event enabled
 
     def _monitor_branch(self, code: types.CodeType, from_offset: int, to_offset: int) -> Any:
+        self.counters['branch'] += 1
         filename = code.co_filename
         cid = self.engine._get_current_context_id()
         self.engine.trace_data.add_instruction_arc(filename, cid, from_offset, to_offset)
+
+        if self.first_hit:
+            self._record_jump_arc(code, filename, cid, from_offset, to_offset)
+            # DISABLE silences both destinations, so wait until both have been seen
+            # offsets are only unique within a code object
+            branches = self._branch_seen.get(code)
+            if branches is None:
+                branches = self._branch_seen[code] = {}
+            seen = branches.setdefault((cid, from_offset), set())
+            seen.add(to_offset)
+            if len(seen) > 1:
+                return sys.monitoring.DISABLE
         return None
+
+    def _monitor_jump(self, code: types.CodeType, from_offset: int, to_offset: int) -> Any:
+        """
+        sys.monitoring callback for JUMP events, only enabled in first-hit mode.
+        """
+        self.counters['jump'] += 1
+        self._record_jump_arc(code, code.co_filename, self.engine._get_current_context_id(), from_offset, to_offset)
+        return sys.monitoring.DISABLE
+
+    def _record_jump_arc(self, code: types.CodeType, filename: str, cid: int, from_offset: int, to_offset: int) -> None:
+        """
+        Record the line arc taken by a BRANCH/JUMP event.
+
+        A destination on the source's own line is followed forward to the first
+        instruction on another line, stopping at anything that jumps, returns or raises
+        (that instruction reports its own event).
+        """
+        lines = self._line_table(code)
+        from_line = lines[from_offset // 2] if from_offset // 2 < len(lines) else None
+        if from_line is None:
+            return
+
+        co_code = code.co_code
+        for offset in range(to_offset, len(co_code), 2):
+            line = lines[offset // 2]
+            if line is not None and line != from_line:
+                self.engine.trace_data.add_arc(filename, cid, from_line, line)
+                return
+            if co_code[offset] in _FLOW_STOP:
+                return
+
+    def _line_table(self, code: types.CodeType) -> List[Optional[int]]:
+        """Map every code unit of code to its line number, computed once per code object."""
+        table = self._line_tables.get(code)
+        if table is None:
+            table = [None] * (len(code.co_code) // 2)
+            for start, end, line in code.co_lines():
+                for unit in range(start // 2, min(end // 2, len(table))):
+                    table[unit] = line
+            self._line_tables[code] = table
+        return table
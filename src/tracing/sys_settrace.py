@@ -1,25 +1,53 @@
 import sys
+import dis
+import inspect
 import threading
 import types
 from typing import Any, Optional
 from .base import BaseTracer
 
+_GENERATOR_FLAGS = inspect.CO_GENERATOR | inspect.CO_COROUTINE | inspect.CO_ASYNC_GENERATOR | inspect.CO_ITERABLE_COROUTINE
+_RESUME = dis.opmap.get('RESUME')
+
+
+def resume_line(frame: types.FrameType) -> Optional[int]:
+    """
+    Line a generator or coroutine frame entered by a 'call' event was suspended on, or
+    None for a frame that just started. 3.11+ frames start at a RESUME with oparg 0.
+    """
+    code = frame.f_code
+    lasti = frame.f_lasti
+    if not code.co_flags & _GENERATOR_FLAGS or lasti < 0:
+        return None
+    co_code = code.co_code
+    if _RESUME is not None and co_code[lasti] == _RESUME and co_code[lasti + 1] == 0:
+        return None
+    return frame.f_lineno
+
 
 class SysSetTraceTracer(BaseTracer):
     """
     Tracer implementation using sys.settrace (Python < 3.12 or fallback).
     """
+    EVENTS = ('call', 'exception', 'line', 'return', 'opcode')
+
     def __init__(self, engine: Any, c_tracer: Optional[Any] = None):
         super().__init__(engine)
         self.c_tracer = c_tracer
 
     def start(self) -> bool:
-        tracer = self.c_tracer if self.c_tracer else self.trace_function
-        sys.settrace(tracer)
-        threading.settrace(tracer)
+        if self.c_tracer:
+            # installs a native hook (for new threads too), bypassing the Python call protocol
+            self.c_tracer.start()
+            return True
+
+        sys.settrace(self.trace_function)
+        threading.settrace(self.trace_function)
         return True
 
     def stop(self) -> None:
+        if self.c_tracer:
+            self.c_tracer.stop()
         sys.settrace(None)
         threading.settrace(None)
 
@@ -27,20 +55,17 @@ class SysSetTraceTracer(BaseTracer):
         """
         The main system trace callback (Python fallback).
         """
+        self.counters[event] += 1
         # enable opcode tracing for this frame
         if event == 'call':
             frame.f_trace_opcodes = True
-            # clear history to prevent cross-function arcs
-            if hasattr(self.engine.thread_local, 'last_line'):
-                self.engine.thread_local.last_line = None
-                self.engine.thread_local.last_lasti = None
+            # a new history per frame prevents cross-function arcs
+            self.engine._enter_frame(frame.f_code.co_filename, resume_line(frame))
             return self.trace_function
 
         if event == 'return':
-            # clear history to prevent cross-function arcs
-            if hasattr(self.engine.thread_local, 'last_line'):
-                self.engine.thread_local.last_line = None
-                self.engine.thread_local.last_lasti = None
+            # also sent for a yield or an unwinding exception
+            self.engine._exit_frame()
             return self.trace_function
 
         if event not in ('line', 'opcode'):
@@ -49,6 +74,7 @@ class SysSetTraceTracer(BaseTracer):
         filename = frame.f_code.co_filename
 
         if filename not in self.engine._cache_traceable:
+            self.counters['should_trace_calls'] += 1
             self.engine._cache_traceable[filename] = self.engine.path_manager.should_trace(filename, self.engine.excluded_files)
 
         if self.engine._cache_traceable[filename]:
@@ -62,5 +88,7 @@ class SysSetTraceTracer(BaseTracer):
             # 2. opcode trace (for MC/DC)
             current_lasti = frame.f_lasti
             self.engine._record_opcode(filename, current_lasti, cid)
+        else:
+            self.counters['filtered'] += 1
 
         return self.trace_function
@@ -96,3 +96,90 @@ if len(sys.argv) > 1 and sys.argv[1] == 'foo':
 
         cov.report(reporters=['json'])
         self.assertTrue(os.path.exists(os.path.join(self.test_dir, "coverage.json")))
+
+    @unittest.skipIf(sys.version_info < (3, 12), "first-hit mode requires sys.monitoring")
+    def test_first_hit_mode_matches_full_mode(self):
+        script = """
+def classify(values):
+    total = 0
+    for v in values:
+        if v > 2 and v % 2:
+            total += v
+        elif v:
+            total -= 1
+        else:
+            continue
+    while total > 10:
+        total -= 3
+    return total
+classify([0, 1, 2, 3, 4, 5, 7])
+classify([])
+"""
+        self._assert_first_hit_matches_full_mode(self.create_file("first_hit.py", script))
+
+    @unittest.skipIf(sys.version_info < (3, 12), "first-hit mode requires sys.monitoring")
+    def test_first_hit_branches_kept_apart_per_function(self):
+        # both branches sit at the same bytecode offset of the same file
+        script = """
+def f(x):
+    if x:
+        return 1
+    return 0
+def g(x):
+    if x:
+        return 1
+    return 0
+f(True)
+g(False)
+g(True)
+"""
+        self._assert_first_hit_matches_full_mode(self.create_file("same_shape.py", script))
+
+    def _assert_first_hit_matches_full_mode(self, script_path):
+        norm_path = os.path.normcase(os.path.realpath(script_path))
+
+        def run(mode, native):
+            cov = MiniCoverage(project_root=self.test_dir)
+            cov.config.collection_mode = mode
+            if not native:
+                cov.c_tracer = None
+            with self.capture_stdout():
+                cov.run(script_path)
+            results = cov.analyze()[norm_path]
+            return results['Statement']['executed'], results['Branch']['executed']
+
+        for native in (True, False):
+            with self.subTest(native=native):
+                full_lines, full_arcs = run('full', native)
+                lines, arcs = run('first-hit', native)
+                self.assertEqual(lines, full_lines)
+                self.assertEqual(arcs, full_arcs)
+
+    def test_async_branches_complete_across_awaits(self):
+        script = """
+import asyncio
+async def handle(n):
+    if await asyncio.sleep(0, n % 2):
+        kind = 'odd'
+    else:
+        kind = 'even'
+    await asyncio.sleep(0)
+    return kind
+async def main():
+    await asyncio.gather(*(handle(i) for i in range(20)))
+asyncio.run(main())
+"""
+        script_path = self.create_file("async_branches.py", script)
+        norm_path = os.path.normcase(os.path.realpath(script_path))
+
+        for native in (True, False):
+            with self.subTest(native=native):
+                cov = MiniCoverage(project_root=self.test_dir)
+                if not native:
+                    cov.c_tracer = None
+                    cov.sys_settrace_tracer.c_tracer = None
+                with self.capture_stdout():
+                    cov.run(script_path)
+                branch = cov.analyze()[norm_path]['Branch']
+                # both outcomes of the awaited condition are seen, whichever task ran last
+                self.assertEqual(set(branch['missing']), set())
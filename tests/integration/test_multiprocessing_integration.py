@@ -4,6 +4,8 @@ import shutil
 import tempfile
 import multiprocessing  # noqa: F401
 from src.engine import MiniCoverage
+from src.engine.arena import ARENA_ENV
+from src.engine.core import minicov_tracer
 
 
 class TestMultiprocessing(unittest.TestCase):
@@ -68,6 +70,187 @@ if __name__ == "__main__":
         worker_lines_hit = {5, 6, 7, 8}.intersection(lines)
         self.assertTrue(len(worker_lines_hit) > 0, "Child process lines were not captured")
 
+    def _run_script(self, code):
+        script_path = os.path.join(self.test_dir, "mp_script.py")
+        with open(script_path, "w") as f:
+            f.write(code)
+        cov = MiniCoverage(project_root=self.test_dir)
+        cov.run(script_path)
+        return cov, cov.path_manager.canonicalize(script_path)
+
+    def _partial_lines(self, canonical_path):
+        """
+        Lines of canonical_path per partial file, keyed by the pid that wrote it.
+        """
+        from contextlib import closing
+        import sqlite3
+        partials = {}
+        for name in os.listdir(self.test_dir):
+            if not name.startswith(".coverage.db.") or name.endswith("-journal"):
+                continue
+            pid = int(name.split(".")[3])
+            with closing(sqlite3.connect(os.path.join(self.test_dir, name))) as conn:
+                rows = conn.execute(
+                    "SELECT line_no FROM lines JOIN files ON files.id = lines.file_id WHERE path = ?",
+                    (canonical_path,)).fetchall()
+            partials.setdefault(pid, set()).update(row[0] for row in rows)
+        return partials
+
+    @unittest.skipUnless(hasattr(os, 'fork'), "requires fork")
+    def test_fork_child_saves_only_its_own_hits(self):
+        code = """\
+import multiprocessing
+
+def worker_fn():
+    x = 1
+    return x
+
+if __name__ == "__main__":
+    multiprocessing.set_start_method("fork", force=True)
+    before_fork = 1
+    p = multiprocessing.Process(target=worker_fn)
+    p.start()
+    p.join()
+"""
+        _, canonical_path = self._run_script(code)
+        partials = self._partial_lines(canonical_path)
+        children = [lines for pid, lines in partials.items() if pid != os.getpid()]
+
+        # one partial per child, holding the worker body but not the parent's lines
+        self.assertEqual(len(children), 1)
+        self.assertTrue({4, 5}.issubset(children[0]))
+        self.assertNotIn(9, children[0])
+        self.assertIn(9, partials[os.getpid()])
+
+    @unittest.skipUnless(hasattr(os, 'fork'), "requires fork")
+    def test_fork_pool_workers_covered(self):
+        code = """\
+import multiprocessing
+
+def square(n):
+    return n * n
+
+if __name__ == "__main__":
+    ctx = multiprocessing.get_context("fork")
+    pool = ctx.Pool(2)
+    pool.map(square, range(8))
+    pool.close()
+    pool.join()
+"""
+        cov, canonical_path = self._run_script(code)
+        partials = self._partial_lines(canonical_path)
+        children = [lines for pid, lines in partials.items() if pid != os.getpid()]
+
+        # pool workers are not CoverageProcess instances; the fork hooks cover them
+        self.assertTrue(children)
+        self.assertTrue(any(4 in lines for lines in children))
+        self.assertFalse(any(7 in lines for lines in children))
+
+    @unittest.skipUnless(hasattr(os, 'fork'), "requires fork")
+    def test_plain_fork_child_saves_at_exit(self):
+        import subprocess
+        import sys
+        script_path = os.path.join(self.test_dir, "server.py")
+        with open(script_path, "w") as f:
+            f.write("""\
+import os
+from src.engine import MiniCoverage
+
+def handle():
+    x = 1
+    return x
+
+cov = MiniCoverage(project_root=os.getcwd())
+cov.start()
+pid = os.fork()
+if pid == 0:
+    # a prefork worker: never stops the engine, just exits
+    handle()
+else:
+    os.waitpid(pid, 0)
+    handle()
+    cov.stop()
+""")
+        repo_root = os.path.dirname(self.src_path)
+        subprocess.run([sys.executable, script_path], cwd=self.test_dir, check=True,
+                       env=dict(os.environ, PYTHONPATH=repo_root))
+
+        canonical_path = MiniCoverage(project_root=self.test_dir).path_manager.canonicalize(script_path)
+        partials = self._partial_lines(canonical_path)
+        # the parent's partial and the worker's, both holding the handler
+        self.assertEqual(len(partials), 2)
+        for lines in partials.values():
+            self.assertTrue({5, 6}.issubset(lines))
+
+    def test_spawn_child_started_from_snapshot(self):
+        code = """\
+import multiprocessing
+
+def worker_fn():
+    x = 1
+    return x
+
+if __name__ == "__main__":
+    multiprocessing.set_start_method("spawn", force=True)
+    p = multiprocessing.Process(target=worker_fn)
+    p.start()
+    p.join()
+"""
+        cov, canonical_path = self._run_script(code)
+        cov.combine_data()
+        self.assertTrue({4, 5}.issubset(cov.trace_data['lines'][canonical_path][0]))
+
+
+    def _run_with_shared_arena(self, code):
+        with open(os.path.join(self.test_dir, ".coveragerc"), "w") as f:
+            f.write("[run]\nshared_arena = true\n")
+        cov, canonical_path = self._run_script(code)
+        partials = self._partial_lines(canonical_path)
+        # the creator removes the arena once it is saved
+        self.assertFalse([n for n in os.listdir(self.test_dir) if "-arena." in n])
+        self.assertNotIn(ARENA_ENV, os.environ)
+        return partials
+
+    @unittest.skipUnless(hasattr(os, 'fork') and minicov_tracer, "requires fork and the C extension")
+    def test_shared_arena_fork_children_write_no_partials(self):
+        code = """\
+import multiprocessing
+
+def square(n):
+    return n * n
+
+if __name__ == "__main__":
+    ctx = multiprocessing.get_context("fork")
+    pool = ctx.Pool(4)
+    pool.map(square, range(8))
+    pool.close()
+    pool.join()
+"""
+        partials = self._run_with_shared_arena(code)
+
+        # the workers' hits went into the arena, which the parent saved with its own
+        self.assertEqual(list(partials), [os.getpid()])
+        self.assertIn(4, partials[os.getpid()])
+
+    @unittest.skipUnless(minicov_tracer, "requires the C extension")
+    def test_shared_arena_spawn_child_attaches(self):
+        code = """\
+import multiprocessing
+
+def worker_fn():
+    x = 1
+    return x
+
+if __name__ == "__main__":
+    multiprocessing.set_start_method("spawn", force=True)
+    p = multiprocessing.Process(target=worker_fn)
+    p.start()
+    p.join()
+"""
+        partials = self._run_with_shared_arena(code)
+
+        self.assertEqual(list(partials), [os.getpid()])
+        self.assertTrue({4, 5}.issubset(partials[os.getpid()]))
 
 if __name__ == '__main__':
     unittest.main()
@@ -93,3 +93,74 @@ def foo():
         code = "while True: pass"
         cfg = self.build_cfg(code)
         self.assertGreater(len(cfg.successors), 0)
+
+    @staticmethod
+    def reference_dominators(cfg):
+        # the textbook iterative data-flow formulation
+        all_nodes = set(cfg.successors)
+        doms = {node: all_nodes.copy() for node in all_nodes}
+        doms[0] = {0}
+        changed = True
+        while changed:
+            changed = False
+            for node in all_nodes - {0}:
+                preds = cfg.predecessors[node]
+                if not preds:
+                    continue
+                new = set.intersection(*(doms[p] for p in preds)) | {node}
+                if new != doms[node]:
+                    doms[node], changed = new, True
+        return doms
+
+    def test_dominators_match_iterative_algorithm(self):
+        code = """
+def f(items, limit):
+    total = 0
+    for i in items:
+        if i > limit and i % 2:
+            break
+        while total < i:
+            try:
+                total += i or 1
+            except TypeError:
+                continue
+            finally:
+                total -= 1
+    else:
+        return -1
+    return total if total else None
+"""
+        module_co = self.compile_code(code)
+        for co in [module_co] + [c for c in module_co.co_consts if isinstance(c, types.CodeType)]:
+            cfg = ControlFlowGraph(co)
+            self.assertEqual(cfg.dominators, self.reference_dominators(cfg))
+            # the immediate dominator is the closest strict dominator
+            for node, parent in cfg.idom.items():
+                if node != 0:
+                    self.assertIn(parent, cfg.dominators[node])
+                    self.assertEqual(cfg.dominators[node] - {node}, cfg.dominators[parent])
+
+    def test_large_dispatch_table(self):
+        branches = "\n".join(f"    if op == {i}:\n        return {i}" for i in range(2000))
+        module_co = self.compile_code(f"def dispatch(op):\n{branches}\n    return -1\n")
+        cfg = ControlFlowGraph(next(c for c in module_co.co_consts if isinstance(c, types.CodeType)))
+
+        self.assertGreater(len(cfg.blocks), 2000)
+        self.assertEqual(len(cfg.get_jumps()), sum(len(t) for t in cfg.successors.values()))
+        # every block of the dispatch chain is reachable from the entry
+        self.assertEqual(len(cfg.idom), len(cfg.blocks))
+
+    def test_graph_shared_per_code_object(self):
+        from unittest.mock import patch
+        from src.metrics import ConditionCoverage, BytecodeControlFlow
+
+        co = self.compile_code("def f(a, b):\n    return a and b\n")
+        self.assertIs(ControlFlowGraph.of(co), ControlFlowGraph.of(co))
+
+        other = self.compile_code("def g(a, b):\n    return a or b\n")
+        with patch.object(ControlFlowGraph, '_find_leaders', autospec=True, side_effect=ControlFlowGraph._find_leaders) as built:
+            ConditionCoverage().get_possible_elements(other)
+            BytecodeControlFlow().get_possible_elements(other)
+        # module and function code, each built once for both metrics
+        self.assertEqual(built.call_count, 2)
+
@@ -1,6 +1,8 @@
 import unittest  # noqa: F401
 import os
+from unittest.mock import patch
 from src.reporters import HtmlReporter
+from src.reporters.html import HEAT_LEVELS, PARALLEL_MIN_PAGES, heat_level, source_lines
 from tests.test_utils import BaseTestCase
 
 
@@ -44,3 +46,78 @@ class TestHtmlReporter(BaseTestCase):
         expected_html_file = f"{sanitized_name}.html"
 
         self.assertTrue(os.path.exists(os.path.join(out_dir, expected_html_file)))
+
+    def test_hit_counts_shown_as_heat(self):
+        self.results[self.filepath]['HitCounts'] = {'lines': {1: 1000}, 'arcs': {}}
+        reporter = HtmlReporter(output_dir="htmlcov")
+        with self.capture_stdout():
+            reporter.generate(self.results, self.project_root)
+
+        with open(os.path.join("htmlcov", "main_py.html")) as f:
+            page = f.read()
+        self.assertIn(f'<span class="hits heat{HEAT_LEVELS}" title="1000 executions">1000</span>', page)
+        # the line that never ran gets an empty gutter cell
+        self.assertIn('<span class="hits"></span><span class="lineno">2</span>', page)
+
+    def test_heat_levels_use_a_log_scale(self):
+        self.assertEqual(heat_level(1, 1), 1)
+        self.assertEqual(heat_level(1, 10000), 1)
+        self.assertEqual(heat_level(100, 10000), 3)
+        self.assertEqual(heat_level(10000, 10000), HEAT_LEVELS)
+
+    def test_source_taken_from_reader(self):
+        out_dir = os.path.join(self.test_dir, "htmlcov")
+        reporter = HtmlReporter(output_dir=out_dir)
+        reporter.source_reader = lambda filename: b"first = 1\r\nsecond = 2\r\n"
+
+        with patch('builtins.open', wraps=open) as opened, self.capture_stdout():
+            reporter.generate(self.results, self.project_root)
+        self.assertNotIn(self.filepath, [c.args[0] for c in opened.call_args_list])
+
+        with open(os.path.join(out_dir, "main_py.html")) as f:
+            page = f.read()
+        self.assertIn("first = 1", page)
+        self.assertIn('<span class="lineno">2</span>', page)
+        self.assertNotIn('<span class="lineno">3</span>', page)
+
+    def test_parallel_pages_match_sequential(self):
+        results = {}
+        for i in range(PARALLEL_MIN_PAGES):
+            path = self.create_file(f"mod{i}.py", "a = 1\nif a:\n    b = 2\n")
+            results[path] = {
+                'Statement': {'pct': 66.0, 'missing': {3}, 'executed': {1, 2}, 'possible': {1, 2, 3}},
+                'Branch': {'pct': 50.0, 'missing': {(2, 3)}, 'executed': {(2, -1)}, 'possible': {(2, 3), (2, -1)}},
+            }
+
+        pages = {}
+        for jobs in (1, 2):
+            out_dir = os.path.join(self.test_dir, f"htmlcov{jobs}")
+            with self.capture_stdout():
+                HtmlReporter(output_dir=out_dir, jobs=jobs).generate(results, self.project_root)
+            pages[jobs] = {}
+            for name in sorted(os.listdir(out_dir)):
+                with open(os.path.join(out_dir, name)) as f:
+                    pages[jobs][name] = f.read()
+
+        self.assertEqual(len(pages[2]), PARALLEL_MIN_PAGES + 1)
+        self.assertEqual(pages[1], pages[2])
+        self.assertIn("Missed branch to: 3", pages[2]["mod0_py.html"])
+
+    def test_broken_pool_falls_back_to_in_process(self):
+        results = {}
+        for i in range(PARALLEL_MIN_PAGES):
+            path = self.create_file(f"mod{i}.py", "a = 1\n")
+            results[path] = {'Statement': {'pct': 100.0, 'missing': set(), 'executed': {1}, 'possible': {1}}}
+
+        out_dir = os.path.join(self.test_dir, "htmlcov")
+        with patch('src.reporters.html.ProcessPoolExecutor') as pool_class, self.capture_stdout():
+            pool_class.return_value.submit.side_effect = OSError("worker died")
+            with self.assertLogs('src.reporters.html', level='WARNING'):
+                HtmlReporter(output_dir=out_dir, jobs=2).generate(results, self.project_root)
+        self.assertEqual(len(os.listdir(out_dir)), PARALLEL_MIN_PAGES + 1)
+
+    def test_source_lines_match_text_mode(self):
+        self.assertEqual(source_lines(b"a\r\nb\rc"), ["a\n", "b\n", "c"])
+        self.assertEqual(source_lines(b"a\n\n"), ["a\n", "\n"])
+        # form feeds are not line breaks for the tokenizer either
+        self.assertEqual(source_lines(b"a\x0cb\n"), ["a\x0cb\n"])
@@ -48,6 +48,14 @@ class TestJsonReporter(BaseTestCase):
         self.assertIn(rel_name, data["files"])
         self.assertEqual(data["files"][rel_name]["Statement"]["missing"], [2])
 
+    def test_hit_counts_exported(self):
+        self.results[self.filepath]['HitCounts'] = {'lines': {1: 7}, 'arcs': {(1, 2): 3}}
+        with self.capture_stdout():
+            JsonReporter("c.json").generate(self.results, self.project_root)
+        with open("c.json") as f:
+            counts = json.load(f)["files"]["main.py"]["HitCounts"]
+        self.assertEqual(counts, {'lines': {'1': 7}, 'arcs': [[1, 2, 3]]})
+
     def test_empty_results(self):
         empty = {}
         JsonReporter("e.json").generate(empty, self.test_dir)
@@ -1,6 +1,7 @@
 import unittest  # noqa: F401
 import os
 import xml.etree.ElementTree as ET
+from unittest.mock import patch
 from src.reporters import XmlReporter
 from tests.test_utils import BaseTestCase
 
@@ -57,3 +58,20 @@ class TestXmlReporter(BaseTestCase):
         XmlReporter("e.xml").generate(empty, self.test_dir)
         tree = ET.parse("e.xml")
         self.assertEqual(tree.getroot().attrib["lines-covered"], "0")
+
+    def test_classes_written_without_element_tree(self):
+        path = self.create_file('we"ird & name.py', "a = 1\n")
+        self.results[path] = {
+            'Statement': {'pct': 100.0, 'missing': set(), 'executed': {1}, 'possible': {1}},
+        }
+        # only the small document skeleton goes through ElementTree
+        with patch('xml.etree.ElementTree.SubElement', wraps=ET.SubElement) as sub, self.capture_stdout():
+            XmlReporter("s.xml").generate(self.results, self.project_root)
+        self.assertEqual(sub.call_count, 5)
+
+        root = ET.parse("s.xml").getroot()
+        cls = root.find(".//class[@name='we\"ird & name']")
+        self.assertEqual(cls.attrib["filename"], 'we"ird & name.py')
+        lines = root.findall(f".//class[@filename='{self.filename}']/lines/line")
+        self.assertEqual([(l.attrib["number"], l.attrib["hits"]) for l in lines], [("1", "1"), ("2", "0")])
+        self.assertEqual(lines[0].attrib["condition-coverage"], "0% (0/1)")
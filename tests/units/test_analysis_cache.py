@@ -0,0 +1,134 @@
+import ast
+import json
+import os
+import xml.etree.ElementTree as ET
+import unittest
+from unittest.mock import patch
+from src.engine import MiniCoverage
+from src.engine.analysis_cache import AnalysisCache
+from tests.test_utils import BaseTestCase
+
+SOURCE = """\
+def decide(a, b):
+    if a and b:
+        return 1
+    return 0
+"""
+
+
+class TestAnalysisCache(BaseTestCase):
+
+    def setUp(self):
+        super().setUp()
+        self.path = self.create_file("target.py", SOURCE)
+
+    def analyze(self, lines=(1, 2, 4)):
+        cov = MiniCoverage(project_root=self.test_dir)
+        path = cov.path_manager.canonicalize(self.path)
+        cov.trace_data['lines'][path][0].update(lines)
+        return cov, cov.analyze()[path]
+
+    def test_source_read_once_per_file(self):
+        cov = MiniCoverage(project_root=self.test_dir)
+        cov.trace_data['lines'][cov.path_manager.canonicalize(self.path)][0].add(1)
+        with patch.object(cov.parser, 'read_source', wraps=cov.parser.read_source) as read, \
+                patch('builtins.compile', wraps=compile) as compiled:
+            cov.analyze()
+        self.assertEqual(read.call_count, 1)
+        # the code object is compiled from the parsed tree, not from the text again
+        sources = [c.args[0] for c in compiled.call_args_list]
+        self.assertEqual(len([s for s in sources if isinstance(s, ast.Module)]), 1)
+        self.assertEqual(len([s for s in sources if isinstance(s, str)]), 1)
+
+    def test_unchanged_file_skips_static_analysis(self):
+        _, first = self.analyze()
+        self.assertTrue(os.path.exists(".coverage.analysis"))
+
+        cov = MiniCoverage(project_root=self.test_dir)
+        path = cov.path_manager.canonicalize(self.path)
+        cov.trace_data['lines'][path][0].update((1, 2, 4))
+        with patch.object(cov.parser, 'parse', side_effect=AssertionError("parsed again")):
+            second = cov.analyze()[path]
+
+        for name in ("Statement", "Branch", "Condition"):
+            self.assertEqual(second[name]['possible'], first[name]['possible'])
+            self.assertEqual(second[name]['pct'], first[name]['pct'])
+        self.assertTrue(all(isinstance(arc, tuple) for arc in second["Branch"]['possible']))
+
+    def test_changed_file_is_analyzed_again(self):
+        self.analyze()
+        self.create_file("target.py", SOURCE + "x = decide(1, 2)\n")
+        _, result = self.analyze()
+        self.assertIn(5, result["Statement"]['possible'])
+
+    def test_key_depends_on_exclusions_and_metrics(self):
+        key = AnalysisCache.key_for(b"x = 1\n", [], ["Statement"])
+        self.assertEqual(key, AnalysisCache.key_for(b"x = 1\n", [], ["Statement"]))
+        self.assertNotEqual(key, AnalysisCache.key_for(b"x = 1\n", ["no cover"], ["Statement"]))
+        self.assertNotEqual(key, AnalysisCache.key_for(b"x = 1\n", [], ["Statement", "Branch"]))
+
+    def test_unusable_cache_falls_back_to_analysis(self):
+        with open(".coverage.analysis", "w") as f:
+            f.write("not a database")
+        _, result = self.analyze()
+        self.assertEqual(result["Statement"]['possible'], {1, 2, 3, 4})
+
+    def test_cache_can_be_disabled(self):
+        cov = MiniCoverage(project_root=self.test_dir)
+        cov.config.analysis_cache = ''
+        cov.analyzer.cache = None
+        cov.trace_data['lines'][cov.path_manager.canonicalize(self.path)][0].add(1)
+        cov.analyze()
+        self.assertFalse(os.path.exists(".coverage.analysis"))
+
+
+class TestReportCache(BaseTestCase):
+
+    def setUp(self):
+        super().setUp()
+        self.path = self.create_file("target.py", SOURCE)
+        self.other = self.create_file("other.py", "y = 2\n")
+
+    def report(self, lines=(1, 2, 4)):
+        cov = MiniCoverage(project_root=self.test_dir)
+        cov.trace_data['lines'][cov.path_manager.canonicalize(self.path)][0].update(lines)
+        cov.trace_data['lines'][cov.path_manager.canonicalize(self.other)][0].add(1)
+        cov.save_data()
+        caches = []
+        original = cov.analyzer.report_cache
+        with patch.object(cov.analyzer, 'report_cache', side_effect=lambda root: caches.append(original(root)) or caches[-1]), \
+                self.capture_stdout():
+            cov.report(['html', 'xml', 'json'])
+        return caches[0]
+
+    def test_unchanged_files_reuse_output(self):
+        first = self.report()
+        self.assertEqual((first.reused, first.rendered), (0, 6))
+        xml_before = ET.parse("coverage.xml").getroot().find(".//classes")
+        json_before = json.load(open("coverage.json"))['files']
+
+        second = self.report()
+        self.assertEqual((second.reused, second.rendered), (6, 0))
+        xml_after = ET.parse("coverage.xml").getroot().find(".//classes")
+        self.assertEqual(ET.tostring(xml_after), ET.tostring(xml_before))
+        self.assertEqual(json.load(open("coverage.json"))['files'], json_before)
+        self.assertTrue(os.path.exists(os.path.join("htmlcov", "target_py.html")))
+
+    def test_changed_trace_data_renders_file_again(self):
+        self.report()
+        second = self.report(lines=(1, 2, 3))
+        # only target.py changed (now fully covered), for each of the three reporters
+        self.assertEqual((second.reused, second.rendered), (3, 3))
+        stmt = json.load(open("coverage.json"))['files']['target.py']['Statement']
+        self.assertEqual(stmt['missing'], [])
+
+    def test_deleted_html_page_is_written_again(self):
+        self.report()
+        os.remove(os.path.join("htmlcov", "target_py.html"))
+        second = self.report()
+        self.assertEqual(second.rendered, 1)
+        self.assertTrue(os.path.exists(os.path.join("htmlcov", "target_py.html")))
+
+
+if __name__ == '__main__':
+    unittest.main()
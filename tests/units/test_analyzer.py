@@ -0,0 +1,51 @@
+import unittest
+from unittest.mock import patch
+from src.engine import MiniCoverage
+from src.engine.analyzer import PARALLEL_MIN_FILES
+from tests.test_utils import BaseTestCase
+
+
+class TestParallelAnalysis(BaseTestCase):
+
+    def setUp(self):
+        super().setUp()
+        self.sources = {}
+        for i in range(PARALLEL_MIN_FILES + 4):
+            self.sources[f"mod_{i}.py"] = (
+                f"def f_{i}(a, b):\n"
+                f"    if a and b:\n"
+                f"        return {i}\n"
+                f"    return 0\n"
+            )
+
+    def analyze(self, jobs):
+        cov = MiniCoverage(project_root=self.test_dir)
+        cov.config.analysis_jobs = jobs
+        cov.analyzer.cache = None
+        for name, source in self.sources.items():
+            path = cov.path_manager.canonicalize(self.create_file(name, source))
+            cov.trace_data['lines'][path][0].update({1, 2, 4})
+            cov.trace_data['arcs'][path][0].add((2, 4))
+        return cov, cov.analyze()
+
+    def test_worker_pool_matches_in_process_analysis(self):
+        _, sequential = self.analyze(jobs=1)
+        _, parallel = self.analyze(jobs=3)
+        self.assertEqual(len(parallel), len(self.sources))
+        self.assertEqual(parallel, sequential)
+
+    def test_pool_failure_falls_back_to_in_process(self):
+        with patch('src.engine.analyzer.ProcessPoolExecutor', side_effect=OSError("no processes")):
+            with self.assertLogs('src.engine.analyzer', level='WARNING'):
+                _, results = self.analyze(jobs=2)
+        self.assertEqual(len(results), len(self.sources))
+
+    def test_small_runs_stay_in_process(self):
+        self.sources = dict(list(self.sources.items())[:2])
+        with patch('src.engine.analyzer.ProcessPoolExecutor', side_effect=AssertionError("pool started")):
+            _, results = self.analyze(jobs=4)
+        self.assertEqual(len(results), 2)
+
+
+if __name__ == '__main__':
+    unittest.main()
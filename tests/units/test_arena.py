@@ -0,0 +1,87 @@
+import os
+import struct
+import unittest
+from src.engine.arena import SharedArena
+from tests.test_utils import BaseTestCase
+
+
+def _pair_key(kind, a, b):
+    return ((kind << 62) | (a << 31) | b) + 1
+
+
+class TestSharedArena(BaseTestCase):
+
+    def setUp(self):
+        super().setUp()
+        self.path = os.path.join(self.test_dir, "arena")
+        self.arena = SharedArena.create(self.path, {"/src/a.py": 10, "/src/b.py": 200})
+
+    def tearDown(self):
+        self.arena.close()
+        super().tearDown()
+
+    def set_line(self, arena, name, line):
+        lines_offset = arena.regions[name][0]
+        word = lines_offset + 8 * (line // 64)
+        value = struct.unpack_from('Q', arena.buffer, word)[0]
+        struct.pack_into('Q', arena.buffer, word, value | (1 << (line % 64)))
+
+    def set_pair(self, arena, name, slot, kind, a, b):
+        pairs_offset = arena.regions[name][2]
+        struct.pack_into('Q', arena.buffer, pairs_offset + 8 * slot, _pair_key(kind, a, b))
+
+    def test_regions_aligned_and_disjoint(self):
+        spans = []
+        for lines_offset, nlines, pairs_offset, capacity in self.arena.regions.values():
+            self.assertEqual(lines_offset % 64, 0)
+            self.assertEqual(pairs_offset % 64, 0)
+            self.assertEqual(capacity & (capacity - 1), 0)
+            self.assertGreaterEqual(capacity, 2 * nlines)
+            spans.append((lines_offset, pairs_offset + 8 * capacity))
+        spans.sort()
+        self.assertLessEqual(spans[0][1], spans[1][0])
+        self.assertLessEqual(spans[1][1], len(self.arena.buffer))
+
+    def test_open_sees_the_same_regions_and_hits(self):
+        other = SharedArena.open(self.path)
+        try:
+            self.assertEqual(other.regions, self.arena.regions)
+            self.set_line(other, "/src/b.py", 130)
+            self.set_pair(other, "/src/b.py", 3, 0, 129, 130)
+        finally:
+            other.close()
+
+        hits = self.arena.take_new()
+        self.assertEqual(hits, {"/src/b.py": ({130}, {(129, 130)}, set())})
+
+    def test_take_new_returns_each_hit_once(self):
+        self.set_line(self.arena, "/src/a.py", 1)
+        self.set_pair(self.arena, "/src/a.py", 0, 1, 4, 12)
+        self.assertEqual(self.arena.take_new(), {"/src/a.py": ({1}, set(), {(4, 12)})})
+        self.assertEqual(self.arena.take_new(), {})
+
+        self.set_line(self.arena, "/src/a.py", 2)
+        self.assertEqual(self.arena.take_new(), {"/src/a.py": ({2}, set(), set())})
+
+    def test_stopped_flag_shared(self):
+        other = SharedArena.open(self.path)
+        try:
+            self.assertFalse(other.stopped)
+            self.arena.mark_stopped()
+            self.assertTrue(other.stopped)
+        finally:
+            other.close()
+
+    def test_open_rejects_missing_and_foreign_files(self):
+        self.assertIsNone(SharedArena.open(os.path.join(self.test_dir, "missing")))
+        foreign = self.create_file("foreign", "not an arena, but long enough to read a header\n")
+        self.assertIsNone(SharedArena.open(foreign))
+
+    def test_close_unlink_removes_file(self):
+        other = SharedArena.create(os.path.join(self.test_dir, "other"), {})
+        other.close(unlink=True)
+        self.assertFalse(os.path.exists(other.path))
+
+
+if __name__ == '__main__':
+    unittest.main()
@@ -0,0 +1,34 @@
+import json
+import unittest
+from benchmarks import run_benchmarks
+from tests.test_utils import BaseTestCase
+
+
+class TestBenchmarks(BaseTestCase):
+
+    def test_report_shape(self):
+        report = run_benchmarks.benchmark(['tight_loop'], ['settrace-python', 'settrace-c'], repeat=1, scale=0.01)
+        json.dumps(report)
+
+        self.assertIn('python', report)
+        backends = {r['backend'] for r in report['results']} | set(report['skipped_backends'])
+        self.assertEqual(backends, {'settrace-python', 'settrace-c'})
+
+        for result in report['results']:
+            self.assertEqual(result['workload'], 'tight_loop')
+            self.assertGreater(result['line_events'], 0)
+            self.assertGreater(result['overhead_ratio'], 0)
+            self.assertGreater(result['trace_data_bytes'], 0)
+
+    def test_unavailable_backends_are_skipped(self):
+        report = run_benchmarks.benchmark(['tight_loop'], ['monitoring-python'], repeat=1, scale=0.01)
+        reason = run_benchmarks.backend_available('monitoring-python')
+        if reason:
+            self.assertEqual(report['skipped_backends'], {'monitoring-python': reason})
+            self.assertEqual(report['results'], [])
+        else:
+            self.assertEqual(len(report['results']), 1)
+
+
+if __name__ == '__main__':
+    unittest.main()
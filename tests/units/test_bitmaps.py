@@ -0,0 +1,66 @@
+import unittest
+from src.engine import bitmaps
+
+
+class TestBitmaps(unittest.TestCase):
+
+    def test_lines_round_trip(self):
+        lines = {1, 2, 7, 8, 9, 64, 1000}
+        self.assertEqual(bitmaps.decode_lines(bitmaps.encode_lines(lines)), lines)
+        self.assertEqual(bitmaps.decode_lines(bitmaps.encode_lines(set())), set())
+
+    def test_lines_merge_is_union(self):
+        merged = bitmaps.merge_lines(bitmaps.encode_lines({1, 500}), bitmaps.encode_lines({3}))
+        self.assertEqual(bitmaps.decode_lines(merged), {1, 3, 500})
+
+    def test_pairs_round_trip_and_merge(self):
+        arcs = {(1, 2), (2, -1), (-3, 10)}
+        blob = bitmaps.encode_pairs(arcs)
+        self.assertEqual(bitmaps.decode_pairs(blob), arcs)
+        # equal sets give equal blobs regardless of iteration order
+        self.assertEqual(blob, bitmaps.encode_pairs(list(reversed(sorted(arcs)))))
+
+        merged = bitmaps.merge_pairs(blob, bitmaps.encode_pairs({(5, 6), (1, 2)}))
+        self.assertEqual(bitmaps.decode_pairs(merged), arcs | {(5, 6)})
+
+    def test_dense_lines_are_smaller_than_rows(self):
+        blob = bitmaps.encode_lines(range(1, 5000))
+        self.assertLess(len(blob), 5000)
+
+    def test_any_line_in_range(self):
+        blob = bitmaps.encode_lines({5, 300})
+        self.assertTrue(bitmaps.any_line_in_range(blob, 1, 5))
+        self.assertTrue(bitmaps.any_line_in_range(blob, 299, 1000))
+        self.assertFalse(bitmaps.any_line_in_range(blob, 6, 299))
+        self.assertFalse(bitmaps.any_line_in_range(blob, 9, 1))
+
+    def test_delta_round_trip(self):
+        trace = {'lines': {'a.py': {0: {1, 2}, 3: {5}, 4: set()}},
+                 'arcs': {'a.py': {3: {(1, 2)}}},
+                 'instruction_arcs': {}}
+        delta = bitmaps.encode_delta(trace, {0: 'default', 3: 'test_x', 4: 'unused'})
+
+        # only contexts with data are sent
+        self.assertEqual(delta['contexts'], [[0, 'default'], [3, 'test_x']])
+        self.assertEqual(sorted(bitmaps.decode_delta(delta)), [
+            ('arcs', 'a.py', 'test_x', {(1, 2)}),
+            ('lines', 'a.py', 'default', {1, 2}),
+            ('lines', 'a.py', 'test_x', {5}),
+        ])
+
+    def test_delta_carries_hit_counts(self):
+        trace = {'lines': {'a.py': {0: {1, 2}}}, 'arcs': {}, 'instruction_arcs': {},
+                 'line_counts': {'a.py': {0: {1: 3, 2: 2 ** 40}}},
+                 'arc_counts': {'a.py': {0: {(1, 2): 2, (2, -1): 1}}}}
+        decoded = {(kind, label): values for kind, _, label, values in
+                   bitmaps.decode_delta(bitmaps.encode_delta(trace, {0: 'default'}))}
+        self.assertEqual(decoded[('line_counts', 'default')], {1: 3, 2: 2 ** 40})
+        self.assertEqual(decoded[('arc_counts', 'default')], {(1, 2): 2, (2, -1): 1})
+
+    def test_delta_version_checked(self):
+        with self.assertRaises(ValueError):
+            list(bitmaps.decode_delta({'version': 0}))
+
+
+if __name__ == '__main__':
+    unittest.main()
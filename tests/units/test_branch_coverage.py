@@ -2,7 +2,6 @@ import unittest
 import os
 import sys
 import types
-import ast
 from unittest.mock import MagicMock, patch
 from src.engine import MiniCoverage
 from src.engine.config_loader import ConfigLoader
@@ -71,12 +70,14 @@ class TestBranchCoverage(unittest.TestCase):
         self.assertIsNone(self.cov.thread_local.last_line)
         self.assertIsNone(self.cov.thread_local.last_lasti)
 
-    def test_trace_function_clears_history(self):
-        """Test that trace_function clears history on call/return."""
+    def test_trace_function_keeps_history_per_frame(self):
+        """Test that trace_function starts a fresh history on call and restores the caller's on return."""
         frame = MagicMock()
         frame.f_code.co_filename = "test.py"
+        frame.f_code.co_flags = 0
 
         # Test 'call' event
+        self.cov.thread_local.last_file = "test.py"
         self.cov.thread_local.last_line = 10
         self.cov.thread_local.last_lasti = 20
         self.cov.sys_settrace_tracer.trace_function(frame, "call", None)
@@ -84,7 +85,12 @@ class TestBranchCoverage(unittest.TestCase):
         self.assertIsNone(self.cov.thread_local.last_lasti)
 
         # Test 'return' event
-        self.cov.thread_local.last_line = 10
+        self.cov.thread_local.last_line = 3
+        self.cov.sys_settrace_tracer.trace_function(frame, "return", None)
+        self.assertEqual(self.cov.thread_local.last_line, 10)
+        self.assertEqual(self.cov.thread_local.last_lasti, 20)
+
+        # a frame that started before tracing did has no caller history
         self.cov.sys_settrace_tracer.trace_function(frame, "return", None)
         self.assertIsNone(self.cov.thread_local.last_line)
 
@@ -112,6 +118,37 @@ class TestBranchCoverage(unittest.TestCase):
             res = loader._load_ini("dummy.ini", config)
             self.assertTrue(res)
             self.assertIn("*.tmp", config.omit)
+            self.assertEqual(config.collection_mode, 'full')
+
+            with open("dummy.ini", "w") as f:
+                f.write("[run]\ncollection_mode = first-hit")
+            loader._load_ini("dummy.ini", config)
+            self.assertEqual(config.collection_mode, 'first-hit')
+
+            self.assertEqual(config.storage_format, 'rows')
+            with open("dummy.ini", "w") as f:
+                f.write("[run]\nstorage_format = bitmap")
+            loader._load_ini("dummy.ini", config)
+            self.assertEqual(config.storage_format, 'bitmap')
+
+            with open("dummy.ini", "w") as f:
+                f.write("[run]\nflush_interval = 30\nflush_max_hits = 100000")
+            loader._load_ini("dummy.ini", config)
+            self.assertEqual(config.flush_interval, 30.0)
+            self.assertEqual(config.flush_max_hits, 100000)
+
+            self.assertFalse(config.shared_arena)
+            with open("dummy.ini", "w") as f:
+                f.write("[run]\nshared_arena = true")
+            loader._load_ini("dummy.ini", config)
+            self.assertTrue(config.shared_arena)
+
+            with open("dummy.ini", "w") as f:
+                f.write("[run]\nanalysis_jobs = 0\ncombine_jobs = 4\nreport_jobs = 2")
+            loader._load_ini("dummy.ini", config)
+            self.assertEqual(config.analysis_jobs, 0)
+            self.assertEqual(config.combine_jobs, 4)
+            self.assertEqual(config.report_jobs, 2)
         finally:
             if os.path.exists("dummy.ini"):
                 os.remove("dummy.ini")
@@ -144,12 +181,10 @@ class TestBranchCoverage(unittest.TestCase):
                     self.cov.trace_data['lines'][f2][0].add(2)
 
                     # Mock dependencies
-                    # Use real AST and Code Object to ensure metrics work and don't crash
-                    real_ast = ast.parse("x=1\ny=2")
-                    real_code = compile("x=1\ny=2", "file.py", "exec")
-
-                    self.cov.parser.parse_source = MagicMock(return_value=(real_ast, set()))
-                    self.cov.parser.compile_source = MagicMock(return_value=real_code)
+                    # Use real source so the AST and Code Object metrics work and don't crash
+                    self.cov.parser.read_source = MagicMock(return_value=b"x=1\ny=2")
+                    # runs in the real cwd, keep the analysis cache out of it
+                    self.cov.analyzer.cache = None
                     self.cov.path_manager.should_trace = MagicMock(return_value=True)
 
                     # Run analyze
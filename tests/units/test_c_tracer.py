@@ -0,0 +1,466 @@
+import unittest
+import os
+import sys
+import dis
+import threading
+import textwrap
+import types
+from src.engine import MiniCoverage
+from src.engine.core import minicov_tracer
+from src.engine.arena import SharedArena
+from tests.test_utils import BaseTestCase
+
+# tasks interleaving at every await, with a branch decided by an awaited value
+ASYNC_SOURCE = """\
+import asyncio
+async def handle(n):
+    if await asyncio.sleep(0, n % 2):
+        kind = 'odd'
+    else:
+        kind = 'even'
+    await asyncio.sleep(0)
+    return kind
+async def main():
+    await asyncio.gather(*(handle(i) for i in range(4)))
+asyncio.run(main())
+"""
+ASYNC_ARCS = {(3, 4), (3, 6), (4, 7), (6, 7), (7, 8)}
+
+
+@unittest.skipIf(minicov_tracer is None, "C extension not built")
+class TestCTracer(BaseTestCase):
+
+    def setUp(self):
+        super().setUp()
+        self.cov = MiniCoverage(project_root=self.test_dir)
+
+    def trace_source(self, source, name="target.py"):
+        source = textwrap.dedent(source)
+        path = self.cov.path_manager.canonicalize(self.create_file(name, source))
+        code = compile(source, path, "exec")
+
+        self.cov.sys_settrace_tracer.start()
+        try:
+            exec(code, {"__name__": "__main__"})
+        finally:
+            self.cov.sys_settrace_tracer.stop()
+        return path
+
+    def test_hits_buffered_until_drain(self):
+        path = self.trace_source("""\
+        x = 1
+        y = 2
+        """)
+        self.assertNotIn(path, self.cov.trace_data['lines'])
+
+        self.cov.c_tracer.drain()
+        self.assertEqual(self.cov.trace_data['lines'][path][0], {1, 2})
+        self.assertIn((1, 2), self.cov.trace_data['arcs'][path][0])
+
+    def test_pending_counts_buffered_hits(self):
+        self.trace_source("x = 1\ny = 2\n")
+        self.assertGreater(self.cov.c_tracer.pending(), 0)
+        self.cov.c_tracer.drain()
+        self.assertEqual(self.cov.c_tracer.pending(), 0)
+
+    def test_drain_resets_buffers(self):
+        path = self.trace_source("x = 1\n")
+        self.cov.c_tracer.drain()
+        self.cov.trace_data['lines'][path][0].clear()
+
+        # a second drain must not replay already drained hits
+        self.cov.c_tracer.drain()
+        self.assertEqual(self.cov.trace_data['lines'][path][0], set())
+
+    def test_instruction_arcs_recorded(self):
+        source = """\
+        def decide(a, b):
+            if a and b:
+                return 1
+            return 0
+        decide(True, False)
+        """
+        path = self.trace_source(source)
+        self.cov.c_tracer.drain()
+        arcs = self.cov.trace_data['instruction_arcs'][path][0]
+        self.assertGreater(len(arcs), 0)
+
+        # only arcs leaving a boolean jump are recorded
+        code = compile(textwrap.dedent(source), path, "exec").co_consts[0]
+        jumps = {i.offset for i in dis.get_instructions(code) if i.opname.startswith('POP_JUMP_') or 'JUMP_IF_' in i.opname}
+        self.assertTrue(all(a in jumps for a, _ in arcs))
+
+    def test_opcode_tracing_limited_to_boolean_jumps(self):
+        source = "import sys\nframe = sys._getframe()\n"
+        path = self.cov.path_manager.canonicalize(self.create_file("target.py", source))
+        namespace = {}
+        exec(compile(source, path, "exec"), namespace)
+
+        # module code without any boolean jump gets no per-instruction events
+        self.cov.c_tracer(namespace['frame'], 'call', None)
+        self.assertFalse(namespace['frame'].f_trace_opcodes)
+
+        source = "import sys\nframe = sys._getframe()\nif frame:\n    pass\n"
+        exec(compile(source, path, "exec"), namespace)
+        self.cov.c_tracer(namespace['frame'], 'call', None)
+        self.assertTrue(namespace['frame'].f_trace_opcodes)
+
+    def test_threads_record_into_own_buffers(self):
+        path = self.trace_source("""\
+        import threading
+        def worker():
+            a = 1
+            b = 2
+        threads = [threading.Thread(target=worker) for _ in range(4)]
+        for t in threads:
+            t.start()
+        for t in threads:
+            t.join()
+        """)
+        self.cov.c_tracer.drain()
+        lines = self.cov.trace_data['lines'][path][0]
+        self.assertTrue({3, 4}.issubset(lines))
+        self.assertIn((3, 4), self.cov.trace_data['arcs'][path][0])
+
+    def test_save_data_drains_buffers(self):
+        path = self.trace_source("x = 1\n")
+        self.cov.save_data()
+        self.assertIn(1, self.cov.trace_data['lines'][path][0])
+
+    def test_arc_history_kept_natively(self):
+        path = self.trace_source("""\
+        def callee():
+            return 1
+        x = callee()
+        y = 2
+        """)
+        self.cov.c_tracer.drain()
+        arcs = self.cov.trace_data['arcs'][path][0]
+
+        # every frame has its own history, so no arc links caller and callee lines
+        self.assertNotIn((3, 2), arcs)
+        self.assertNotIn((2, 4), arcs)
+        # and the caller's comes back on RETURN
+        self.assertIn((3, 4), arcs)
+        # the Python-level thread local is no longer used by the C tracer
+        self.assertFalse(hasattr(self.cov.thread_local, 'last_line'))
+
+    def test_arcs_continue_across_awaits(self):
+        path = self.trace_source(ASYNC_SOURCE)
+        self.cov.c_tracer.drain()
+        arcs = self.cov.trace_data['arcs'][path][0]
+
+        self.assertTrue(ASYNC_ARCS.issubset(arcs))
+        # a task resuming does not continue the arc chain of the one that just yielded
+        self.assertNotIn((7, 3), arcs)
+        self.assertNotIn((8, 3), arcs)
+
+    def test_untraceable_frames_lose_local_trace(self):
+        code = compile("import sys\nframe = sys._getframe()\n", "/outside/project.py", "exec")
+        namespace = {}
+        exec(code, namespace)
+        self.assertIsNone(self.cov.c_tracer(namespace['frame'], 'call', None))
+
+        path = self.cov.path_manager.canonicalize(self.create_file("target.py", "import sys\nframe = sys._getframe()\n"))
+        exec(compile("import sys\nframe = sys._getframe()\n", path, "exec"), namespace)
+        self.assertIs(self.cov.c_tracer(namespace['frame'], 'call', None), self.cov.c_tracer)
+
+    def test_traceability_decided_once_per_code_object(self):
+        source = "import sys\nframe = sys._getframe()\n"
+        path = self.cov.path_manager.canonicalize(self.create_file("target.py", source))
+        code = compile(source, path, "exec")
+        namespace = {}
+        exec(code, namespace)
+        self.assertIs(self.cov.c_tracer(namespace['frame'], 'call', None), self.cov.c_tracer)
+
+        # the decision lives on the code object, the filename cache is not consulted again
+        self.cov._cache_traceable[path] = False
+        self.assertIs(self.cov.c_tracer(namespace['frame'], 'call', None), self.cov.c_tracer)
+
+    def test_sampled_out_code_is_not_traced(self):
+        self.cov.c_tracer.sample_rate = 0.0
+        path = self.trace_source("x = 1\n")
+        self.cov.c_tracer.drain()
+        self.assertNotIn(path, self.cov.trace_data['lines'])
+
+        # the decision is kept per code object, a full rate only applies to new code
+        self.cov.c_tracer.sample_rate = 1.0
+        path = self.trace_source("y = 2\n", name="other.py")
+        self.cov.c_tracer.drain()
+        self.assertEqual(self.cov.trace_data['lines'][path][0], {1})
+
+    def test_stats_count_events_and_buffer_inserts(self):
+        path = self.trace_source("""\
+        for i in range(3):
+            x = i
+        """)
+        stats = self.cov.c_tracer.stats()
+        self.assertGreater(stats['events']['line'], 0)
+        self.assertGreater(stats['file_events'][path], 0)
+        # the loop body repeats hits already buffered
+        self.assertGreater(stats['duplicates'], 0)
+        self.assertEqual(stats['inserts'], self.cov.c_tracer.pending())
+
+        # drained hits stay counted
+        pending = self.cov.c_tracer.pending()
+        self.cov.c_tracer.drain()
+        stats = self.cov.c_tracer.stats()
+        self.assertEqual(stats['peak_pending'], pending)
+        self.assertEqual(stats['inserts'], pending)
+
+    def test_count_mode_counts_executions_natively(self):
+        self.cov.c_tracer.count_hits = True
+        path = self.trace_source("""\
+        for i in range(3):
+            x = i
+        """)
+        self.cov.c_tracer.drain()
+        self.assertEqual(self.cov.trace_data['line_counts'][path][0][2], 3)
+        self.assertEqual(self.cov.trace_data['arc_counts'][path][0][(1, 2)], 3)
+        # hit sets are recorded as usual
+        self.assertIn(2, self.cov.trace_data['lines'][path][0])
+
+    def attach_arena(self, name, source):
+        path = self.cov.path_manager.canonicalize(self.create_file(name, textwrap.dedent(source)))
+        self.cov.arena = SharedArena.create(os.path.join(self.test_dir, "arena"), {path: 10})
+        self.cov.c_tracer.attach_arena(self.cov.arena.buffer)
+        self.addCleanup(self.cov.arena.close)
+        self.addCleanup(self.cov.c_tracer.detach_arena)
+
+    def test_shared_arena_records_context_zero(self):
+        source = """\
+        x = 1
+        y = 2
+        """
+        self.attach_arena("target.py", source)
+        path = self.trace_source(source)
+        self.cov.c_tracer.drain()
+
+        # nothing buffered privately, everything is in the arena
+        self.assertNotIn(path, self.cov.trace_data['lines'])
+        lines, arcs, _ = self.cov.arena.take_new()[path]
+        self.assertEqual(lines, {1, 2})
+        self.assertIn((1, 2), arcs)
+
+        # other contexts are not shared
+        self.cov.switch_context("test_a")
+        self.trace_source(source)
+        self.cov.c_tracer.drain()
+        self.assertEqual(self.cov.trace_data['lines'][path][1], {1, 2})
+        self.assertEqual(self.cov.arena.take_new(), {})
+
+    def test_shared_arena_detached(self):
+        source = "x = 1\n"
+        self.attach_arena("target.py", source)
+        self.cov.c_tracer.detach_arena()
+        path = self.trace_source(source)
+        self.cov.c_tracer.drain()
+        self.assertEqual(self.cov.trace_data['lines'][path][0], {1})
+        self.assertEqual(self.cov.arena.take_new(), {})
+
+    def test_exported_delta_includes_shared_arena_hits(self):
+        path = self.cov.path_manager.canonicalize(self.create_file("target.py", "x = 1\ny = 2\n"))
+        self.cov.config.shared_arena = True
+        self.cov.start()
+        try:
+            self.assertTrue(self.cov._arena_owner)
+            exec(compile("x = 1\ny = 2\n", path, "exec"), {})
+            # still tracing, as an xdist worker exporting before its engine stops
+            delta = self.cov.export_delta()
+        finally:
+            self.cov.stop(save=False)
+
+        controller = MiniCoverage(project_root=self.test_dir)
+        controller.merge_delta(delta)
+        self.assertEqual(controller.trace_data['lines'][path][0], {1, 2})
+
+    def test_native_hook_installed_and_removed(self):
+        tracer = self.cov.c_tracer
+        self.cov.sys_settrace_tracer.start()
+        try:
+            # the native hook reports its Tracer as the trace object
+            self.assertIs(sys.gettrace(), tracer)
+            self.assertEqual(threading.gettrace(), tracer._start_thread)
+        finally:
+            self.cov.sys_settrace_tracer.stop()
+        self.assertIsNone(sys.gettrace())
+        self.assertIsNone(threading.gettrace())
+
+    def test_native_hook_skips_lines_of_untraceable_frames(self):
+        code = compile("import sys\nframe = sys._getframe()\n", "/outside/project.py", "exec")
+        namespace = {}
+        self.cov.sys_settrace_tracer.start()
+        try:
+            exec(code, namespace)
+        finally:
+            self.cov.sys_settrace_tracer.stop()
+        self.assertFalse(namespace['frame'].f_trace_lines)
+
+    def test_context_pushed_into_tracer(self):
+        self.cov.switch_context("ctx")
+        cid = self.cov.context_cache["ctx"]
+        # the tracer must not call back into the engine per event
+        self.cov._get_current_context_id = None
+
+        path = self.trace_source("x = 1\n")
+        self.cov.c_tracer.drain()
+        self.assertEqual(self.cov.trace_data['lines'][path][cid], {1})
+        self.assertEqual(self.cov.trace_data['lines'][path][0], set())
+
+    def test_per_thread_contexts(self):
+        source = textwrap.dedent("""\
+        def work():
+            return 1
+        """)
+        path = self.cov.path_manager.canonicalize(self.create_file("target.py", source))
+        namespace = {}
+        exec(compile(source, path, "exec"), namespace)
+
+        def worker(idx):
+            self.cov.switch_thread_context(f"worker_{idx}")
+            namespace['work']()
+
+        self.cov.sys_settrace_tracer.start()
+        try:
+            threads = [threading.Thread(target=worker, args=(i,)) for i in range(3)]
+            for t in threads:
+                t.start()
+            for t in threads:
+                t.join()
+            namespace['work']()
+        finally:
+            self.cov.sys_settrace_tracer.stop()
+        self.cov.c_tracer.drain()
+
+        lines = self.cov.trace_data['lines'][path]
+        for i in range(3):
+            self.assertEqual(lines[self.cov.context_cache[f"worker_{i}"]], {2})
+        # the main thread kept the tracer-wide context
+        self.assertEqual(lines[0], {2})
+
+
+@unittest.skipIf(minicov_tracer is None or sys.version_info < (3, 12), "requires the C extension and sys.monitoring")
+class TestCMonitoringCallbacks(BaseTestCase):
+
+    def setUp(self):
+        super().setUp()
+        self.cov = MiniCoverage(project_root=self.test_dir)
+
+    def monitor_source(self, source, name="target.py"):
+        source = textwrap.dedent(source)
+        path = self.cov.path_manager.canonicalize(self.create_file(name, source))
+        code = compile(source, path, "exec")
+
+        self.assertTrue(self.cov.sys_monitoring_tracer.start())
+        try:
+            exec(code, {"__name__": "__main__"})
+        finally:
+            self.cov.sys_monitoring_tracer.stop()
+        self.cov.c_tracer.drain()
+        return path
+
+    def test_lines_arcs_and_branches_recorded(self):
+        path = self.monitor_source("""\
+        def decide(a, b):
+            if a and b:
+                return 1
+            return 0
+        for flag in (True, False):
+            decide(flag, True)
+        """)
+        self.assertTrue({2, 3, 4, 6}.issubset(self.cov.trace_data['lines'][path][0]))
+        self.assertIn((2, 3), self.cov.trace_data['arcs'][path][0])
+        self.assertIn((2, 4), self.cov.trace_data['arcs'][path][0])
+        self.assertGreater(len(self.cov.trace_data['instruction_arcs'][path][0]), 0)
+
+    def test_branch_disabled_after_both_destinations(self):
+        path = self.cov.path_manager.canonicalize(self.create_file("target.py", "x = 1\n"))
+        code = compile("x = 1\n", path, "exec")
+        tracer = self.cov.c_tracer
+
+        self.assertIsNone(tracer._monitor_branch(code, 10, 20))
+        self.assertIsNone(tracer._monitor_branch(code, 10, 20))
+        self.assertIs(tracer._monitor_branch(code, 10, 30), sys.monitoring.DISABLE)
+
+        # a new context must see both destinations again
+        self.cov.switch_context("other")
+        self.assertIsNone(tracer._monitor_branch(code, 10, 30))
+
+    def test_arcs_continue_across_awaits(self):
+        path = self.monitor_source(ASYNC_SOURCE)
+        arcs = self.cov.trace_data['arcs'][path][0]
+
+        self.assertTrue(ASYNC_ARCS.issubset(arcs))
+        self.assertNotIn((7, 3), arcs)
+        self.assertNotIn((8, 3), arcs)
+        self.assertGreater(self.cov.c_tracer.stats()['events']['py_return'], 0)
+
+    def test_greenlet_switch_keeps_histories_apart(self):
+        source = "def work():\n    a = 1\n    b = 2\n    c = 3\n"
+        path = self.cov.path_manager.canonicalize(self.create_file("target.py", source))
+        namespace = {}
+        exec(compile(source, path, "exec"), namespace)
+        code = namespace['work'].__code__
+        tracer = self.cov.c_tracer
+        first, second = types.SimpleNamespace(dead=False), types.SimpleNamespace(dead=False)
+
+        sys.monitoring.use_tool_id(sys.monitoring.COVERAGE_ID, "minicov-test")
+        try:
+            tracer._monitor_py_start(code, 0)
+            tracer._monitor_line(code, 2)
+            tracer._greenlet_switch("switch", (first, second))
+            tracer._monitor_py_start(code, 0)
+            tracer._monitor_line(code, 3)
+            tracer._greenlet_switch("switch", (second, first))
+            tracer._monitor_line(code, 3)
+            first.dead = True
+            tracer._greenlet_switch("switch", (first, second))
+            tracer._monitor_line(code, 4)
+        finally:
+            sys.monitoring.free_tool_id(sys.monitoring.COVERAGE_ID)
+        tracer.drain()
+
+        # each greenlet continues its own chain: no (3, 3) from the other one's line
+        self.assertEqual(self.cov.trace_data['arcs'][path][0], {(2, 3), (3, 4)})
+
+    def test_untraceable_code_disabled(self):
+        code = compile("x = 1\n", "/outside/project.py", "exec")
+        self.assertIs(self.cov.c_tracer._monitor_py_start(code, 0), sys.monitoring.DISABLE)
+
+    def test_sampled_out_code_disabled_at_py_start(self):
+        path = self.cov.path_manager.canonicalize(self.create_file("target.py", "x = 1\n"))
+        self.cov.c_tracer.sample_rate = 0.0
+        code = compile("x = 1\n", path, "exec")
+        self.assertIs(self.cov.c_tracer._monitor_py_start(code, 0), sys.monitoring.DISABLE)
+        self.assertIs(self.cov.c_tracer._monitor_line(code, 1), sys.monitoring.DISABLE)
+        self.cov.c_tracer.drain()
+        self.assertNotIn(path, self.cov.trace_data['lines'])
+
+    def test_shared_arena_records_branches_and_first_hits(self):
+        path = self.cov.path_manager.canonicalize(self.create_file("target.py", "x = 1\n"))
+        code = compile("x = 1\n", path, "exec")
+        self.cov.arena = SharedArena.create(os.path.join(self.test_dir, "arena"), {path: 1})
+        tracer = self.cov.c_tracer
+        tracer.attach_arena(self.cov.arena.buffer)
+        try:
+            tracer._monitor_branch(code, 10, 20)
+            tracer.first_hit = True
+            tracer._monitor_line(code, 1)
+        finally:
+            tracer.detach_arena()
+        tracer.drain()
+
+        self.assertNotIn(path, self.cov.trace_data['lines'])
+        self.assertEqual(self.cov.arena.take_new(), {path: ({1}, set(), {(10, 20)})})
+        self.cov.arena.close()
+
+    def test_first_hit_mode_disables_after_recording(self):
+        path = self.cov.path_manager.canonicalize(self.create_file("target.py", "x = 1\n"))
+        code = compile("x = 1\n", path, "exec")
+        tracer = self.cov.c_tracer
+        tracer.first_hit = True
+
+        self.assertIs(tracer._monitor_line(code, 1), sys.monitoring.DISABLE)
+        self.assertIs(tracer._monitor_jump(code, 0, 2), sys.monitoring.DISABLE)
+        tracer.drain()
+        self.assertEqual(self.cov.trace_data['lines'][path][0], {1})
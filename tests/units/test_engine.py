@@ -3,10 +3,16 @@ import sys  # noqa: F401
 import os
 import threading
 import sqlite3
+import json
+import gc
+import pickle
+import types
 import uuid  # noqa: F401
 from contextlib import closing
+from unittest.mock import patch
 from src.engine import MiniCoverage
 from src.engine import queries  # noqa: F401
+from src.engine.core import minicov_tracer
 from tests.test_utils import BaseTestCase, MockFrame
 
 
@@ -71,6 +77,24 @@ class TestEngineCore(BaseTestCase):
         cid3 = self.cov._get_current_context_id()
         self.assertEqual(cid1, cid3)
 
+    def test_thread_context_overrides_global(self):
+        self.cov.switch_context("global")
+        seen = {}
+
+        def worker():
+            self.cov.switch_thread_context("worker")
+            seen['worker'] = self.cov._get_current_context_id()
+            self.cov.switch_thread_context(None)
+            seen['reset'] = self.cov._get_current_context_id()
+
+        t = threading.Thread(target=worker)
+        t.start()
+        t.join()
+
+        self.assertEqual(seen['worker'], self.cov.context_cache["worker"])
+        self.assertEqual(seen['reset'], self.cov.context_cache["global"])
+        self.assertEqual(self.cov._get_current_context_id(), self.cov.context_cache["global"])
+
     def test_trace_with_context_persistence(self):
         filename = os.path.join(self.test_dir, "test.py")
 
@@ -181,3 +205,317 @@ class TestEngineCore(BaseTestCase):
 
         self.cov.report(reporters=['json'])
         self.assertTrue(os.path.exists(os.path.join(self.test_dir, "coverage.json")))
+
+    def test_reset_after_fork_drops_parent_hits(self):
+        filename = os.path.join(self.test_dir, "test.py")
+        self.cov.trace_data.add_line(filename, 0, 1)
+        self.cov._cache_traceable[filename] = True
+        parent_partial = self.cov.storage.uuid
+
+        self.cov._reset_after_fork()
+
+        # the child starts empty, writes elsewhere, and keeps the parent's decisions
+        self.assertEqual(self.cov.pending_hits(), 0)
+        self.assertNotEqual(self.cov.storage.uuid, parent_partial)
+        self.assertTrue(self.cov._cache_traceable[filename])
+
+    def test_snapshot_only_sent_to_spawned_children(self):
+        from src.engine import core
+        cases = [(None, ['fork', 'spawn', 'forkserver'], False), ('fork', ['spawn'], False),
+                 (None, ['spawn', 'fork'], True), ('forkserver', ['fork'], True)]
+        with patch.object(core, '_active_engine', self.cov), \
+                patch('multiprocessing.process.BaseProcess.start'):
+            for method, available, expected in cases:
+                with self.subTest(method=method, available=available), \
+                        patch('multiprocessing.get_start_method', return_value=method), \
+                        patch('multiprocessing.get_all_start_methods', return_value=available):
+                    process = core.CoverageProcess(target=print)
+                    process.start()
+                    self.assertEqual(process._cov_snapshot is not None, expected)
+
+    def test_from_snapshot_skips_config_loading(self):
+        self.cov.config.omit.add("skipped.py")
+        self.cov.path_manager.canonicalize("a.py")
+        snapshot = pickle.loads(pickle.dumps(self.cov.snapshot()))
+
+        with patch('src.engine.core.ConfigLoader.load_config') as load_config:
+            child = MiniCoverage.from_snapshot(snapshot)
+        load_config.assert_not_called()
+        self.assertIn("skipped.py", child.config.omit)
+        self.assertEqual(child.path_manager.canonical_paths(), self.cov.path_manager.canonical_paths())
+
+    def test_delta_merged_by_context_label(self):
+        filename = os.path.join(self.test_dir, "test.py")
+        worker = MiniCoverage(project_root=self.test_dir)
+        worker.switch_context("test_b")
+        worker.trace_data.add_line(filename, worker.context_cache["test_b"], 3)
+        worker.trace_data.add_arc(filename, 0, 1, 2)
+
+        self.cov.switch_context("test_a")
+        delta = worker.export_delta()
+        self.assertEqual(worker.pending_hits(), 0)
+        self.cov.merge_delta(delta)
+
+        # the worker's context IDs are renumbered to the receiver's
+        cid = self.cov.context_cache["test_b"]
+        self.assertNotEqual(cid, self.cov.context_cache["test_a"])
+        self.assertEqual(self.cov.trace_data['lines'][filename][cid], {3})
+        self.assertEqual(self.cov.trace_data['arcs'][filename][0], {(1, 2)})
+
+    @unittest.skipIf(minicov_tracer is None and sys.version_info < (3, 12),
+                     "sampling requires sys.monitoring or the C extension")
+    def test_sampled_run_tagged_in_data_and_reports(self):
+        script = self.create_file("script.py", "x = 1\ny = 2\n")
+        self.cov.config.collection_mode = 'sampled'
+        self.cov.config.sample_rate = 0.0
+        self.cov.run(script)
+
+        # nothing was sampled, but the data file knows it came from a sampled run
+        self.assertNotIn(self.cov.path_manager.canonicalize(script), self.cov.trace_data['lines'])
+        self.cov.trace_data.add_line(self.cov.path_manager.canonicalize(script), 0, 1)
+        self.cov.report(reporters=['json'])
+        self.assertEqual(self.cov.storage.data_sample_rate(), 0.0)
+        with open("coverage.json") as f:
+            self.assertEqual(json.load(f)["meta"]["sample_rate"], 0.0)
+
+    @unittest.skipIf(sys.version_info < (3, 12), "requires sys.monitoring")
+    def test_sampling_decisions_do_not_keep_code_alive(self):
+        path = self.cov.path_manager.canonicalize(self.create_file("target.py", "x = 1\n"))
+        self.cov.c_tracer = None
+        self.cov.config.collection_mode = 'sampled'
+        self.cov.config.sample_rate = 0.5
+        tracer = self.cov.sys_monitoring_tracer
+        self.assertTrue(tracer.start())
+        try:
+            kept = compile("x = 1\n", path, "exec")
+            dropped = compile("y = 2\n", path, "exec")
+            tracer._monitor_py_start(kept, 0)
+            tracer._monitor_py_start(dropped, 0)
+            self.assertEqual(len(tracer._sampled), 2)
+
+            del dropped
+            gc.collect()
+            self.assertEqual(list(tracer._sampled), [kept])
+        finally:
+            tracer.stop()
+        self.assertEqual(len(tracer._sampled), 0)
+
+    @unittest.skipIf(sys.version_info < (3, 12), "requires sys.monitoring")
+    def test_first_hit_caches_do_not_keep_code_alive(self):
+        path = self.cov.path_manager.canonicalize(self.create_file("target.py", "x = 1\n"))
+        self.cov.c_tracer = None
+        self.cov.config.collection_mode = 'first-hit'
+        tracer = self.cov.sys_monitoring_tracer
+        self.assertTrue(tracer.start())
+        try:
+            kept = compile("if x:\n    y = 1\n", path, "exec")
+            dropped = compile("if z:\n    y = 1\n", path, "exec")
+            for code in (kept, dropped):
+                tracer._monitor_branch(code, 0, 2)
+            del code
+            self.assertEqual(len(tracer._branch_seen), 2)
+            self.assertEqual(len(tracer._line_tables), 2)
+
+            del dropped
+            gc.collect()
+            self.assertEqual(list(tracer._branch_seen), [kept])
+            self.assertEqual(list(tracer._line_tables), [kept])
+
+            # re-armed branches wait for both destinations again
+            tracer.restart_events()
+            self.assertEqual(len(tracer._branch_seen), 0)
+        finally:
+            tracer.stop()
+        self.assertEqual(len(tracer._line_tables), 0)
+
+    def test_full_run_not_tagged(self):
+        self.cov.trace_data.add_line(os.path.join(self.test_dir, "test.py"), 0, 1)
+        self.cov.combine_data()
+        self.assertIsNone(self.cov.storage.data_sample_rate())
+
+    def test_count_mode_sums_counts_once(self):
+        script = self.create_file("script.py", "for i in range(4):\n    x = i\n")
+        self.cov.config.collection_mode = 'count'
+        self.cov.run(script)
+        second = MiniCoverage(project_root=self.test_dir)
+        second.config.collection_mode = 'count'
+        second.run(script)
+
+        path = self.cov.path_manager.canonicalize(script)
+        # reporting twice must not save the combined counts again
+        for _ in range(2):
+            self.cov.report(reporters=['json'])
+            with open("coverage.json") as f:
+                counts = json.load(f)["files"]["script.py"]["HitCounts"]
+            self.assertEqual(counts["lines"]["2"], 8)
+            self.assertIn([1, 2, 8], counts["arcs"])
+        self.assertEqual(self.cov.combined_counts['line_counts'][path][0][2], 8)
+
+    def test_python_tracer_counts_lines_and_arcs(self):
+        filename = os.path.join(self.test_dir, "test.py")
+        self.cov.count_hits = True
+        for lineno in (1, 2, 1, 2):
+            self.cov.sys_settrace_tracer.trace_function(MockFrame(filename, lineno), "line", None)
+        self.assertEqual(self.cov.trace_data['line_counts'][filename][0], {1: 2, 2: 2})
+        self.assertEqual(self.cov.trace_data['arc_counts'][filename][0], {(1, 2): 2, (2, 1): 1})
+
+    def test_counts_merged_from_delta(self):
+        filename = os.path.join(self.test_dir, "test.py")
+        worker = MiniCoverage(project_root=self.test_dir)
+        worker.trace_data.add_line(filename, 0, 3)
+        worker.trace_data['line_counts'][filename][0][3] = 4
+        self.cov.trace_data['line_counts'][filename][0][3] = 1
+        self.cov.merge_delta(worker.export_delta())
+        self.assertEqual(self.cov.trace_data['line_counts'][filename][0][3], 5)
+
+    def test_stats_report_phase_timings(self):
+        script = self.create_file("script.py", "def f():\n    return 1\nf()\n")
+        self.cov.run(script)
+        self.cov.report(reporters=['json'])
+
+        stats = self.cov.stats()
+        for phase in ('save', 'combine', 'load', 'analyze', 'report.JsonReporter'):
+            self.assertIn(phase, stats['timings'])
+        self.assertGreaterEqual(stats['tracer']['should_trace_calls'], 1)
+        self.assertGreaterEqual(stats['pending_hits'], 0)
+
+    def test_stats_of_the_python_tracer_in_use(self):
+        script = self.create_file("script.py", "def f():\n    return 1\nf()\n")
+        self.cov.c_tracer = None
+        self.cov.sys_settrace_tracer.c_tracer = None
+        self.cov.run(script)
+
+        tracer = self.cov.stats()['tracer']
+        self.assertGreaterEqual(tracer['should_trace_calls'], 1)
+        self.assertTrue(tracer['events'])
+
+    def test_python_settrace_callbacks_counted(self):
+        self._run_python_tracer(self.cov.sys_settrace_tracer, "def f():\n    return 1\nf()\n")
+        stats = self.cov.sys_settrace_tracer.stats()
+        self.assertGreater(stats['events']['line'], 0)
+        self.assertGreater(stats['events']['call'], 0)
+        self.assertGreaterEqual(stats['should_trace_calls'], 1)
+        self.assertGreater(stats['filtered'], 0)
+
+    @unittest.skipIf(sys.version_info < (3, 12), "requires sys.monitoring")
+    def test_python_monitoring_callbacks_counted(self):
+        path = self.cov.path_manager.canonicalize(self.create_file("target.py", "x = 1\n"))
+        tracer = self.cov.sys_monitoring_tracer
+        sys.monitoring.use_tool_id(sys.monitoring.COVERAGE_ID, "minicov-test")
+        try:
+            tracer._monitor_py_start(compile("x = 1\n", path, "exec"), 0)
+            tracer._monitor_py_start(compile("x = 1\n", "/outside/project.py", "exec"), 0)
+        finally:
+            sys.monitoring.free_tool_id(sys.monitoring.COVERAGE_ID)
+
+        stats = tracer.stats()
+        self.assertEqual(stats['events'], {'py_start': 2})
+        self.assertEqual(stats['filtered'], 1)
+        self.assertEqual(stats['should_trace_calls'], 2)
+
+    def _run_python_tracer(self, tracer, source):
+        path = self.cov.path_manager.canonicalize(self.create_file("target.py", source))
+        self.cov.c_tracer = None
+        self.cov.sys_settrace_tracer.c_tracer = None
+        if tracer is self.cov.sys_monitoring_tracer:
+            self.assertTrue(tracer.start())
+        else:
+            tracer.start()
+        try:
+            exec(compile(source, path, "exec"), {"__name__": "__main__"})
+        finally:
+            tracer.stop()
+        return self.cov.trace_data['arcs'][path][0]
+
+    def test_python_tracers_continue_arcs_across_calls_and_awaits(self):
+        source = (
+            "import asyncio\n"
+            "async def handle(n):\n"
+            "    if await asyncio.sleep(0, n % 2):\n"
+            "        kind = 'odd'\n"
+            "    else:\n"
+            "        kind = 'even'\n"
+            "    return kind\n"
+            "async def main():\n"
+            "    await asyncio.gather(*(handle(i) for i in range(4)))\n"
+            "asyncio.run(main())\n"
+            "done = True\n"
+        )
+        tracers = [self.cov.sys_settrace_tracer]
+        if sys.version_info >= (3, 12):
+            tracers.append(self.cov.sys_monitoring_tracer)
+        for tracer in tracers:
+            with self.subTest(tracer=type(tracer).__name__):
+                self.cov.trace_data.take()
+                arcs = self._run_python_tracer(tracer, source)
+                self.assertTrue({(3, 4), (3, 6), (4, 7), (6, 7), (10, 11)}.issubset(arcs))
+                # no arc from the callee's last line into its caller
+                self.assertNotIn((7, 11), arcs)
+                self.assertNotIn((7, 3), arcs)
+
+    def test_python_greenlet_switch_keeps_histories_apart(self):
+        filename = os.path.join(self.test_dir, "target.py")
+        first, second = types.SimpleNamespace(dead=False), types.SimpleNamespace(dead=False)
+
+        self.cov._enter_frame()
+        self.cov._record_line(filename, 2, 0)
+        self.cov._switch_greenlet("switch", (first, second))
+        self.cov._enter_frame()
+        self.cov._record_line(filename, 3, 0)
+        self.cov._switch_greenlet("switch", (second, first))
+        self.cov._record_line(filename, 3, 0)
+        first.dead = True
+        self.cov._switch_greenlet("switch", (first, second))
+        self.cov._record_line(filename, 4, 0)
+
+        self.assertEqual(self.cov.trace_data['arcs'][filename][0], {(2, 3), (3, 4)})
+        # the finished greenlet's history is dropped
+        self.assertEqual(self.cov._greenlet_histories, {})
+
+    def test_concurrency_parsed(self):
+        self.cov.config.concurrency = "thread, gevent"
+        self.assertEqual(self.cov.concurrency(), {'thread', 'gevent'})
+
+        self.cov.config.concurrency = "thread,twisted"
+        with self.assertLogs(self.cov.logger, level='WARNING'):
+            self.assertEqual(self.cov.concurrency(), {'thread'})
+
+    def test_shared_arena_needs_c_tracer(self):
+        self.cov.config.shared_arena = True
+        self.cov.c_tracer = None
+        with self.assertLogs(self.cov.logger, level='WARNING'):
+            self.cov._start_arena()
+        self.assertIsNone(self.cov.arena)
+
+    def test_shared_arena_skipped_in_count_mode(self):
+        self.cov.config.shared_arena = True
+        self.cov.count_hits = True
+        with self.assertLogs(self.cov.logger, level='WARNING'):
+            self.cov._start_arena()
+        self.assertIsNone(self.cov.arena)
+
+    def test_greenlet_tracking_chains_previous_callback(self):
+        calls = []
+        fake = types.SimpleNamespace(trace=None)
+        fake.gettrace = lambda: fake.trace
+        fake.settrace = lambda callback: setattr(fake, 'trace', callback)
+        previous = fake.trace = lambda event, args: calls.append(event)
+
+        self.cov.config.concurrency = "gevent"
+        with patch.dict(sys.modules, {'greenlet': fake}):
+            self.cov._start_greenlet_tracking()
+            self.assertIsNot(fake.trace, previous)
+
+            origin, target = types.SimpleNamespace(dead=False), types.SimpleNamespace(dead=False)
+            fake.trace("switch", (origin, target))
+            self.assertEqual(calls, ["switch"])
+
+            self.cov._stop_greenlet_tracking()
+            self.assertIs(fake.trace, previous)
+
+    def test_greenlet_tracking_off_by_default(self):
+        fake = types.SimpleNamespace(trace=None, gettrace=lambda: None, settrace=lambda callback: None)
+        with patch.dict(sys.modules, {'greenlet': fake}), \
+                patch.object(fake, 'settrace') as settrace:
+            self.cov._start_greenlet_tracking()
+        settrace.assert_not_called()
@@ -0,0 +1,128 @@
+import os
+import threading
+import time
+import unittest
+import textwrap
+from src.engine import MiniCoverage
+from src.engine.flusher import BackgroundFlusher
+from src.engine.trace_data import TraceContainer
+from tests.test_utils import BaseTestCase
+
+
+class _FakeEngine:
+    def __init__(self, pending=0):
+        self.pending = pending
+        self.flushed = threading.Event()
+        self.flushes = 0
+
+    def pending_hits(self):
+        return self.pending
+
+    def flush_data(self):
+        self.flushes += 1
+        self.pending = 0
+        self.flushed.set()
+
+
+class TestBackgroundFlush(BaseTestCase):
+
+    def setUp(self):
+        super().setUp()
+        self.cov = MiniCoverage(project_root=self.test_dir)
+        self.path = self.cov.path_manager.canonicalize(self.create_file("target.py", "x = 1\n"))
+
+    def partials(self):
+        return [f for f in os.listdir(self.test_dir) if f.startswith(".coverage.db.")]
+
+    def test_take_empties_container_in_place(self):
+        data = TraceContainer()
+        lines = data['lines']
+        data.add_line(self.path, 0, 3)
+        data.add_arc(self.path, 0, 3, 4)
+
+        taken = data.take()
+        self.assertEqual(taken['lines'][self.path][0], {3})
+        self.assertEqual(taken['arcs'][self.path][0], {(3, 4)})
+        self.assertEqual(data.hit_count(), 0)
+        # the C tracer keeps references to the top-level mappings
+        self.assertIs(data['lines'], lines)
+
+    def test_flush_appends_deltas_and_frees_memory(self):
+        self.cov.trace_data.add_line(self.path, 0, 1)
+        self.cov.flush_data()
+        self.assertEqual(self.cov.pending_hits(), 0)
+        self.assertEqual(len(self.partials()), 1)
+
+        self.cov.trace_data.add_line(self.path, 0, 2)
+        self.cov.flush_data()
+        self.assertEqual(len(self.partials()), 1)
+
+        self.cov.trace_data = TraceContainer()
+        self.cov.storage.combine(None)
+        self.cov.storage.load_into(self.cov.trace_data, self.cov.path_manager)
+        self.assertEqual(self.cov.trace_data['lines'][self.path][0], {1, 2})
+
+    def test_bitmap_flushes_are_merged(self):
+        self.cov.storage.storage_format = 'bitmap'
+        for line in (1, 2):
+            self.cov.trace_data.add_line(self.path, 0, line)
+            self.cov.trace_data.add_arc(self.path, 0, line, line + 1)
+            self.cov.flush_data()
+
+        loaded = TraceContainer()
+        self.cov.storage.combine(None)
+        self.cov.storage.load_into(loaded, self.cov.path_manager)
+        self.assertEqual(loaded['lines'][self.path][0], {1, 2})
+        self.assertEqual(loaded['arcs'][self.path][0], {(1, 2), (2, 3)})
+
+    def test_flusher_triggers_on_size(self):
+        engine = _FakeEngine(pending=10)
+        flusher = BackgroundFlusher(engine, interval=0, max_hits=5, poll=0.01)
+        flusher.start()
+        try:
+            self.assertTrue(engine.flushed.wait(5))
+        finally:
+            flusher.stop()
+
+        # below the threshold nothing is flushed
+        engine = _FakeEngine(pending=1)
+        flusher = BackgroundFlusher(engine, interval=0, max_hits=5, poll=0.01)
+        flusher.start()
+        time.sleep(0.05)
+        flusher.stop()
+        self.assertEqual(engine.flushes, 0)
+
+    def test_flusher_triggers_on_interval(self):
+        engine = _FakeEngine()
+        flusher = BackgroundFlusher(engine, interval=0.01, max_hits=0)
+        flusher.start()
+        try:
+            self.assertTrue(engine.flushed.wait(5))
+        finally:
+            flusher.stop()
+
+    def test_data_flushed_while_tracing(self):
+        source = textwrap.dedent("""\
+        import time
+        deadline = time.monotonic() + 5
+        while not flushed() and time.monotonic() < deadline:
+            time.sleep(0.01)
+        after = 1
+        """)
+        path = self.cov.path_manager.canonicalize(self.create_file("service.py", source))
+        self.cov.flusher = BackgroundFlusher(self.cov, 0.02, 0, poll=0.01)
+
+        self.cov.start()
+        try:
+            exec(compile(source, path, "exec"), {"flushed": lambda: bool(self.partials())})
+        finally:
+            self.cov.stop()
+
+        self.cov.trace_data = TraceContainer()
+        self.cov.storage.combine(None)
+        self.cov.storage.load_into(self.cov.trace_data, self.cov.path_manager)
+        self.assertTrue({1, 2, 3, 5}.issubset(self.cov.trace_data['lines'][path][0]))
+
+
+if __name__ == '__main__':
+    unittest.main()
@@ -19,7 +19,7 @@ class TestMissingCoverage(unittest.TestCase):
 
         # Mock sys.monitoring.use_tool_id to raise ValueError (simulating failure)
         with patch('sys.monitoring.use_tool_id', side_effect=ValueError("Mock Failure")):
-            with patch('sys.settrace') as mock_settrace:
+            with patch.object(self.cov.sys_settrace_tracer, 'start') as mock_settrace:
                 self.cov.start()
                 # Should have tried to settrace as fallback
                 mock_settrace.assert_called()
@@ -0,0 +1,62 @@
+import unittest
+import fnmatch
+import os
+from unittest.mock import patch
+from src.engine.config import CoverageConfig
+from src.engine.path_manager import PathManager, compile_patterns
+from tests.test_utils import BaseTestCase
+
+
+class TestPathManager(BaseTestCase):
+
+    def setUp(self):
+        super().setUp()
+        self.config = CoverageConfig()
+        self.pm = PathManager(self.test_dir, self.config)
+        self.root = self.pm.project_root
+
+    def test_canonicalize_hits_filesystem_once_per_path(self):
+        path = self.create_file("mod.py", "x = 1\n")
+        with patch('os.path.realpath', wraps=os.path.realpath) as realpath:
+            first = self.pm.canonicalize(path)
+            for _ in range(5):
+                self.assertEqual(self.pm.canonicalize(path), first)
+                self.pm.should_trace(path, set())
+                self.pm.map_path(path)
+        self.assertEqual(realpath.call_count, 1)
+
+    def test_omit_patterns_matched_by_one_regex(self):
+        self.config.omit.update({"vendor/*", "*_pb2.py", "tests/*/fixtures/*"})
+        with patch('fnmatch.fnmatch', side_effect=AssertionError("matched pattern by pattern")):
+            self.assertFalse(self.pm.should_trace(os.path.join(self.root, "vendor", "lib.py"), set()))
+            self.assertFalse(self.pm.should_trace(os.path.join(self.root, "api_pb2.py"), set()))
+            self.assertFalse(self.pm.should_trace(os.path.join(self.root, "tests", "a", "fixtures", "f.py"), set()))
+            self.assertTrue(self.pm.should_trace(os.path.join(self.root, "src", "vendor.py"), set()))
+
+    def test_combined_regex_matches_fnmatch(self):
+        patterns = frozenset({"*.tmp", "build/*", "a?c.py", "[xy]*/gen.py", "lit[.]py"})
+        regex = compile_patterns(patterns)
+        names = ["x.tmp", "build/sub/m.py", "abc.py", "abbc.py", "y/q/gen.py", "z/gen.py", "lit.py", "src/m.py"]
+        for name in names:
+            expected = any(fnmatch.fnmatch(name, p) for p in patterns)
+            self.assertEqual(regex.match(name) is not None, expected, name)
+        self.assertIsNone(compile_patterns(frozenset()))
+
+    def test_omit_changes_after_creation_are_applied(self):
+        path = os.path.join(self.root, "gen", "m.py")
+        self.assertTrue(self.pm.should_trace(path, set()))
+        self.config.omit.add("gen/*")
+        self.assertFalse(self.pm.should_trace(path, set()))
+
+    def test_sibling_directory_with_common_prefix_not_traced(self):
+        self.assertFalse(self.pm.should_trace(self.root + "-other" + os.sep + "m.py", set()))
+        self.assertTrue(self.pm.should_trace(os.path.join(self.root, "m.py"), set()))
+
+    def test_code_without_source_file_not_traced(self):
+        # the test directory is both the working directory and the project root
+        self.assertFalse(self.pm.should_trace("<frozen importlib._bootstrap>", set()))
+        self.assertFalse(self.pm.should_trace("<string>", set()))
+
+
+if __name__ == '__main__':
+    unittest.main()
@@ -0,0 +1,118 @@
+import unittest
+import json
+import os
+import xml.etree.ElementTree as ET
+from unittest.mock import patch
+from src.engine import MiniCoverage
+from src.engine import analyzer
+from src.engine.report_manager import ReportManager
+from src.reporters import BaseReporter
+from tests.test_utils import BaseTestCase
+
+SOURCES = {
+    "alpha.py": "def f(a):\n    if a:\n        return 1\n    return 0\n",
+    "beta.py": "x = 1\ny = 2\n",
+    "gamma.py": "for i in range(2):\n    pass\n",
+}
+
+
+class RecordingReporter(BaseReporter):
+    """
+    Only implements generate(), like reporters written before streaming existed.
+    """
+
+    def __init__(self, events):
+        self.events = events
+
+    def generate(self, results, project_root):
+        self.events.append(("generate", sorted(os.path.basename(f) for f in results)))
+
+
+class TestStreamingReports(BaseTestCase):
+
+    def setUp(self):
+        super().setUp()
+        self.cov = MiniCoverage(project_root=self.test_dir)
+        self.cov.analyzer.cache = None
+        for name, source in SOURCES.items():
+            path = self.cov.path_manager.canonicalize(self.create_file(name, source))
+            self.cov.trace_data['lines'][path][0].update({1, 2})
+            self.cov.trace_data['arcs'][path][0].add((1, 2))
+        self.cov.save_data()
+
+    def report(self, stream, out_dir):
+        os.makedirs(out_dir)
+        self.cov.config.stream_reports = stream
+        manager = ReportManager(['console', 'html', 'xml', 'json'], self.cov.parser.read_source)
+        for reporter in manager.reporters:
+            if hasattr(reporter, 'output_dir'):
+                reporter.output_dir = os.path.join(out_dir, "htmlcov")
+            elif hasattr(reporter, 'output_file'):
+                reporter.output_file = os.path.join(out_dir, reporter.output_file)
+        self.cov.report_manager = manager
+        with self.capture_stdout() as out:
+            self.cov.report()
+        # reporters announce themselves at start(), i.e. before the console rows when streaming
+        return [line for line in out.getvalue().splitlines() if not line.startswith("Generating")]
+
+    def read_outputs(self, out_dir):
+        outputs = {}
+        for name in os.listdir(os.path.join(out_dir, "htmlcov")):
+            with open(os.path.join(out_dir, "htmlcov", name)) as f:
+                outputs[name] = f.read()
+        root = ET.parse(os.path.join(out_dir, "coverage.xml")).getroot()
+        del root.attrib["timestamp"]
+        outputs["coverage.xml"] = ET.tostring(root)
+        with open(os.path.join(out_dir, "coverage.json")) as f:
+            data = json.load(f)
+        del data["meta"]["timestamp"]
+        outputs["coverage.json"] = data
+        return outputs
+
+    def test_streamed_reports_match_batch_reports(self):
+        batch_console = self.report(False, "batch")
+        streamed_console = self.report(True, "streamed")
+        self.assertEqual(streamed_console, batch_console)
+        self.assertEqual(self.read_outputs("streamed"), self.read_outputs("batch"))
+        self.assertEqual(len(self.read_outputs("streamed")["coverage.json"]["files"]), len(SOURCES))
+
+    def test_files_reported_before_next_file_is_analyzed(self):
+        events = []
+
+        class StreamRecorder(BaseReporter):
+            def start(self, project_root):
+                events.append("start")
+
+            def add_file(self, filename, file_results):
+                events.append(("report", os.path.basename(filename)))
+
+            def finish(self):
+                events.append("finish")
+
+        def analyze(parser, metrics, filename, source, exclude_patterns):
+            events.append(("analyze", os.path.basename(filename)))
+            return static_analysis(parser, metrics, filename, source, exclude_patterns)
+
+        static_analysis = analyzer.static_analysis
+        manager = ReportManager([])
+        manager.reporters = [StreamRecorder(), RecordingReporter(events)]
+        with patch('src.engine.analyzer.static_analysis', side_effect=analyze):
+            manager.generate_streaming(self.cov.analyzer.iter_analyze(self.cov.trace_data), self.test_dir)
+
+        names = sorted(SOURCES)
+        expected = ["start"]
+        for name in names:
+            expected += [("analyze", name), ("report", name)]
+        expected += ["finish", ("generate", names)]
+        # the generate()-only reporter got every file at once when the stream ended
+        self.assertEqual(events, expected)
+
+    def test_stream_reports_config(self):
+        with open(".coveragerc", "w") as f:
+            f.write("[run]\nstream_reports = true\n")
+        cov = MiniCoverage(project_root=self.test_dir, config_file=".coveragerc")
+        self.assertTrue(cov.config.stream_reports)
+
+
+if __name__ == '__main__':
+    unittest.main()
@@ -3,6 +3,7 @@ import ast
 import os
 import textwrap
 import types
+from unittest.mock import patch
 from src.engine.source_parser import SourceParser
 from tests.test_utils import BaseTestCase
 
@@ -80,3 +81,12 @@ class TestSourceParser(BaseTestCase):
         tree, _ = self.parser.parse_source(path)
         # should return None due to UnicodeDecodeError
         self.assertIsNone(tree)
+
+    def test_read_source_served_from_memory_until_changed(self):
+        path = self.create_file("cached.py", "x = 1\n")
+        self.assertEqual(self.parser.read_source(path), b"x = 1\n")
+        with patch('builtins.open', side_effect=AssertionError("read again")):
+            self.assertEqual(self.parser.read_source(path), b"x = 1\n")
+
+        self.create_file("cached.py", "x = 22\n")
+        self.assertEqual(self.parser.read_source(path), b"x = 22\n")
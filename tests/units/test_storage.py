@@ -0,0 +1,310 @@
+import os
+import json
+import sqlite3
+import unittest
+from unittest.mock import patch
+from contextlib import closing
+from src.engine import MiniCoverage
+from src.engine import queries
+from src.engine.file_table import FileTable
+from src.engine.storage import CoverageStorage
+from src.engine.trace_data import TraceContainer
+from tests.test_utils import BaseTestCase
+
+
+class TestCoverageStorage(BaseTestCase):
+
+    def setUp(self):
+        super().setUp()
+        self.cov = MiniCoverage(project_root=self.test_dir)
+        self.file_a = self.cov.path_manager.canonicalize(self.create_file("a.py", "x = 1\n"))
+        self.file_b = self.cov.path_manager.canonicalize(self.create_file("b.py", "y = 1\n"))
+
+    def partials(self):
+        return [f for f in os.listdir(self.test_dir) if f.startswith(".coverage.db.")]
+
+    def test_rows_reference_interned_file_ids(self):
+        data = TraceContainer()
+        data['lines'][self.file_a][0].update({1, 2, 3})
+        data['arcs'][self.file_a][0].add((1, 2))
+        data['lines'][self.file_b][0].add(1)
+
+        table = FileTable()
+        CoverageStorage(".coverage.db").save(data, {"default": 0}, table)
+
+        with closing(sqlite3.connect(self.partials()[0])) as conn:
+            files = dict(conn.execute("SELECT path, id FROM files").fetchall())
+            self.assertEqual(files, {self.file_a: table.id_for(self.file_a), self.file_b: table.id_for(self.file_b)})
+
+            rows = conn.execute("SELECT file_id, line_no FROM lines").fetchall()
+            self.assertIn((files[self.file_a], 3), rows)
+            self.assertEqual(conn.execute("PRAGMA user_version").fetchone()[0], 4)
+
+    def test_combine_remaps_each_file_once(self):
+        for _ in range(2):
+            data = TraceContainer()
+            for line in range(1, 50):
+                data['lines'][self.file_a][0].add(line)
+            CoverageStorage(".coverage.db").save(data, {"default": 0})
+
+        calls = []
+        storage = CoverageStorage(".coverage.db")
+        storage.combine(lambda path: calls.append(path) or path)
+        self.assertEqual(calls, [self.file_a, self.file_a])
+        self.assertEqual(self.partials(), [])
+
+        loaded = TraceContainer()
+        storage.load_into(loaded, self.cov.path_manager)
+        self.assertEqual(loaded['lines'][self.file_a][0], set(range(1, 50)))
+
+    def create_legacy_db(self, path):
+        with closing(sqlite3.connect(path)) as conn:
+            conn.execute("CREATE TABLE contexts (id INTEGER PRIMARY KEY, label TEXT UNIQUE)")
+            conn.execute("INSERT INTO contexts VALUES (0, 'default')")
+            conn.execute("CREATE TABLE lines (file_path TEXT, context_id INTEGER, line_no INTEGER, "
+                         "PRIMARY KEY (file_path, context_id, line_no))")
+            conn.execute("CREATE TABLE arcs (file_path TEXT, context_id INTEGER, start_line INTEGER, "
+                         "end_line INTEGER, PRIMARY KEY (file_path, context_id, start_line, end_line))")
+            conn.execute("CREATE TABLE instruction_arcs (file_path TEXT, context_id INTEGER, from_offset INTEGER, "
+                         "to_offset INTEGER, PRIMARY KEY (file_path, context_id, from_offset, to_offset))")
+            conn.execute("INSERT INTO lines VALUES (?, 0, 7)", (self.file_b,))
+            conn.execute("INSERT INTO arcs VALUES (?, 0, 7, 8)", (self.file_b,))
+            conn.commit()
+
+    def test_legacy_partial_is_combined(self):
+        self.create_legacy_db(".coverage.db.1.abc")
+        data = TraceContainer()
+        data['lines'][self.file_a][0].add(1)
+        CoverageStorage(".coverage.db").save(data, {"default": 0})
+
+        storage = CoverageStorage(".coverage.db")
+        storage.combine(lambda path: path)
+        loaded = TraceContainer()
+        storage.load_into(loaded, self.cov.path_manager)
+
+        self.assertEqual(loaded['lines'][self.file_a][0], {1})
+        self.assertEqual(loaded['lines'][self.file_b][0], {7})
+        self.assertEqual(loaded['arcs'][self.file_b][0], {(7, 8)})
+
+    def test_legacy_main_database_is_upgraded(self):
+        self.create_legacy_db(".coverage.db")
+        storage = CoverageStorage(".coverage.db")
+
+        loaded = TraceContainer()
+        storage.load_into(loaded, self.cov.path_manager)
+        self.assertEqual(loaded['lines'][self.file_b][0], {7})
+
+        # combining into the upgraded database keeps the old rows
+        data = TraceContainer()
+        data['lines'][self.file_b][0].add(9)
+        storage.save(data, {"default": 0})
+        storage.combine(lambda path: path)
+
+        loaded = TraceContainer()
+        storage.load_into(loaded, self.cov.path_manager)
+        self.assertEqual(loaded['lines'][self.file_b][0], {7, 9})
+
+    def test_bitmap_format_writes_one_blob_per_file_and_context(self):
+        data = TraceContainer()
+        data['lines'][self.file_a][0].update(range(1, 200))
+        data['arcs'][self.file_a][0].update((i, i + 1) for i in range(1, 199))
+        data['instruction_arcs'][self.file_a][0].add((4, 12))
+        CoverageStorage(".coverage.db", 'bitmap').save(data, {"default": 0})
+
+        with closing(sqlite3.connect(self.partials()[0])) as conn:
+            self.assertEqual(conn.execute("SELECT COUNT(*) FROM lines").fetchone()[0], 0)
+            self.assertEqual(conn.execute("SELECT COUNT(*) FROM line_bitmaps").fetchone()[0], 1)
+            self.assertEqual(conn.execute("SELECT COUNT(*) FROM arc_blobs").fetchone()[0], 2)
+
+        storage = CoverageStorage(".coverage.db")
+        storage.combine(lambda path: path)
+        loaded = TraceContainer()
+        storage.load_into(loaded, self.cov.path_manager)
+        self.assertEqual(loaded['lines'][self.file_a][0], set(range(1, 200)))
+        self.assertEqual(loaded['arcs'][self.file_a][0], {(i, i + 1) for i in range(1, 199)})
+        self.assertEqual(loaded['instruction_arcs'][self.file_a][0], {(4, 12)})
+
+    def test_hit_counts_summed_across_partials_and_flushes(self):
+        for storage_format in ('rows', 'bitmap', 'rows'):
+            storage = CoverageStorage(".coverage.db", storage_format)
+            # two saves to the same partial, like a flush followed by the final save
+            for _ in range(2):
+                data = TraceContainer()
+                data['lines'][self.file_a][0].add(3)
+                data['line_counts'][self.file_a][0][3] += 5
+                data['arc_counts'][self.file_a][0][(3, 4)] += 2
+                storage.save(data, {"default": 0})
+
+        storage = CoverageStorage(".coverage.db")
+        storage.combine(lambda path: path)
+        counts = TraceContainer()
+        storage.load_into(TraceContainer(), self.cov.path_manager, counts=counts)
+        self.assertEqual(counts['line_counts'][self.file_a][0], {3: 30})
+        self.assertEqual(counts['arc_counts'][self.file_a][0], {(3, 4): 12})
+
+    def test_upserts_name_their_conflict_target(self):
+        # SQLite before 3.35 rejects ON CONFLICT without a target
+        for name in dir(queries):
+            value = getattr(queries, name)
+            if isinstance(value, str):
+                self.assertNotRegex(value, r"ON CONFLICT\s+DO", name)
+
+    def test_save_without_counts_skips_count_statements(self):
+        data = TraceContainer()
+        data['lines'][self.file_a][0].add(3)
+        # a statement this SQLite cannot prepare must not break saves of other modes
+        with patch.object(queries, 'INSERT_LINE_COUNT', 'not sql'), \
+                patch.object(queries, 'INSERT_ARC_COUNT', 'not sql'):
+            CoverageStorage(".coverage.db").save(data, {"default": 0})
+
+        storage = CoverageStorage(".coverage.db")
+        storage.combine(lambda path: path)
+        loaded = TraceContainer()
+        storage.load_into(loaded, self.cov.path_manager)
+        self.assertEqual(loaded['lines'][self.file_a][0], {3})
+
+    def test_bitmap_partials_are_ored_together_and_with_rows(self):
+        for lines, storage_format in (({1, 2}, 'bitmap'), ({2, 30}, 'bitmap'), ({5}, 'rows')):
+            data = TraceContainer()
+            data['lines'][self.file_a][0].update(lines)
+            data['arcs'][self.file_a][0].add((min(lines), max(lines)))
+            CoverageStorage(".coverage.db", storage_format).save(data, {"default": 0})
+
+        storage = CoverageStorage(".coverage.db", 'bitmap')
+        storage.combine(lambda path: path)
+        with closing(sqlite3.connect(".coverage.db")) as conn:
+            self.assertEqual(conn.execute("SELECT COUNT(*) FROM line_bitmaps").fetchone()[0], 1)
+
+        loaded = TraceContainer()
+        storage.load_into(loaded, self.cov.path_manager)
+        self.assertEqual(loaded['lines'][self.file_a][0], {1, 2, 5, 30})
+        self.assertEqual(loaded['arcs'][self.file_a][0], {(1, 2), (2, 30), (5, 5)})
+
+    def save_partials(self, count, storage_format='rows'):
+        for i in range(count):
+            data = TraceContainer()
+            data['lines'][self.file_a][0].add(i + 1)
+            data['arcs'][self.file_b][0].add((i, i + 1))
+            CoverageStorage(".coverage.db", storage_format).save(data, {"default": 0, f"ctx_{i % 3}": 1})
+
+    def load(self, storage):
+        loaded = TraceContainer()
+        storage.load_into(loaded, self.cov.path_manager)
+        return loaded
+
+    def test_tree_combine_matches_sequential(self):
+        self.save_partials(30)
+        self.save_partials(5, 'bitmap')
+        storage = CoverageStorage(".coverage.db")
+        storage.combine(None, jobs=3)
+        self.assertEqual(self.partials(), [])
+
+        loaded = self.load(storage)
+        self.assertEqual(loaded['lines'][self.file_a][0], set(range(1, 31)))
+        self.assertEqual(loaded['arcs'][self.file_b][0], {(i, i + 1) for i in range(30)})
+        with closing(sqlite3.connect(".coverage.db")) as conn:
+            labels = {row[0] for row in conn.execute("SELECT label FROM contexts")}
+        self.assertEqual(labels, {"default", "ctx_0", "ctx_1", "ctx_2"})
+
+    def test_tree_combine_remaps_in_final_pass_only(self):
+        self.save_partials(20)
+        calls = []
+        CoverageStorage(".coverage.db").combine(lambda path: calls.append(path) or path, jobs=2)
+        # the intermediates keep the original paths, so at most COMBINE_FAN_IN partials reach the remap
+        self.assertLessEqual(len(calls), 2 * 8)
+        self.assertEqual(set(calls), {self.file_a, self.file_b})
+
+    def test_corrupt_partial_does_not_fail_its_batch(self):
+        self.save_partials(4)
+        with open(".coverage.db.1.corrupt", "w") as f:
+            f.write("not a database")
+
+        storage = CoverageStorage(".coverage.db")
+        with self.assertLogs('src.engine.storage', level='ERROR'):
+            storage.combine(None)
+        self.assertEqual(self.partials(), [".coverage.db.1.corrupt"])
+        self.assertEqual(self.load(storage)['lines'][self.file_a][0], {1, 2, 3, 4})
+
+    def test_unknown_storage_format_falls_back_to_rows(self):
+        with self.assertLogs('src.engine.storage', level='WARNING'):
+            storage = CoverageStorage(".coverage.db", 'columnar')
+        self.assertEqual(storage.storage_format, 'rows')
+
+    def save_per_test(self, storage_format):
+        # test_one runs lines 1-3 of a.py, test_two line 10 and b.py
+        data = TraceContainer()
+        data['lines'][self.file_a][1].update({1, 2, 3})
+        data['lines'][self.file_a][2].add(10)
+        data['lines'][self.file_b][2].add(1)
+        CoverageStorage(".coverage.db", storage_format).save(data, {"default": 0, "test_one": 1, "test_two": 2})
+        CoverageStorage(".coverage.db").combine()
+
+    def test_contexts_for_lines(self):
+        for storage_format in ('rows', 'bitmap'):
+            with self.subTest(storage_format=storage_format):
+                if os.path.exists(".coverage.db"):
+                    os.remove(".coverage.db")
+                self.save_per_test(storage_format)
+                storage = CoverageStorage(".coverage.db")
+
+                self.assertEqual(storage.contexts_for_lines(self.file_a, [(3, 9)]), {"test_one"})
+                self.assertEqual(storage.contexts_for_lines(self.file_a, [(4, 9)]), set())
+                self.assertEqual(storage.contexts_for_lines(self.file_a, [(2, 2), (10, 12)]), {"test_one", "test_two"})
+                self.assertEqual(storage.contexts_for_lines(self.file_b), {"test_two"})
+                self.assertEqual(storage.contexts_for_lines("missing.py"), set())
+
+    def test_line_range_lookup_uses_index(self):
+        self.save_per_test('rows')
+        with closing(sqlite3.connect(".coverage.db")) as conn:
+            plan = conn.execute("EXPLAIN QUERY PLAN " + queries.SELECT_CONTEXTS_FOR_LINES, (1, 1, 5)).fetchall()
+        self.assertTrue(any("lines_by_line" in row[-1] for row in plan), plan)
+
+    def test_contexts_for_lines_does_not_write(self):
+        self.save_per_test('rows')
+        with closing(sqlite3.connect(".coverage.db")) as conn:
+            conn.execute("DROP INDEX lines_by_line")
+            conn.commit()
+        with open(".coverage.db", "rb") as f:
+            before = f.read()
+
+        storage = CoverageStorage(".coverage.db")
+        self.assertEqual(storage.contexts_for_lines(self.file_a, [(3, 9)]), {"test_one"})
+        with open(".coverage.db", "rb") as f:
+            self.assertEqual(f.read(), before)
+
+    def test_engine_contexts_for_relative_path(self):
+        self.save_per_test('rows')
+        self.assertEqual(self.cov.contexts_for("a.py", [(1, 1)]), {"test_one"})
+
+    def test_load_keeps_contexts(self):
+        for storage_format in ('rows', 'bitmap'):
+            with self.subTest(storage_format=storage_format):
+                if os.path.exists(".coverage.db"):
+                    os.remove(".coverage.db")
+                self.save_per_test(storage_format)
+
+                loaded = TraceContainer()
+                ids = {"default": 0, "test_two": 7}
+                CoverageStorage(".coverage.db").load_into(loaded, self.cov.path_manager,
+                                                          context_id=lambda label: ids.setdefault(label, len(ids) + 10))
+                self.assertEqual(loaded['lines'][self.file_a][ids["test_one"]], {1, 2, 3})
+                self.assertEqual(loaded['lines'][self.file_a][7], {10})
+                self.assertEqual(loaded['lines'][self.file_b][7], {1})
+
+    def test_load_only_selected_files(self):
+        self.save_per_test('rows')
+        loaded = TraceContainer()
+        CoverageStorage(".coverage.db").load_into(loaded, self.cov.path_manager, files=lambda path: path == self.file_b)
+        self.assertEqual(set(loaded['lines']), {self.file_b})
+        self.assertEqual(loaded['lines'][self.file_b][0], {1})
+
+    def test_report_include_limits_files(self):
+        self.save_per_test('rows')
+        self.cov.report(reporters=['json'], include=["b.py"])
+        with open("coverage.json") as f:
+            report = json.load(f)
+        self.assertEqual([os.path.basename(name) for name in report["files"]], ["b.py"])
+
+
+if __name__ == '__main__':
+    unittest.main()